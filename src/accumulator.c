@@ -0,0 +1,310 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "accumulator.h"
+#include "util.h"
+
+static void
+accumulator_series_destroy(struct accumulator_series **series_ptr)
+{
+    if (!*series_ptr)
+        return;
+
+    free((*series_ptr)->rates);
+    free(*series_ptr);
+    *series_ptr = NULL;
+}
+
+static struct accumulator_series *
+accumulator_series_create(void)
+{
+    return calloc(1, sizeof(struct accumulator_series));
+}
+
+static int
+accumulator_series_append(struct accumulator_series *series, double rate)
+{
+    double *rates = NULL;
+    size_t capacity;
+
+    if (series->count == series->capacity) {
+        capacity = (series->capacity) ? series->capacity * 2 : 16;
+        rates = realloc(series->rates, capacity * sizeof(double));
+        if (!rates)
+            return -1;
+
+        series->rates = rates;
+        series->capacity = capacity;
+    }
+
+    series->rates[series->count++] = rate;
+    return 0;
+}
+
+static void
+accumulator_group_destroy(struct accumulator_group **group_ptr)
+{
+    if (!*group_ptr)
+        return;
+
+    payload_group_data_destroy(&(*group_ptr)->sums);
+    zhashx_destroy(&(*group_ptr)->series);
+    free(*group_ptr);
+    *group_ptr = NULL;
+}
+
+static struct accumulator_group *
+accumulator_group_create(void)
+{
+    struct accumulator_group *group = malloc(sizeof(struct accumulator_group));
+
+    if (!group)
+        return NULL;
+
+    group->sums = payload_group_data_create();
+    group->series = zhashx_new();
+    if (!group->sums || !group->series) {
+        accumulator_group_destroy(&group);
+        return NULL;
+    }
+
+    zhashx_set_destructor(group->series, (zhashx_destructor_fn *) accumulator_series_destroy);
+    return group;
+}
+
+struct accumulator *
+accumulator_create(void)
+{
+    struct accumulator *acc = malloc(sizeof(struct accumulator));
+
+    if (!acc)
+        return NULL;
+
+    acc->groups = zhashx_new();
+    if (!acc->groups) {
+        free(acc);
+        return NULL;
+    }
+
+    zhashx_set_destructor(acc->groups, (zhashx_destructor_fn *) accumulator_group_destroy);
+    return acc;
+}
+
+/*
+ * record_rates append the rate of each event of the read to its series.
+ */
+static int
+record_rates(struct accumulator_group *group, struct payload_group_data *group_data, uint64_t duration)
+{
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    const char *event_name = NULL;
+    zhashx_t *sums = NULL; /* char *event_name -> uint64_t *sum */
+    uint64_t *sum = NULL;
+    struct accumulator_series *series = NULL;
+    int ret = -1;
+
+    sums = zhashx_new();
+    if (!sums)
+        return -1;
+
+    zhashx_set_duplicator(sums, (zhashx_duplicator_fn *) uint64ptrdup);
+    zhashx_set_destructor(sums, (zhashx_destructor_fn *) ptrfree);
+
+    /* the rate of the target is computed from the values of all its cpus */
+    for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+        for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+            for (value = zhashx_first(cpu_data->events); value; value = zhashx_next(cpu_data->events)) {
+                event_name = zhashx_cursor(cpu_data->events);
+                if (!payload_is_counter_value(event_name))
+                    continue;
+
+                sum = zhashx_lookup(sums, event_name);
+                if (sum)
+                    *sum += *value;
+                else
+                    zhashx_insert(sums, event_name, (void *) value);
+            }
+        }
+    }
+
+    for (sum = zhashx_first(sums); sum; sum = zhashx_next(sums)) {
+        event_name = zhashx_cursor(sums);
+        series = zhashx_lookup(group->series, event_name);
+        if (!series) {
+            series = accumulator_series_create();
+            if (!series)
+                goto out;
+
+            zhashx_insert(group->series, event_name, series);
+        }
+
+        if (accumulator_series_append(series, (double) *sum * 1000.0 / (double) duration))
+            goto out;
+    }
+
+    ret = 0;
+
+out:
+    zhashx_destroy(&sums);
+    return ret;
+}
+
+int
+accumulator_add(struct accumulator *acc, const char *group_name, struct payload_group_data *group_data, uint64_t duration)
+{
+    struct accumulator_group *group = zhashx_lookup(acc->groups, group_name);
+
+    if (!group) {
+        group = accumulator_group_create();
+        if (!group)
+            return -1;
+
+        zhashx_insert(acc->groups, group_name, group);
+    }
+
+    if (payload_group_data_merge(group->sums, group_data))
+        return -1;
+
+    if (duration && record_rates(group, group_data, duration))
+        return -1;
+
+    return 0;
+}
+
+bool
+accumulator_has_group(struct accumulator *acc, const char *group_name)
+{
+    return zhashx_lookup(acc->groups, group_name) != NULL;
+}
+
+static int
+compare_rates(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * get_percentile returns the nearest-rank percentile (in percent) of the sorted rates.
+ */
+static double
+get_percentile(const double *rates, size_t count, unsigned int percentile)
+{
+    size_t rank = (count * percentile + 99) / 100;
+
+    return rates[(rank > 0) ? rank - 1 : 0];
+}
+
+static struct payload_event_summary *
+summarize_series(struct accumulator_series *series)
+{
+    struct payload_event_summary *summary = malloc(sizeof(struct payload_event_summary));
+
+    if (!summary)
+        return NULL;
+
+    qsort(series->rates, series->count, sizeof(double), compare_rates);
+    summary->reads = (unsigned int) series->count;
+    summary->min = series->rates[0];
+    summary->max = series->rates[series->count - 1];
+    summary->p50 = get_percentile(series->rates, series->count, 50);
+    summary->p95 = get_percentile(series->rates, series->count, 95);
+    summary->p99 = get_percentile(series->rates, series->count, 99);
+    return summary;
+}
+
+struct payload_group_data *
+accumulator_take(struct accumulator *acc, const char *group_name)
+{
+    struct accumulator_group *group = zhashx_lookup(acc->groups, group_name);
+    struct payload_group_data *sums = NULL;
+    struct accumulator_series *series = NULL;
+    struct payload_event_summary *summary = NULL;
+
+    if (!group)
+        return NULL;
+
+    sums = group->sums;
+    sums->summaries = zhashx_new();
+    if (!sums->summaries)
+        goto error;
+
+    zhashx_set_destructor(sums->summaries, (zhashx_destructor_fn *) ptrfree);
+    for (series = zhashx_first(group->series); series; series = zhashx_next(group->series)) {
+        if (!series->count)
+            continue;
+
+        summary = summarize_series(series);
+        if (!summary)
+            goto error;
+
+        zhashx_insert(sums->summaries, zhashx_cursor(group->series), summary);
+    }
+
+    /* the group data is now owned by the caller */
+    group->sums = NULL;
+    zhashx_delete(acc->groups, group_name);
+    return sums;
+
+error:
+    zhashx_delete(acc->groups, group_name);
+    return NULL;
+}
+
+void
+accumulator_remove(struct accumulator *acc, const char *group_name)
+{
+    zhashx_delete(acc->groups, group_name);
+}
+
+void
+accumulator_clear(struct accumulator *acc)
+{
+    zhashx_purge(acc->groups);
+}
+
+void
+accumulator_destroy(struct accumulator *acc)
+{
+    if (!acc)
+        return;
+
+    zhashx_destroy(&acc->groups);
+    free(acc);
+}
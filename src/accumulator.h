@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <czmq.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/*
+ * accumulator_series stores the rates (per second) of an event over the reads of the current report period.
+ */
+struct accumulator_series
+{
+    double *rates;
+    size_t count;
+    size_t capacity;
+};
+
+/*
+ * accumulator_group stores the values of an events group read since its last report.
+ */
+struct accumulator_group
+{
+    struct payload_group_data *sums;
+    zhashx_t *series; /* char *event_name -> struct accumulator_series *series */
+};
+
+/*
+ * accumulator stores the values of the events groups read at a faster rate than they are reported.
+ */
+struct accumulator
+{
+    zhashx_t *groups; /* char *group_name -> struct accumulator_group *group */
+};
+
+/*
+ * accumulator_create allocate the resources of an empty accumulator.
+ */
+struct accumulator *accumulator_create(void);
+
+/*
+ * accumulator_add add the values of a read of the group, covering the given duration (in milliseconds, 0 if unknown).
+ * The rate of each event is computed from the sum of its values over the cpus, and is not recorded if the duration is unknown.
+ */
+int accumulator_add(struct accumulator *acc, const char *group_name, struct payload_group_data *group_data, uint64_t duration);
+
+/*
+ * accumulator_has_group returns true if values of the group have been accumulated since its last report.
+ */
+bool accumulator_has_group(struct accumulator *acc, const char *group_name);
+
+/*
+ * accumulator_take returns the values accumulated for the group with the summaries of its rates, and reset them.
+ * The caller takes the ownership of the returned group data, NULL is returned on error or if nothing has been accumulated.
+ */
+struct payload_group_data *accumulator_take(struct accumulator *acc, const char *group_name);
+
+/*
+ * accumulator_remove drop the values accumulated for the group.
+ */
+void accumulator_remove(struct accumulator *acc, const char *group_name);
+
+/*
+ * accumulator_clear drop the values accumulated for all the groups.
+ */
+void accumulator_clear(struct accumulator *acc);
+
+/*
+ * accumulator_destroy free the resources of the accumulator.
+ */
+void accumulator_destroy(struct accumulator *acc);
+
+#endif /* ACCUMULATOR_H */
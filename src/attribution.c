@@ -0,0 +1,259 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attribution.h"
+#include "power_model.h"
+#include "util.h"
+
+/*
+ * is_context_marker returns true if the frame is a context marker of perf, and not an instruction pointer.
+ */
+static bool
+is_context_marker(const char *frame, size_t length)
+{
+    char address[24] = {0};
+
+    if (length < 3 || length >= sizeof(address) || strncmp(frame, "0x", 2) != 0)
+        return false;
+
+    memcpy(address, frame, length);
+    return strtoull(address, NULL, 16) >= (uint64_t) PERF_CONTEXT_MAX;
+}
+
+/*
+ * get_sample_leaf copy into the buffer the name of the function the sample was taken in, which is its first frame.
+ * Returns false if the sample have no frame.
+ */
+static bool
+get_sample_leaf(const char *sample, size_t length, char *leaf, size_t size)
+{
+    const char *frame = sample;
+    const char *end = sample + length;
+    size_t frame_length;
+
+    while (frame < end) {
+        frame_length = strcspn(frame, ";|");
+        if (frame + frame_length > end)
+            frame_length = (size_t) (end - frame);
+
+        if (frame_length > 0 && !is_context_marker(frame, frame_length)) {
+            if (frame_length >= size)
+                frame_length = size - 1;
+
+            memcpy(leaf, frame, frame_length);
+            leaf[frame_length] = '\0';
+            return true;
+        }
+
+        frame += frame_length + 1;
+    }
+
+    return false;
+}
+
+/*
+ * count_samples returns the number of samples of the callchains string having at least one frame.
+ */
+static unsigned int
+count_samples(const char *callchains)
+{
+    char leaf[ATTRIBUTION_FUNCTION_NAME_MAX];
+    const char *sample = callchains;
+    size_t length;
+    unsigned int count = 0;
+
+    while (*sample) {
+        length = strcspn(sample, "|");
+        if (get_sample_leaf(sample, length, leaf, sizeof(leaf)))
+            count++;
+
+        sample += length;
+        if (*sample)
+            sample++;
+    }
+
+    return count;
+}
+
+static struct payload_function_data *
+get_function_data(struct payload *payload, const char *function_name)
+{
+    struct payload_function_data *function_data = zhashx_lookup(payload->functions, function_name);
+
+    if (function_data)
+        return function_data;
+
+    function_data = payload_function_data_create();
+    if (!function_data)
+        return NULL;
+
+    zhashx_insert(payload->functions, function_name, function_data);
+    return function_data;
+}
+
+/*
+ * attribute_cpu_values add the share of each counter of the cpu to the function of each of its samples.
+ */
+static int
+attribute_cpu_values(struct payload *payload, struct payload_cpu_data *cpu_data, const char *callchains)
+{
+    char leaf[ATTRIBUTION_FUNCTION_NAME_MAX];
+    unsigned int num_samples = count_samples(callchains);
+    struct payload_function_data *function_data = NULL;
+    const uint64_t *value = NULL;
+    const char *event_name = NULL;
+    double *share = NULL;
+    const char *sample = callchains;
+    size_t length;
+
+    if (!num_samples)
+        return 0;
+
+    while (*sample) {
+        length = strcspn(sample, "|");
+        if (get_sample_leaf(sample, length, leaf, sizeof(leaf))) {
+            function_data = get_function_data(payload, leaf);
+            if (!function_data)
+                return -1;
+
+            function_data->samples++;
+            for (value = zhashx_first(cpu_data->events); value; value = zhashx_next(cpu_data->events)) {
+                event_name = zhashx_cursor(cpu_data->events);
+                if (!payload_is_counter_value(event_name))
+                    continue;
+
+                share = zhashx_lookup(function_data->events, event_name);
+                if (!share) {
+                    share = calloc(1, sizeof(double));
+                    if (!share)
+                        return -1;
+
+                    zhashx_insert(function_data->events, event_name, share);
+                }
+
+                *share += (double) *value / num_samples;
+            }
+        }
+
+        sample += length;
+        if (*sample)
+            sample++;
+    }
+
+    return 0;
+}
+
+/*
+ * get_payload_energy returns the energy (in joules) of the target over the payload, or a negative value if it is unknown.
+ */
+static double
+get_payload_energy(struct payload *payload, const char *energy_event)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    double energy = -1.0;
+
+    if (payload->power >= 0.0)
+        return (payload->interval) ? payload->power * payload->interval / 1000.0 : -1.0;
+
+    if (!energy_event || !streq(payload->target_name, POWER_MODEL_SYSTEM_TARGET))
+        return -1.0;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                value = zhashx_lookup(cpu_data->events, energy_event);
+                if (value)
+                    energy = ((energy < 0.0) ? 0.0 : energy) + (double) *value * POWER_MODEL_RAPL_UNIT;
+            }
+        }
+    }
+
+    return energy;
+}
+
+int
+attribution_evaluate_payload(struct payload *payload, const char *energy_event)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    struct payload_function_data *function_data = NULL;
+    const char *callchains = NULL;
+    unsigned int total_samples = 0;
+    double energy;
+
+    if (payload->heartbeat)
+        return 0;
+
+    zhashx_destroy(&payload->functions);
+    payload->functions = zhashx_new();
+    if (!payload->functions)
+        return -1;
+
+    zhashx_set_destructor(payload->functions, (zhashx_destructor_fn *) payload_function_data_destroy);
+
+    /* the callchains of a cpu are sampled over the same interval as its counters */
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                callchains = zhashx_lookup(cpu_data->events, "callchain");
+                if (callchains && *callchains && attribute_cpu_values(payload, cpu_data, callchains))
+                    return -1;
+            }
+        }
+    }
+
+    if (!zhashx_size(payload->functions)) {
+        zhashx_destroy(&payload->functions);
+        return 0;
+    }
+
+    energy = get_payload_energy(payload, energy_event);
+    if (energy < 0.0)
+        return 0;
+
+    for (function_data = zhashx_first(payload->functions); function_data; function_data = zhashx_next(payload->functions))
+        total_samples += function_data->samples;
+
+    for (function_data = zhashx_first(payload->functions); function_data; function_data = zhashx_next(payload->functions))
+        function_data->energy = energy * function_data->samples / total_samples;
+
+    return 0;
+}
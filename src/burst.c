@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "burst.h"
+
+struct burst *
+burst_create(unsigned int period, unsigned int duration, unsigned int callchain_frequency, const char *trigger_event, uint64_t trigger_threshold)
+{
+    struct burst *burst = malloc(sizeof(struct burst));
+
+    if (!burst)
+        return NULL;
+
+    burst->period = period;
+    burst->duration = duration;
+    burst->callchain_frequency = callchain_frequency;
+    burst->trigger_event = (trigger_event) ? strdup(trigger_event) : NULL;
+    burst->trigger_threshold = trigger_threshold;
+    atomic_init(&burst->requested, false);
+
+    if (trigger_event && !burst->trigger_event) {
+        burst_destroy(burst);
+        return NULL;
+    }
+
+    return burst;
+}
+
+void
+burst_request(struct burst *burst)
+{
+    atomic_store_explicit(&burst->requested, true, memory_order_relaxed);
+}
+
+bool
+burst_take_request(struct burst *burst)
+{
+    return atomic_exchange_explicit(&burst->requested, false, memory_order_relaxed);
+}
+
+void
+burst_check_payload(struct burst *burst, struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    uint64_t sum = 0;
+    bool found = false;
+
+    if (!burst->trigger_event)
+        return;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                value = zhashx_lookup(cpu_data->events, burst->trigger_event);
+                if (value) {
+                    sum += *value;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    if (found && sum >= burst->trigger_threshold && !atomic_exchange_explicit(&burst->requested, true, memory_order_relaxed))
+        zsys_info("burst: %s of target %s reached %" PRIu64 " (threshold=%" PRIu64 "), capture window requested", burst->trigger_event, payload->target_name, sum, burst->trigger_threshold);
+}
+
+void
+burst_destroy(struct burst *burst)
+{
+    if (!burst)
+        return;
+
+    free(burst->trigger_event);
+    free(burst);
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BURST_H
+#define BURST_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/*
+ * burst stores the settings of the high resolution capture windows, and the pending request of a new window.
+ * A window is requested by a control command, or by a monitoring worker when the trigger event exceeds its threshold.
+ */
+struct burst
+{
+    unsigned int period; /* tick period (in milliseconds) during a window */
+    unsigned int duration; /* in milliseconds */
+    unsigned int callchain_frequency; /* sampling frequency during a window, 0 to keep the regular one */
+    char *trigger_event; /* NULL if the windows are only requested by the control command */
+    uint64_t trigger_threshold; /* value of the trigger event over a read period */
+    atomic_bool requested;
+};
+
+/*
+ * burst_create allocate the resources of the capture windows settings.
+ */
+struct burst *burst_create(unsigned int period, unsigned int duration, unsigned int callchain_frequency, const char *trigger_event, uint64_t trigger_threshold);
+
+/*
+ * burst_request ask the main loop to start a capture window, or to extend the running one.
+ */
+void burst_request(struct burst *burst);
+
+/*
+ * burst_take_request returns true if a capture window has been requested since the previous call.
+ */
+bool burst_take_request(struct burst *burst);
+
+/*
+ * burst_check_payload request a capture window if the sum of the values of the trigger event in the payload exceeds the threshold.
+ */
+void burst_check_payload(struct burst *burst, struct payload *payload);
+
+/*
+ * burst_destroy free the allocated resources of the capture windows settings.
+ */
+void burst_destroy(struct burst *burst);
+
+#endif /* BURST_H */
@@ -32,16 +32,35 @@
 #include <czmq.h>
 #include <errno.h>
 #include <limits.h>
+#include <linux/magic.h>
 #include <stdlib.h>
+#include <sys/vfs.h>
 #include <unistd.h>
 #include <bson.h>
 
 #include "config.h"
+#include "discovery.h"
 #include "events.h"
 #include "storage.h"
+#include "report_queue.h"
 
 
 #define DEFAULT_CGROUP_BASEPATH "/sys/fs/cgroup/perf_event"
+#define DEFAULT_CGROUP2_BASEPATH "/sys/fs/cgroup"
+
+/*
+ * detect_cgroup_basepath returns the default cgroup base path, the root of the unified hierarchy on cgroup v2 only hosts.
+ */
+static const char *
+detect_cgroup_basepath(void)
+{
+    struct statfs fs = {0};
+
+    if (statfs(DEFAULT_CGROUP2_BASEPATH, &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC)
+        return DEFAULT_CGROUP2_BASEPATH;
+
+    return DEFAULT_CGROUP_BASEPATH;
+}
 
 struct config *
 config_create(void)
@@ -54,15 +73,47 @@ config_create(void)
     /* sensor default config */
     config->sensor.verbose = 0;
     config->sensor.frequency = 1000;
+    config->sensor.read_period = 0;
     config->sensor.callchains_per_report = 20;
-    config->sensor.cgroup_basepath = DEFAULT_CGROUP_BASEPATH;
+    config->sensor.workers = 4;
+    config->sensor.discovery_rescan_interval = 60000;
+    config->sensor.aggregation = DISCOVERY_AGGREGATION_CONTAINER;
+    config->sensor.activity_threshold = 0;
+    config->sensor.idle_period = 30000;
+    config->sensor.shard_index = 0;
+    config->sensor.shard_count = 1;
+    config->sensor.burst_period = 0;
+    config->sensor.burst_duration = 5000;
+    config->sensor.burst_callchain_frequency = 0;
+    config->sensor.burst_trigger_threshold = 0;
+    config->sensor.cgroup_basepath = detect_cgroup_basepath();
     config->sensor.name = NULL;
+    config->sensor.handover_socket = NULL;
+    config->sensor.burst_trigger_event = NULL;
 
     /* storage default config */
     config->storage.type = STORAGE_CSV;
     config->storage.U_flag = NULL;
     config->storage.D_flag = NULL;
     config->storage.C_flag = NULL;
+    config->storage.output = METRIC_OUTPUT_BOTH;
+
+    /* report default config */
+    config->report.queue_size = 1024;
+    config->report.queue_policy = REPORT_QUEUE_COALESCE;
+    config->report.suppress_idle = false;
+    config->report.idle_threshold = 0;
+    config->report.heartbeat_period = 60000;
+    config->report.power_group = NULL;
+    config->report.power_energy_event = "RAPL_ENERGY_PKG";
+    config->report.power_window = 120;
+    config->report.power_refit_interval = 10;
+    config->report.top_k = 0;
+    config->report.rank_event = RANKING_POWER_KEY;
+    config->report.rank_tail = RANKING_TAIL_AGGREGATE;
+    config->report.tail_interval = 10;
+    config->report.rank_period = 10000;
+    config->report.attribution = false;
 
     /* events default config */
     config->events.system = NULL;
@@ -113,6 +164,24 @@ parse_frequency(const char *str, unsigned int *frequency)
     return 0;
 }
 
+static int
+parse_threshold(const char *str, uint64_t *threshold)
+{
+    unsigned long long value;
+    char *str_endp = NULL;
+
+    errno = 0;
+    value = strtoull(str, &str_endp, 0);
+
+    /* check if the string have been fully processed */
+    if (str == str_endp || *str_endp != '\0' || errno != 0) {
+        return -1;
+    }
+
+    *threshold = (uint64_t)value;
+    return 0;
+}
+
 static int
 parse_event_array(bson_iter_t *iter, struct events_group *current_events_group)
 {
@@ -136,6 +205,22 @@ parse_event_array(bson_iter_t *iter, struct events_group *current_events_group)
   return 0;
 }
 
+static int
+parse_metric_document(bson_iter_t *iter, struct events_group *current_events_group)
+{
+  while(bson_iter_next(iter)){
+    if(bson_iter_type(iter) != BSON_TYPE_UTF8){
+      zsys_error("config: the expression of metric %s, in event group %s, is not a string", bson_iter_key(iter), current_events_group->name);
+      return -1;
+    }
+    if(events_group_add_metric(current_events_group, bson_iter_key(iter), bson_iter_utf8(iter, NULL))){
+      zsys_error("config: failed to add metric %s to event group %s", bson_iter_key(iter), current_events_group->name);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 static int
 iter_on_event_group_config(bson_iter_t * iter, struct config *config, char *group_type)
 {
@@ -184,13 +269,37 @@ iter_on_event_group_config(bson_iter_t * iter, struct config *config, char *grou
 	  zsys_error("config: unknow value %s for monitoring_type", bson_iter_utf8(&child_iter, NULL));
 	  return -1;
 	}
+	if(strcmp(key_name, "level") == 0){
+	  current_events_group->level = events_group_level_get_type(bson_iter_utf8(&child_iter, NULL));
+	  if(current_events_group->level == EVENTS_GROUP_LEVEL_UNKNOWN){
+	    zsys_error("config: unknow value %s for level", bson_iter_utf8(&child_iter, NULL));
+	    return -1;
+	  }
+	  break;
+	}
 	zsys_error("config: unknow config option %s in event sub section", key_name);
 	return -1;
+      case BSON_TYPE_INT32:
+	if(strcmp(key_name, "period") == 0){
+	  current_events_group->period = bson_iter_int32(&child_iter);
+	  break;
+	}
+	zsys_error("config: unknow integer config option %s in event sub section", key_name);
+	return -1;
       case BSON_TYPE_ARRAY:
 	bson_iter_recurse (&child_iter, &event_array_iter);
 	if(parse_event_array(&event_array_iter, current_events_group))
 	  return -1;
 	break;
+      case BSON_TYPE_DOCUMENT:
+	if(strcmp(key_name, "metrics") == 0){
+	  bson_iter_recurse (&child_iter, &event_array_iter);
+	  if(parse_metric_document(&event_array_iter, current_events_group))
+	    return -1;
+	  break;
+	}
+	zsys_error("config: unknow document config option %s in event sub section", key_name);
+	return -1;
       default:
 	zsys_error("config: unknow type for : %s", key_name);
 	return -1;
@@ -229,6 +338,14 @@ iter_on_storage_config(bson_iter_t *iter, struct config *config)
 	  config->storage.C_flag = bson_iter_utf8(iter, NULL);
 	  break;
 	}
+	if(strcmp(key_name, "output") == 0){
+	  config->storage.output = metric_output_get_type(bson_iter_utf8(iter, NULL));
+	  if (config->storage.output == METRIC_OUTPUT_UNKNOWN) {
+	    zsys_error("config: storage output '%s' is invalid", bson_iter_utf8(iter, NULL));
+	    return -1;
+	  }
+	  break;
+	}
 	zsys_error("config: unknow string config option %s in storage sub section", key_name);
 	return -1;
     case BSON_TYPE_INT32:
@@ -256,6 +373,14 @@ iter_on_root_config(bson_iter_t * iter, struct config *config)
 	config->sensor.verbose++;
 	break;
       }
+      if(strcmp(key_name, "suppress_idle") == 0){
+	config->report.suppress_idle = bson_iter_bool(iter);
+	break;
+      }
+      if(strcmp(key_name, "attribution") == 0){
+	config->report.attribution = bson_iter_bool(iter);
+	break;
+      }
       zsys_error("config: invalid boolean value for %s", key_name);
       return -1;
     case BSON_TYPE_INT32:
@@ -263,10 +388,93 @@ iter_on_root_config(bson_iter_t * iter, struct config *config)
 	config->sensor.frequency = bson_iter_int32(iter);
 	break;
       }
+      if(strcmp(key_name, "read_period") == 0){
+	config->sensor.read_period = bson_iter_int32(iter);
+	break;
+      }
       if(strcmp(key_name, "callchains_per_report") == 0){
     config->sensor.callchains_per_report = bson_iter_int32(iter);
     break;
       }
+      if(strcmp(key_name, "workers") == 0){
+	config->sensor.workers = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "discovery_rescan_interval") == 0){
+	config->sensor.discovery_rescan_interval = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "activity_threshold") == 0){
+	config->sensor.activity_threshold = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "idle_period") == 0){
+	config->sensor.idle_period = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "shard_index") == 0){
+	config->sensor.shard_index = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "shard_count") == 0){
+	config->sensor.shard_count = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "burst_period") == 0){
+	config->sensor.burst_period = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "burst_duration") == 0){
+	config->sensor.burst_duration = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "burst_callchain_frequency") == 0){
+	config->sensor.burst_callchain_frequency = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "burst_trigger_threshold") == 0){
+	config->sensor.burst_trigger_threshold = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "queue_size") == 0){
+	config->report.queue_size = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "idle_threshold") == 0){
+	config->report.idle_threshold = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "heartbeat_period") == 0){
+	config->report.heartbeat_period = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "power_window") == 0){
+	config->report.power_window = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "power_refit_interval") == 0){
+	config->report.power_refit_interval = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "top_k") == 0){
+	config->report.top_k = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "tail_interval") == 0){
+	config->report.tail_interval = bson_iter_int32(iter);
+	break;
+      }
+      if(strcmp(key_name, "rank_period") == 0){
+	config->report.rank_period = bson_iter_int32(iter);
+	break;
+      }
+      zsys_error("config: invalid integer value for %s", key_name);
+      return -1;
+    case BSON_TYPE_INT64:
+      if(strcmp(key_name, "burst_trigger_threshold") == 0){
+	config->sensor.burst_trigger_threshold = bson_iter_int64(iter);
+	break;
+      }
       zsys_error("config: invalid integer value for %s", key_name);
       return -1;
     case BSON_TYPE_UTF8:
@@ -278,6 +486,50 @@ iter_on_root_config(bson_iter_t * iter, struct config *config)
 	config->sensor.name = bson_iter_utf8(iter, NULL);
 	break;
       }
+      else if(strcmp(key_name, "handover_socket") == 0){
+	config->sensor.handover_socket = bson_iter_utf8(iter, NULL);
+	break;
+      }
+      else if(strcmp(key_name, "burst_trigger_event") == 0){
+	config->sensor.burst_trigger_event = bson_iter_utf8(iter, NULL);
+	break;
+      }
+      else if(strcmp(key_name, "power_group") == 0){
+	config->report.power_group = bson_iter_utf8(iter, NULL);
+	break;
+      }
+      else if(strcmp(key_name, "power_energy_event") == 0){
+	config->report.power_energy_event = bson_iter_utf8(iter, NULL);
+	break;
+      }
+      else if(strcmp(key_name, "rank_event") == 0){
+	config->report.rank_event = bson_iter_utf8(iter, NULL);
+	break;
+      }
+      else if(strcmp(key_name, "rank_tail") == 0){
+	config->report.rank_tail = ranking_tail_get_type(bson_iter_utf8(iter, NULL));
+	if (config->report.rank_tail == RANKING_TAIL_UNKNOWN) {
+	  zsys_error("config: tail policy '%s' is invalid", bson_iter_utf8(iter, NULL));
+	  return -1;
+	}
+	break;
+      }
+      else if(strcmp(key_name, "aggregation") == 0){
+	config->sensor.aggregation = discovery_aggregation_get_type(bson_iter_utf8(iter, NULL));
+	if (config->sensor.aggregation == DISCOVERY_AGGREGATION_UNKNOWN) {
+	  zsys_error("config: aggregation level '%s' is invalid", bson_iter_utf8(iter, NULL));
+	  return -1;
+	}
+	break;
+      }
+      else if(strcmp(key_name, "queue_policy") == 0){
+	config->report.queue_policy = report_queue_policy_get_type(bson_iter_utf8(iter, NULL));
+	if (config->report.queue_policy == REPORT_QUEUE_POLICY_UNKNOWN) {
+	  zsys_error("config: queue policy '%s' is invalid", bson_iter_utf8(iter, NULL));
+	  return -1;
+	}
+	break;
+      }
       zsys_error("config: invalid string value for %s", key_name);
       return -1;
     case BSON_TYPE_DOCUMENT:
@@ -353,6 +605,8 @@ config_setup_from_cli(int argc, char **argv, struct config *config)
     int ret = -1;
     int c;
     struct events_group *current_events_group = NULL;
+    const char *metric_expression = NULL;
+    char *metric_name = NULL;
 
     /* stores events to monitor globally (system) */
     config->events.system = zhashx_new();
@@ -372,7 +626,7 @@ config_setup_from_cli(int argc, char **argv, struct config *config)
     zhashx_set_duplicator(config->events.containers, (zhashx_duplicator_fn *) events_group_dup);
     zhashx_set_destructor(config->events.containers, (zhashx_destructor_fn *) events_group_destroy);
 
-    while ((c = getopt(argc, argv, "vf:F:p:n:s:c:e:or:U:D:C:P:")) != -1) {
+    while ((c = getopt(argc, argv, "vf:x:F:w:R:a:t:i:k:K:b:B:j:E:T:p:n:H:s:c:e:og:l:m:r:U:D:C:P:O:q:Q:SI:Y:M:J:W:Z:A:L:N:V:X:G")) != -1) {
 	switch (c) {
 	    case 'v':
 		config->sensor.verbose++;
@@ -383,18 +637,97 @@ config_setup_from_cli(int argc, char **argv, struct config *config)
 		    goto end;
 		}
 		break;
+	    case 'x':
+		if (parse_frequency(optarg, &config->sensor.read_period)) {
+		    zsys_error("config: the given read period is invalid or out of range");
+		    goto end;
+		}
+		break;
         case 'F':
         if (parse_frequency(optarg, &config->sensor.callchains_per_report)) {
             zsys_error("config: the given callchains per report is invalid or out of range");
             goto end;
         }
         break;
+	    case 'w':
+		if (parse_frequency(optarg, &config->sensor.workers)) {
+		    zsys_error("config: the given number of workers is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'R':
+		if (parse_frequency(optarg, &config->sensor.discovery_rescan_interval)) {
+		    zsys_error("config: the given discovery rescan interval is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'a':
+		config->sensor.aggregation = discovery_aggregation_get_type(optarg);
+		if (config->sensor.aggregation == DISCOVERY_AGGREGATION_UNKNOWN) {
+		    zsys_error("config: aggregation level '%s' is invalid", optarg);
+		    goto end;
+		}
+		break;
+	    case 't':
+		if (parse_frequency(optarg, &config->sensor.activity_threshold)) {
+		    zsys_error("config: the given activity threshold is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'i':
+		if (parse_frequency(optarg, &config->sensor.idle_period)) {
+		    zsys_error("config: the given idle period is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'k':
+		if (parse_frequency(optarg, &config->sensor.shard_index)) {
+		    zsys_error("config: the given shard index is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'K':
+		if (parse_frequency(optarg, &config->sensor.shard_count)) {
+		    zsys_error("config: the given shard count is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'b':
+		if (parse_frequency(optarg, &config->sensor.burst_period)) {
+		    zsys_error("config: the given burst period is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'B':
+		if (parse_frequency(optarg, &config->sensor.burst_duration)) {
+		    zsys_error("config: the given burst duration is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'j':
+		if (parse_frequency(optarg, &config->sensor.burst_callchain_frequency)) {
+		    zsys_error("config: the given burst callchain frequency is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'E':
+		config->sensor.burst_trigger_event = optarg;
+		break;
+	    case 'T':
+		if (parse_threshold(optarg, &config->sensor.burst_trigger_threshold)) {
+		    zsys_error("config: the given burst trigger threshold is invalid or out of range");
+		    goto end;
+		}
+		break;
 	    case 'p':
 		config->sensor.cgroup_basepath = optarg;
 		break;
 	    case 'n':
 		config->sensor.name = optarg;
 		break;
+	    case 'H':
+		config->sensor.handover_socket = optarg;
+		break;
 	    case 's':
 		current_events_group = events_group_create(optarg);
 		if (!current_events_group) {
@@ -422,6 +755,45 @@ config_setup_from_cli(int argc, char **argv, struct config *config)
 		}
 		current_events_group->type = MONITOR_ONE_CPU_PER_SOCKET;
 		break;
+	    case 'g':
+		if (!current_events_group) {
+		    zsys_error("config: you cannot set the period of an inexistent events group");
+		    goto end;
+		}
+		if (parse_frequency(optarg, &current_events_group->period)) {
+		    zsys_error("config: the given events group period is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'l':
+		if (!current_events_group) {
+		    zsys_error("config: you cannot set the level of an inexistent events group");
+		    goto end;
+		}
+		current_events_group->level = events_group_level_get_type(optarg);
+		if (current_events_group->level == EVENTS_GROUP_LEVEL_UNKNOWN) {
+		    zsys_error("config: events group level '%s' is invalid", optarg);
+		    goto end;
+		}
+		break;
+	    case 'm':
+		if (!current_events_group) {
+		    zsys_error("config: you cannot add a metric to an inexistent events group");
+		    goto end;
+		}
+		metric_expression = strchr(optarg, '=');
+		if (!metric_expression) {
+		    zsys_error("config: metric '%s' is not in the name=expression form", optarg);
+		    goto end;
+		}
+		metric_name = strndup(optarg, metric_expression - optarg);
+		if (events_group_add_metric(current_events_group, metric_name, metric_expression + 1)) {
+		    zsys_error("config: failed to add metric '%s'", optarg);
+		    free(metric_name);
+		    goto end;
+		}
+		free(metric_name);
+		break;
 	    case 'e':
 		if (!current_events_group) {
 		    zsys_error("config: you cannot add an event to an inexisting events group");
@@ -451,6 +823,90 @@ config_setup_from_cli(int argc, char **argv, struct config *config)
 	    case 'P':
 	      config->storage.P_flag = (int)strtol(optarg, NULL, 10);
 		break;
+	    case 'O':
+		config->storage.output = metric_output_get_type(optarg);
+		if (config->storage.output == METRIC_OUTPUT_UNKNOWN) {
+		    zsys_error("config: storage output '%s' is invalid", optarg);
+		    goto end;
+		}
+		break;
+	    case 'q':
+		if (parse_frequency(optarg, &config->report.queue_size)) {
+		    zsys_error("config: the given queue size is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'Q':
+		config->report.queue_policy = report_queue_policy_get_type(optarg);
+		if (config->report.queue_policy == REPORT_QUEUE_POLICY_UNKNOWN) {
+		    zsys_error("config: queue policy '%s' is invalid", optarg);
+		    goto end;
+		}
+		break;
+	    case 'S':
+		config->report.suppress_idle = true;
+		break;
+	    case 'I':
+		if (parse_frequency(optarg, &config->report.idle_threshold)) {
+		    zsys_error("config: the given idle threshold is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'Y':
+		if (parse_frequency(optarg, &config->report.heartbeat_period)) {
+		    zsys_error("config: the given heartbeat period is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'M':
+		config->report.power_group = optarg;
+		break;
+	    case 'J':
+		config->report.power_energy_event = optarg;
+		break;
+	    case 'W':
+		if (parse_frequency(optarg, &config->report.power_window)) {
+		    zsys_error("config: the given power model window is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'Z':
+		if (parse_frequency(optarg, &config->report.power_refit_interval)) {
+		    zsys_error("config: the given power model refit interval is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'A':
+		if (parse_frequency(optarg, &config->report.top_k)) {
+		    zsys_error("config: the given number of top targets is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'L':
+		config->report.rank_event = optarg;
+		break;
+	    case 'N':
+		config->report.rank_tail = ranking_tail_get_type(optarg);
+		if (config->report.rank_tail == RANKING_TAIL_UNKNOWN) {
+		    zsys_error("config: tail policy '%s' is invalid", optarg);
+		    goto end;
+		}
+		break;
+	    case 'V':
+		if (parse_frequency(optarg, &config->report.tail_interval)) {
+		    zsys_error("config: the given tail interval is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'X':
+		if (parse_frequency(optarg, &config->report.rank_period)) {
+		    zsys_error("config: the given rank period is invalid or out of range");
+		    goto end;
+		}
+		break;
+	    case 'G':
+		config->report.attribution = true;
+		break;
 	    default:
 		print_usage();
 		goto end;
@@ -474,6 +930,71 @@ config_validate(struct config *config)
 	return -1;
     }
 
+    if (sensor->workers == 0) {
+	zsys_error("config: the number of monitoring workers must be greater than 0");
+	return -1;
+    }
+
+    if (sensor->discovery_rescan_interval == 0) {
+	zsys_error("config: the discovery rescan interval must be greater than 0");
+	return -1;
+    }
+
+    if (sensor->activity_threshold > 0 && sensor->idle_period == 0) {
+	zsys_error("config: the idle period must be greater than 0 when the activity threshold is set");
+	return -1;
+    }
+
+    if (sensor->shard_count == 0 || sensor->shard_index >= sensor->shard_count) {
+	zsys_error("config: the shard index must be lower than the shard count");
+	return -1;
+    }
+
+    if (sensor->burst_period > 0 && sensor->burst_duration < sensor->burst_period) {
+	zsys_error("config: the burst duration must be greater than or equal to the burst period");
+	return -1;
+    }
+
+    if (sensor->burst_trigger_event && sensor->burst_period == 0) {
+	zsys_error("config: the burst period must be set when a burst trigger event is given");
+	return -1;
+    }
+
+    if (config->report.queue_size == 0) {
+	zsys_error("config: the reporting queue size must be greater than 0");
+	return -1;
+    }
+
+    if (config->report.suppress_idle && config->report.heartbeat_period == 0) {
+	zsys_error("config: the heartbeat period must be greater than 0 when the idle reports are suppressed");
+	return -1;
+    }
+
+    if (config->report.power_group && !zhashx_lookup(events->system, config->report.power_group)) {
+	zsys_error("config: the power model group %s must be a system events group", config->report.power_group);
+	return -1;
+    }
+
+    if (config->report.power_group && (config->report.power_window < 2 || config->report.power_refit_interval == 0)) {
+	zsys_error("config: the power model window must be at least 2 reports and its refit interval greater than 0");
+	return -1;
+    }
+
+    if (config->report.top_k > 0 && streq(config->report.rank_event, RANKING_POWER_KEY) && !config->report.power_group) {
+	zsys_error("config: the power model must be enabled to rank the targets by their estimated power");
+	return -1;
+    }
+
+    if (config->report.top_k > 0 && (config->report.tail_interval == 0 || config->report.rank_period == 0)) {
+	zsys_error("config: the tail interval and the rank period must be greater than 0 when the targets are ranked");
+	return -1;
+    }
+
+    if (config->report.attribution && sensor->callchains_per_report == 0) {
+	zsys_error("config: the callchains must be sampled to attribute the values of the targets to their functions");
+	return -1;
+    }
+
     if (zhashx_size(events->system) == 0 && zhashx_size(events->containers) == 0) {
 	zsys_error("config: you must provide event(s) to monitor");
 	return -1;
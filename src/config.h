@@ -37,6 +37,10 @@
 
 #include "events.h"
 #include "storage.h"
+#include "report_queue.h"
+#include "discovery.h"
+#include "metric.h"
+#include "ranking.h"
 
 /*
  * config_sensor stores sensor specific config.
@@ -45,9 +49,23 @@ struct config_sensor
 {
     unsigned int verbose;
     unsigned int frequency;
+    unsigned int read_period; /* period (in milliseconds) of the internal reads accumulated until the report, 0 if disabled */
     unsigned int callchains_per_report;
+    unsigned int workers;
+    unsigned int discovery_rescan_interval;
+    enum discovery_aggregation aggregation;
+    unsigned int activity_threshold;
+    unsigned int idle_period;
+    unsigned int shard_index; /* index of the shard of the targets monitored by this sensor */
+    unsigned int shard_count; /* number of sensors sharing the targets of the host */
+    unsigned int burst_period; /* tick period (in milliseconds) of the high resolution capture windows, 0 if disabled */
+    unsigned int burst_duration; /* duration (in milliseconds) of a capture window */
+    unsigned int burst_callchain_frequency; /* callchain sampling frequency during a capture window, 0 to keep the regular one */
+    uint64_t burst_trigger_threshold; /* value of the trigger event over a read period that starts a capture window */
     const char *cgroup_basepath;
     const char *name;
+    const char *handover_socket; /* path of the unix socket used to hand over the perf fds to a new sensor, NULL if disabled */
+    const char *burst_trigger_event; /* event starting a capture window when exceeding the threshold, NULL if only started by SIGUSR1 */
 };
 
 /*
@@ -60,6 +78,29 @@ struct config_storage
     const char *D_flag;
     const char *C_flag;
     int P_flag;
+    enum metric_output output; /* values emitted by the storage: the raw events, the derived metrics, or both */
+};
+
+/*
+ * config_report stores reporting specific config.
+ */
+struct config_report
+{
+    unsigned int queue_size;
+    enum report_queue_policy queue_policy;
+    bool suppress_idle; /* the idle reports are suppressed, and summarized in heartbeats */
+    unsigned int idle_threshold; /* a report is idle if the value of each of its events is lower or equal */
+    unsigned int heartbeat_period; /* in milliseconds */
+    const char *power_group; /* events group (system and containers) whose events are the inputs of the power model, NULL if disabled */
+    const char *power_energy_event; /* RAPL event of the system measuring the energy of the packages */
+    unsigned int power_window; /* number of reports of the system used to fit the power model */
+    unsigned int power_refit_interval; /* number of reports of the system between two fits of the power model */
+    unsigned int top_k; /* number of targets reported at full rate, 0 if every target is */
+    const char *rank_event; /* event weighting the targets, or "power" for their estimated power */
+    enum ranking_tail rank_tail; /* policy applied to the reports of the targets outside of the top K */
+    unsigned int tail_interval; /* a report of the long tail is stored every tail_interval reports of the target */
+    unsigned int rank_period; /* in milliseconds */
+    bool attribution; /* the values of the targets are attributed to the functions of their sampled callchains */
 };
 
 /*
@@ -78,6 +119,7 @@ struct config
 {
     struct config_sensor sensor;
     struct config_storage storage;
+    struct config_report report;
     struct config_events events;
 };
 
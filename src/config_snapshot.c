@@ -0,0 +1,273 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config_snapshot.h"
+#include "events.h"
+#include "hwinfo.h"
+
+static void
+config_snapshot_free(struct config_snapshot *snapshot)
+{
+    size_t i;
+
+    if (snapshot->groups) {
+        for (i = 0; i < snapshot->num_groups; i++) {
+            free(snapshot->groups[i].events);
+            metric_plan_release(&snapshot->groups[i].metrics);
+        }
+    }
+
+    if (snapshot->pkgs) {
+        for (i = 0; i < snapshot->num_pkgs; i++) {
+            free(snapshot->pkgs[i].cpus_id);
+            free(snapshot->pkgs[i].cores_id);
+            free(snapshot->pkgs[i].cores_index);
+        }
+    }
+
+    free(snapshot->groups);
+    free(snapshot->pkgs);
+    zhashx_destroy(&snapshot->events_groups);
+    hwinfo_destroy(snapshot->hwinfo);
+    free(snapshot);
+}
+
+/*
+ * config_snapshot_build_metrics compile the metrics of the group, whose operands are its events and their enabled and running times.
+ */
+static int
+config_snapshot_build_metrics(struct config_snapshot_group *group, zhashx_t *definitions)
+{
+    const char **operands = NULL;
+    size_t i;
+
+    operands = calloc(group->num_events + 2, sizeof(char *));
+    if (!operands)
+        return -1;
+
+    operands[0] = "time_enabled";
+    operands[1] = "time_running";
+    for (i = 0; i < group->num_events; i++)
+        operands[2 + i] = group->events[i]->name;
+
+    group->metrics = metric_plan_create(definitions, operands, group->num_events + 2);
+    free(operands);
+
+    if (!group->metrics) {
+        zsys_error("config: failed to compile the metrics of group %s", group->name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+config_snapshot_build_groups(struct config_snapshot *snapshot, unsigned int default_period, unsigned int read_period)
+{
+    struct events_group *events_group = NULL;
+    struct config_snapshot_group *group = NULL;
+    const struct event_config *event = NULL;
+
+    snapshot->groups = calloc(zhashx_size(snapshot->events_groups), sizeof(struct config_snapshot_group));
+    if (!snapshot->groups && zhashx_size(snapshot->events_groups))
+        return -1;
+
+    for (events_group = zhashx_first(snapshot->events_groups); events_group; events_group = zhashx_next(snapshot->events_groups)) {
+        group = &snapshot->groups[snapshot->num_groups++];
+        group->name = zhashx_cursor(snapshot->events_groups);
+        group->type = events_group->type;
+        group->period = (events_group->period) ? events_group->period : default_period;
+        group->read_period = (read_period && read_period < group->period) ? read_period : 0;
+        group->level = events_group->level;
+        group->events = calloc(zlistx_size(events_group->events), sizeof(struct event_config *));
+        if (!group->events && zlistx_size(events_group->events))
+            return -1;
+
+        for (event = zlistx_first(events_group->events); event; event = zlistx_next(events_group->events))
+            group->events[group->num_events++] = event;
+
+        if (zhashx_size(events_group->metrics) && config_snapshot_build_metrics(group, events_group->metrics))
+            return -1;
+    }
+
+    return 0;
+}
+
+static int
+config_snapshot_build_pkgs(struct config_snapshot *snapshot)
+{
+    struct hwinfo_pkg *hwinfo_pkg = NULL;
+    struct config_snapshot_pkg *pkg = NULL;
+    const char *cpu_id = NULL;
+    const char *core_id = NULL;
+    size_t cpu_i;
+
+    snapshot->pkgs = calloc(zhashx_size(snapshot->hwinfo->pkgs), sizeof(struct config_snapshot_pkg));
+    if (!snapshot->pkgs && zhashx_size(snapshot->hwinfo->pkgs))
+        return -1;
+
+    for (hwinfo_pkg = zhashx_first(snapshot->hwinfo->pkgs); hwinfo_pkg; hwinfo_pkg = zhashx_next(snapshot->hwinfo->pkgs)) {
+        pkg = &snapshot->pkgs[snapshot->num_pkgs++];
+        pkg->id = zhashx_cursor(snapshot->hwinfo->pkgs);
+        pkg->cpus_id = calloc(zlistx_size(hwinfo_pkg->cpus_id), sizeof(char *));
+        pkg->cores_id = calloc(zlistx_size(hwinfo_pkg->cpus_id), sizeof(char *));
+        pkg->cores_index = calloc(zlistx_size(hwinfo_pkg->cpus_id), sizeof(size_t));
+        if ((!pkg->cpus_id || !pkg->cores_id || !pkg->cores_index) && zlistx_size(hwinfo_pkg->cpus_id))
+            return -1;
+
+        for (cpu_id = zlistx_first(hwinfo_pkg->cpus_id); cpu_id; cpu_id = zlistx_next(hwinfo_pkg->cpus_id)) {
+            core_id = zhashx_lookup(hwinfo_pkg->cores_id, cpu_id);
+            pkg->cores_id[pkg->num_cpus] = (core_id) ? core_id : cpu_id;
+
+            /* the sibling threads of a core share its index, so their counters are summed without comparing their core id */
+            for (cpu_i = 0; cpu_i < pkg->num_cpus && !streq(pkg->cores_id[cpu_i], pkg->cores_id[pkg->num_cpus]); cpu_i++)
+                ;
+            pkg->cores_index[pkg->num_cpus] = (cpu_i < pkg->num_cpus) ? pkg->cores_index[cpu_i] : pkg->num_cores++;
+
+            pkg->cpus_id[pkg->num_cpus++] = cpu_id;
+        }
+    }
+
+    return 0;
+}
+
+struct config_snapshot *
+config_snapshot_create(struct hwinfo *hwinfo, zhashx_t *events_groups, unsigned int default_period, unsigned int read_period)
+{
+    struct config_snapshot *snapshot = calloc(1, sizeof(struct config_snapshot));
+
+    if (!snapshot)
+        return NULL;
+
+    atomic_init(&snapshot->refcount, 1);
+
+    /* the containers are copied once, then only accessed through the arrays pointing to their items */
+    snapshot->hwinfo = hwinfo_dup(hwinfo);
+    snapshot->events_groups = zhashx_dup(events_groups);
+    if (!snapshot->hwinfo || !snapshot->events_groups)
+        goto error;
+
+    if (config_snapshot_build_groups(snapshot, default_period, read_period) || config_snapshot_build_pkgs(snapshot))
+        goto error;
+
+    return snapshot;
+
+error:
+    zsys_error("config: failed to build the configuration snapshot");
+    config_snapshot_free(snapshot);
+    return NULL;
+}
+
+struct config_snapshot *
+config_snapshot_acquire(struct config_snapshot *snapshot)
+{
+    if (snapshot)
+        atomic_fetch_add_explicit(&snapshot->refcount, 1, memory_order_relaxed);
+
+    return snapshot;
+}
+
+void
+config_snapshot_release(struct config_snapshot **snapshot_ptr)
+{
+    if (!*snapshot_ptr)
+        return;
+
+    /* the last reference frees the snapshot, after all the accesses made through the other references */
+    if (atomic_fetch_sub_explicit(&(*snapshot_ptr)->refcount, 1, memory_order_acq_rel) == 1)
+        config_snapshot_free(*snapshot_ptr);
+
+    *snapshot_ptr = NULL;
+}
+
+const struct config_snapshot_group *
+config_snapshot_find_group(const struct config_snapshot *snapshot, const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < snapshot->num_groups; i++) {
+        if (streq(snapshot->groups[i].name, name))
+            return &snapshot->groups[i];
+    }
+
+    return NULL;
+}
+
+bool
+config_snapshot_group_equal(const struct config_snapshot_group *a, const struct config_snapshot_group *b)
+{
+    size_t i;
+
+    if (a->type != b->type || a->num_events != b->num_events)
+        return false;
+
+    for (i = 0; i < a->num_events; i++) {
+        if (!streq(a->events[i]->name, b->events[i]->name) || memcmp(&a->events[i]->attr, &b->events[i]->attr, sizeof(struct perf_event_attr)))
+            return false;
+    }
+
+    return true;
+}
+
+bool
+config_snapshot_equal(const struct config_snapshot *a, const struct config_snapshot *b)
+{
+    const struct config_snapshot_group *group = NULL;
+    size_t i;
+
+    if (!a || !b)
+        return a == b;
+
+    if (a->num_groups != b->num_groups)
+        return false;
+
+    for (i = 0; i < a->num_groups; i++) {
+        group = config_snapshot_find_group(b, a->groups[i].name);
+        if (!group || group->period != a->groups[i].period || group->read_period != a->groups[i].read_period || group->level != a->groups[i].level || !metric_plan_equal(group->metrics, a->groups[i].metrics) || !config_snapshot_group_equal(&a->groups[i], group))
+            return false;
+    }
+
+    return true;
+}
+
+void
+config_snapshot_swap(struct config_snapshot *_Atomic *slot, struct config_snapshot *snapshot)
+{
+    struct config_snapshot *previous = atomic_exchange(slot, snapshot);
+
+    config_snapshot_release(&previous);
+}
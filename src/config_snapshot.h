@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <czmq.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "events.h"
+#include "hwinfo.h"
+#include "metric.h"
+
+/*
+ * config_snapshot_group stores an events group of the snapshot.
+ */
+struct config_snapshot_group
+{
+    const char *name;
+    enum events_group_monitoring_type type;
+    unsigned int period; /* in milliseconds, the counters of the group are read once per period */
+    unsigned int read_period; /* in milliseconds, the counters are read at this faster rate and accumulated until the period elapses, 0 if not */
+    enum events_group_level level; /* the counters of the cpus are summed up to this level before being reported */
+    size_t num_events;
+    const struct event_config **events;
+    struct metric_plan *metrics; /* derived metrics computed from the events, NULL if the group has none */
+};
+
+/*
+ * config_snapshot_pkg stores a cpu package of the snapshot.
+ */
+struct config_snapshot_pkg
+{
+    const char *id;
+    size_t num_cpus;
+    const char **cpus_id;
+    const char **cores_id; /* core of each cpu, at the same index */
+    size_t *cores_index; /* index of the core of each cpu among the distinct cores of the package, at the same index */
+    size_t num_cores;
+};
+
+/*
+ * config_snapshot stores the hardware topology and the events groups shared by the monitoring actors.
+ * The snapshot is immutable and only exposes arrays, because iterating the czmq containers moves their cursor.
+ * It is reference counted, and freed when the last actor using it releases it.
+ */
+struct config_snapshot
+{
+    atomic_uint refcount;
+    struct hwinfo *hwinfo; /* storage of the packages, not accessed after the snapshot is built */
+    zhashx_t *events_groups; /* storage of the groups, not accessed after the snapshot is built */
+    size_t num_groups;
+    struct config_snapshot_group *groups;
+    size_t num_pkgs;
+    struct config_snapshot_pkg *pkgs;
+};
+
+/*
+ * config_snapshot_create build a snapshot from a copy of the given hardware topology and events groups.
+ * The groups not declaring their own period are read at the given default period (in milliseconds).
+ * The groups having a longer period than the read period (in milliseconds, 0 if disabled) are read at this faster rate.
+ * The returned snapshot holds one reference, owned by the caller.
+ */
+struct config_snapshot *config_snapshot_create(struct hwinfo *hwinfo, zhashx_t *events_groups, unsigned int default_period, unsigned int read_period);
+
+/*
+ * config_snapshot_acquire take a new reference on the snapshot, and returns it.
+ */
+struct config_snapshot *config_snapshot_acquire(struct config_snapshot *snapshot);
+
+/*
+ * config_snapshot_release drop a reference on the snapshot, which is freed when it was the last one.
+ */
+void config_snapshot_release(struct config_snapshot **snapshot_ptr);
+
+/*
+ * config_snapshot_find_group returns the events group of the snapshot having the given name, or NULL if not found.
+ */
+const struct config_snapshot_group *config_snapshot_find_group(const struct config_snapshot *snapshot, const char *name);
+
+/*
+ * config_snapshot_group_equal returns true if the events groups have the same monitoring type and events, in the same order.
+ * The period is not compared, because it does not require to open the counters again.
+ */
+bool config_snapshot_group_equal(const struct config_snapshot_group *a, const struct config_snapshot_group *b);
+
+/*
+ * config_snapshot_equal returns true if the snapshots have the same events groups, periods, read periods, levels and metrics. (the hardware topology is not compared)
+ */
+bool config_snapshot_equal(const struct config_snapshot *a, const struct config_snapshot *b);
+
+/*
+ * config_snapshot_swap atomically replace the snapshot stored in the slot, and release the reference of the previous one.
+ * The actors started with the previous snapshot keep using it until they release it.
+ */
+void config_snapshot_swap(struct config_snapshot *_Atomic *slot, struct config_snapshot *snapshot);
+
+#endif /* CONFIG_SNAPSHOT_H */
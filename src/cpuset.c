@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpuset.h"
+
+static void
+cpuset_set(struct cpuset *cpuset, long cpu)
+{
+    cpuset->mask[cpu / 64] |= UINT64_C(1) << (cpu % 64);
+}
+
+int
+cpuset_parse(const char *cpu_list, struct cpuset *cpuset)
+{
+    const char *str = cpu_list;
+    char *endp = NULL;
+    long first;
+    long last;
+    long cpu;
+
+    memset(cpuset, 0, sizeof(struct cpuset));
+
+    while (*str && *str != '\n') {
+        errno = 0;
+        first = strtol(str, &endp, 10);
+        if (endp == str || errno || first < 0 || first >= CPUSET_MAX_CPUS)
+            return -1;
+
+        last = first;
+        str = endp;
+        if (*str == '-') {
+            str++;
+            last = strtol(str, &endp, 10);
+            if (endp == str || errno || last < first || last >= CPUSET_MAX_CPUS)
+                return -1;
+
+            str = endp;
+        }
+
+        for (cpu = first; cpu <= last; cpu++)
+            cpuset_set(cpuset, cpu);
+
+        if (*str == ',')
+            str++;
+        else if (*str && !isspace((unsigned char) *str))
+            return -1;
+    }
+
+    return 0;
+}
+
+bool
+cpuset_is_set(const struct cpuset *cpuset, long cpu)
+{
+    if (cpu < 0 || cpu >= CPUSET_MAX_CPUS)
+        return false;
+
+    return (cpuset->mask[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+unsigned int
+cpuset_count(const struct cpuset *cpuset)
+{
+    unsigned int count = 0;
+    size_t i;
+
+    for (i = 0; i < CPUSET_MAX_CPUS / 64; i++)
+        count += (unsigned int) __builtin_popcountll(cpuset->mask[i]);
+
+    return count;
+}
+
+bool
+cpuset_equal(const struct cpuset *a, const struct cpuset *b)
+{
+    return memcmp(a->mask, b->mask, sizeof(a->mask)) == 0;
+}
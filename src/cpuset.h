@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPUSET_H
+#define CPUSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * CPUSET_MAX_CPUS is the maximum number of cpus that can be stored in a cpuset.
+ */
+#define CPUSET_MAX_CPUS 4096
+
+/*
+ * cpuset stores a set of cpus as a bitmask.
+ */
+struct cpuset
+{
+    uint64_t mask[CPUSET_MAX_CPUS / 64];
+};
+
+/*
+ * cpuset_parse parse a cpu list (as in the cpuset.cpus files, e.g. "0-3,8,10-11") into the cpuset.
+ */
+int cpuset_parse(const char *cpu_list, struct cpuset *cpuset);
+
+/*
+ * cpuset_is_set returns true if the cpu is part of the cpuset.
+ */
+bool cpuset_is_set(const struct cpuset *cpuset, long cpu);
+
+/*
+ * cpuset_count returns the number of cpus of the cpuset.
+ */
+unsigned int cpuset_count(const struct cpuset *cpuset);
+
+/*
+ * cpuset_equal returns true if the two cpusets contains the same cpus.
+ */
+bool cpuset_equal(const struct cpuset *a, const struct cpuset *b);
+
+#endif /* CPUSET_H */
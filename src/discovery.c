@@ -0,0 +1,556 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <fts.h>
+#include <libgen.h>
+#include <linux/magic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include "discovery.h"
+#include "target.h"
+#include "target_classifier.h"
+#include "util.h"
+
+/*
+ * DISCOVERY_DIR_WATCH_MASK is the inotify events watched on the cgroup directories.
+ */
+#define DISCOVERY_DIR_WATCH_MASK (IN_CREATE | IN_DELETE | IN_ONLYDIR)
+
+/*
+ * DISCOVERY_EVENTS_WATCH_MASK is the inotify events watched on the cgroup.events files. (cgroup v2 only)
+ */
+#define DISCOVERY_EVENTS_WATCH_MASK (IN_MODIFY)
+
+/*
+ * DISCOVERY_EVENTS_FILENAME is the name of the file reporting the populated state of a cgroup. (cgroup v2 only)
+ */
+#define DISCOVERY_EVENTS_FILENAME "cgroup.events"
+
+/*
+ * DISCOVERY_INOTIFY_BUFFER_SIZE is the size of the buffer used to read the inotify events.
+ */
+#define DISCOVERY_INOTIFY_BUFFER_SIZE 16384
+
+const char *discovery_aggregations_name[] = {
+    [DISCOVERY_AGGREGATION_UNKNOWN] = "unknown",
+    [DISCOVERY_AGGREGATION_CONTAINER] = "container",
+    [DISCOVERY_AGGREGATION_POD] = "pod",
+    [DISCOVERY_AGGREGATION_SLICE] = "slice",
+};
+
+enum discovery_aggregation
+discovery_aggregation_get_type(const char *aggregation_name)
+{
+    if (strcasecmp(aggregation_name, discovery_aggregations_name[DISCOVERY_AGGREGATION_CONTAINER]) == 0)
+        return DISCOVERY_AGGREGATION_CONTAINER;
+
+    if (strcasecmp(aggregation_name, discovery_aggregations_name[DISCOVERY_AGGREGATION_POD]) == 0)
+        return DISCOVERY_AGGREGATION_POD;
+
+    if (strcasecmp(aggregation_name, discovery_aggregations_name[DISCOVERY_AGGREGATION_SLICE]) == 0)
+        return DISCOVERY_AGGREGATION_SLICE;
+
+    return DISCOVERY_AGGREGATION_UNKNOWN;
+}
+
+static void
+target_ptr_destroy(struct target **target_ptr)
+{
+    if (!*target_ptr)
+        return;
+
+    target_destroy(*target_ptr);
+    *target_ptr = NULL;
+}
+
+static struct target_classification *
+target_classification_dup(const struct target_classification *classification)
+{
+    struct target_classification *copy = malloc(sizeof(struct target_classification));
+
+    if (copy)
+        *copy = *classification;
+
+    return copy;
+}
+
+static bool
+is_cgroup_populated(const char *cgroup_path)
+{
+    char path[PATH_MAX] = {0};
+    char line[64] = {0};
+    FILE *f = NULL;
+    bool populated = true; /* assume populated if the state cannot be read */
+
+    snprintf(path, PATH_MAX, "%s/%s", cgroup_path, DISCOVERY_EVENTS_FILENAME);
+
+    f = fopen(path, "r");
+    if (!f)
+        return populated;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "populated ", 10) == 0) {
+            populated = (line[10] == '1');
+            break;
+        }
+    }
+
+    fclose(f);
+    return populated;
+}
+
+static void
+discovery_add_watch(struct discovery *discovery, const char *path, uint32_t mask)
+{
+    char wd_key[16] = {0};
+    int wd;
+
+    wd = inotify_add_watch(discovery->inotify_fd, path, mask);
+    if (wd == -1) {
+        /* the directory can be removed before being watched, the next rescan will reconcile */
+        if (errno != ENOENT)
+            zsys_warning("discovery: failed to watch %s: %s", path, strerror(errno));
+        return;
+    }
+
+    snprintf(wd_key, sizeof(wd_key), "%d", wd);
+    zhashx_update(discovery->watches, wd_key, (void *) path);
+}
+
+/*
+ * discovery_remove_leaf remove the cgroup from the running leaves, and its target when it was the last leaf aggregated into it.
+ */
+static void
+discovery_remove_leaf(struct discovery *discovery, const char *cgroup_path)
+{
+    const char *target_path = zhashx_lookup(discovery->leaves, cgroup_path);
+    int *num_leaves = NULL;
+
+    if (!target_path)
+        return;
+
+    num_leaves = zhashx_lookup(discovery->members, target_path);
+    if (!num_leaves || --(*num_leaves) <= 0) {
+        zhashx_delete(discovery->targets, target_path);
+        zhashx_delete(discovery->members, target_path);
+    }
+
+    zhashx_delete(discovery->leaves, cgroup_path);
+}
+
+/*
+ * is_parent_path returns true if the path is a descendant of the parent path.
+ */
+static bool
+is_parent_path(const char *parent_path, const char *path)
+{
+    size_t length = strlen(parent_path);
+
+    return strncmp(parent_path, path, length) == 0 && path[length] == '/';
+}
+
+/*
+ * is_nested_target returns true if the path is an ancestor or a descendant of the path of a target.
+ */
+static bool
+is_nested_target(struct discovery *discovery, const char *path)
+{
+    struct target *target = NULL;
+    const char *target_path = NULL;
+
+    for (target = zhashx_first(discovery->targets); target; target = zhashx_next(discovery->targets)) {
+        target_path = zhashx_cursor(discovery->targets);
+        if (is_parent_path(path, target_path) || is_parent_path(target_path, path))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * discovery_add_leaf add the cgroup to the running leaves, and create its target according to the aggregation level.
+ */
+static void
+discovery_add_leaf(struct discovery *discovery, const char *cgroup_path, const struct target_classification *classification)
+{
+    char target_path[PATH_MAX] = {0};
+    size_t target_path_length = 0;
+    int *num_leaves = NULL;
+    int one = 1;
+    struct target *target = NULL;
+
+    if (zhashx_lookup(discovery->leaves, cgroup_path))
+        return;
+
+    /* only the containers of a pod can be aggregated, the others are always monitored individually */
+    if (discovery->aggregation == DISCOVERY_AGGREGATION_POD)
+        target_path_length = classification->pod_path_length;
+    else if (discovery->aggregation == DISCOVERY_AGGREGATION_SLICE)
+        target_path_length = (classification->slice_path_length) ? classification->slice_path_length : classification->pod_path_length; /* the Guaranteed pods have no slice */
+
+    if (target_path_length && target_path_length < PATH_MAX)
+        snprintf(target_path, PATH_MAX, "%.*s", (int) target_path_length, cgroup_path);
+    else
+        snprintf(target_path, PATH_MAX, "%s", cgroup_path);
+
+    /* the counters of a cgroup include the ones of its children, so an aggregated target never contains another target */
+    if (!streq(target_path, cgroup_path) && !zhashx_lookup(discovery->members, target_path) && is_nested_target(discovery, target_path)) {
+        zsys_warning("discovery: cgroup %s contains other targets, %s is monitored individually", target_path, cgroup_path);
+        snprintf(target_path, PATH_MAX, "%s", cgroup_path);
+    }
+
+    /* the shard is chosen from the target path, so all the containers of an aggregated target belong to the same shard */
+    if (discovery->shard_count > 1 && strhash(target_path) % discovery->shard_count != discovery->shard_index)
+        return;
+
+    num_leaves = zhashx_lookup(discovery->members, target_path);
+    if (num_leaves) {
+        (*num_leaves)++;
+    }
+    else {
+        /* the aggregated targets are not a single container, their name is the cgroup path */
+        target = target_create(classification->type, discovery->base_path, target_path, (streq(target_path, cgroup_path)) ? classification->container_id : NULL);
+        if (!target)
+            return;
+
+        zhashx_insert(discovery->targets, target_path, target);
+        zhashx_insert(discovery->members, target_path, &one);
+    }
+
+    zhashx_insert(discovery->leaves, cgroup_path, target_path);
+}
+
+static void
+discovery_forget_cgroup(struct discovery *discovery, const char *cgroup_path)
+{
+    discovery_remove_leaf(discovery, cgroup_path);
+    zhashx_delete(discovery->classifications, cgroup_path);
+}
+
+/*
+ * discovery_evaluate_cgroup add or remove the cgroup from the targets set according to its current state.
+ */
+static void
+discovery_evaluate_cgroup(struct discovery *discovery, const char *cgroup_path, const struct stat *cgroup_stat)
+{
+    struct stat st = {0};
+    struct target_classification *classification = NULL;
+    struct target_classification result = {0};
+    char events_path[PATH_MAX] = {0};
+
+    if (!cgroup_stat) {
+        if (stat(cgroup_path, &st) == -1) {
+            discovery_forget_cgroup(discovery, cgroup_path);
+            return;
+        }
+        cgroup_stat = &st;
+    }
+
+    /*
+     * Only the leaves directories are targets, they have 2 hard links leading to them.
+     * The cgroup subsystems does not support hard links, so this will always work.
+     */
+    if (!S_ISDIR(cgroup_stat->st_mode) || cgroup_stat->st_nlink != 2) {
+        discovery_remove_leaf(discovery, cgroup_path);
+        return;
+    }
+
+    /* the classification of a known cgroup is reused, unless the cgroup have been re-created */
+    classification = zhashx_lookup(discovery->classifications, cgroup_path);
+    if (!classification || classification->inode != cgroup_stat->st_ino) {
+        discovery_remove_leaf(discovery, cgroup_path);
+        target_classify(cgroup_path, &result);
+        result.inode = cgroup_stat->st_ino;
+        zhashx_update(discovery->classifications, cgroup_path, &result);
+        classification = zhashx_lookup(discovery->classifications, cgroup_path);
+        if (!classification)
+            return;
+    }
+
+    if (!(classification->type & discovery->type_mask)) {
+        discovery_remove_leaf(discovery, cgroup_path);
+        return;
+    }
+
+    if (discovery->unified) {
+        /* the populated state changes are notified as a modification of the cgroup.events file */
+        snprintf(events_path, PATH_MAX, "%s/%s", cgroup_path, DISCOVERY_EVENTS_FILENAME);
+        discovery_add_watch(discovery, events_path, DISCOVERY_EVENTS_WATCH_MASK);
+
+        if (!is_cgroup_populated(cgroup_path)) {
+            discovery_remove_leaf(discovery, cgroup_path);
+            return;
+        }
+    }
+
+    discovery_add_leaf(discovery, cgroup_path, classification);
+}
+
+/*
+ * discovery_scan walk the given cgroup hierarchy to watch its directories and evaluate its cgroups.
+ */
+static int
+discovery_scan(struct discovery *discovery, const char *root_path)
+{
+    const char *path[] = { root_path, NULL };
+    FTS *file_system = NULL;
+    FTSENT *node = NULL;
+
+    file_system = fts_open((char * const *)path, FTS_LOGICAL | FTS_NOCHDIR, NULL);
+    if (!file_system)
+        return -1;
+
+    for (node = fts_read(file_system); node; node = fts_read(file_system)) {
+        if (node->fts_info == FTS_D) {
+            discovery_add_watch(discovery, node->fts_path, DISCOVERY_DIR_WATCH_MASK);
+            discovery_evaluate_cgroup(discovery, node->fts_path, node->fts_statp);
+        }
+    }
+
+    fts_close(file_system);
+    return 0;
+}
+
+static int
+discovery_rescan(struct discovery *discovery)
+{
+    zlistx_t *known_cgroups = NULL;
+    const char *cgroup_path = NULL;
+    struct stat st = {0};
+
+    /* forget the cgroups that have been removed without being notified */
+    known_cgroups = zhashx_keys(discovery->classifications);
+    for (cgroup_path = zlistx_first(known_cgroups); cgroup_path; cgroup_path = zlistx_next(known_cgroups)) {
+        if (stat(cgroup_path, &st) == -1)
+            discovery_forget_cgroup(discovery, cgroup_path);
+    }
+    zlistx_destroy(&known_cgroups);
+
+    discovery->rescan_needed = false;
+    discovery->last_rescan = zclock_mono();
+
+    /* the watches are idempotent, re-adding them on existing directories is harmless */
+    if (discovery_scan(discovery, discovery->base_path)) {
+        zsys_error("discovery: failed to scan cgroup hierarchy at %s", discovery->base_path);
+        discovery->rescan_needed = true;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+discovery_remove_subtree(struct discovery *discovery, const char *cgroup_path)
+{
+    zlistx_t *known_cgroups = NULL;
+    const char *known_path = NULL;
+    size_t length = strlen(cgroup_path);
+
+    known_cgroups = zhashx_keys(discovery->classifications);
+    for (known_path = zlistx_first(known_cgroups); known_path; known_path = zlistx_next(known_cgroups)) {
+        if (strncmp(known_path, cgroup_path, length) == 0 && (known_path[length] == '\0' || known_path[length] == '/'))
+            discovery_forget_cgroup(discovery, known_path);
+    }
+    zlistx_destroy(&known_cgroups);
+}
+
+static void
+discovery_handle_event(struct discovery *discovery, const struct inotify_event *event)
+{
+    char wd_key[16] = {0};
+    const char *watch_entry = NULL;
+    char watch_path[PATH_MAX] = {0};
+    char path[PATH_MAX] = {0};
+
+    if (event->mask & IN_Q_OVERFLOW) {
+        zsys_warning("discovery: inotify queue overflow, a full rescan will be done");
+        discovery->rescan_needed = true;
+        return;
+    }
+
+    snprintf(wd_key, sizeof(wd_key), "%d", event->wd);
+    watch_entry = zhashx_lookup(discovery->watches, wd_key);
+    if (!watch_entry)
+        return;
+
+    /* the watches entries can be replaced while handling the event */
+    snprintf(watch_path, PATH_MAX, "%s", watch_entry);
+
+    /* the watched directory or file have been removed */
+    if (event->mask & IN_IGNORED) {
+        zhashx_delete(discovery->watches, wd_key);
+        return;
+    }
+
+    /* populated state change of a cgroup (cgroup v2 only) */
+    if (event->mask & IN_MODIFY) {
+        discovery_evaluate_cgroup(discovery, dirname(watch_path), NULL);
+        return;
+    }
+
+    if (!(event->mask & IN_ISDIR) || !event->len)
+        return;
+
+    if (snprintf(path, PATH_MAX, "%s/%s", watch_path, event->name) >= PATH_MAX)
+        return;
+
+    if (event->mask & IN_CREATE) {
+        /* the sub-directories can be created before the watch is set, so the whole subtree is scanned */
+        discovery_scan(discovery, path);
+    }
+    else if (event->mask & IN_DELETE) {
+        discovery_remove_subtree(discovery, path);
+    }
+
+    /* the parent cgroup can become (or stop being) a leaf */
+    discovery_evaluate_cgroup(discovery, watch_path, NULL);
+}
+
+static int
+discovery_process_events(struct discovery *discovery)
+{
+    char buffer[DISCOVERY_INOTIFY_BUFFER_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event = NULL;
+    ssize_t length;
+    char *ptr = NULL;
+
+    for (;;) {
+        length = read(discovery->inotify_fd, buffer, sizeof(buffer));
+        if (length == -1) {
+            if (errno == EAGAIN)
+                return 0;
+
+            zsys_error("discovery: failed to read inotify events: %s", strerror(errno));
+            return -1;
+        }
+
+        for (ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) ptr;
+            discovery_handle_event(discovery, event);
+        }
+    }
+}
+
+struct discovery *
+discovery_create(const char *base_path, enum target_type type_mask, enum discovery_aggregation aggregation, unsigned int rescan_interval, unsigned int shard_index, unsigned int shard_count)
+{
+    struct discovery *discovery = malloc(sizeof(struct discovery));
+    struct statfs fs = {0};
+
+    if (!discovery)
+        return NULL;
+
+    discovery->base_path = base_path;
+    discovery->unified = (statfs(base_path, &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC);
+    discovery->aggregation = aggregation;
+
+    /* every service and session have its own leaf cgroup in the unified hierarchy, so only the identified targets are monitored */
+    discovery->type_mask = (discovery->unified) ? (type_mask & ~TARGET_TYPE_UNKNOWN) : type_mask;
+    discovery->shard_index = shard_index;
+    discovery->shard_count = shard_count;
+    discovery->rescan_interval = rescan_interval;
+    discovery->last_rescan = 0;
+    discovery->rescan_needed = true;
+
+    discovery->watches = zhashx_new();
+    zhashx_set_duplicator(discovery->watches, (zhashx_duplicator_fn *) strdup);
+    zhashx_set_destructor(discovery->watches, (zhashx_destructor_fn *) ptrfree);
+
+    discovery->classifications = zhashx_new();
+    zhashx_set_duplicator(discovery->classifications, (zhashx_duplicator_fn *) target_classification_dup);
+    zhashx_set_destructor(discovery->classifications, (zhashx_destructor_fn *) ptrfree);
+
+    discovery->leaves = zhashx_new();
+    zhashx_set_duplicator(discovery->leaves, (zhashx_duplicator_fn *) strdup);
+    zhashx_set_destructor(discovery->leaves, (zhashx_destructor_fn *) ptrfree);
+
+    discovery->members = zhashx_new();
+    zhashx_set_duplicator(discovery->members, (zhashx_duplicator_fn *) intptrdup);
+    zhashx_set_destructor(discovery->members, (zhashx_destructor_fn *) ptrfree);
+
+    discovery->targets = zhashx_new();
+    zhashx_set_destructor(discovery->targets, (zhashx_destructor_fn *) target_ptr_destroy);
+
+    errno = 0;
+    discovery->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (discovery->inotify_fd == -1) {
+        zsys_error("discovery: failed to initialize inotify: %s", strerror(errno));
+        discovery_destroy(discovery);
+        return NULL;
+    }
+
+    if (discovery_rescan(discovery)) {
+        discovery_destroy(discovery);
+        return NULL;
+    }
+
+    zsys_info("discovery: watching %zu cgroup(s) of the %s hierarchy at %s (aggregation=%s shard=%u/%u)", zhashx_size(discovery->watches), discovery->unified ? "v2" : "v1", base_path, discovery_aggregations_name[aggregation], shard_index, shard_count);
+    return discovery;
+}
+
+int
+discovery_update(struct discovery *discovery)
+{
+    int ret = discovery_process_events(discovery);
+
+    if (ret)
+        discovery->rescan_needed = true;
+
+    if (discovery->rescan_needed || zclock_mono() - discovery->last_rescan >= (int64_t) discovery->rescan_interval)
+        ret = discovery_rescan(discovery);
+
+    return ret;
+}
+
+void
+discovery_destroy(struct discovery *discovery)
+{
+    if (!discovery)
+        return;
+
+    if (discovery->inotify_fd != -1)
+        close(discovery->inotify_fd);
+
+    zhashx_destroy(&discovery->watches);
+    zhashx_destroy(&discovery->leaves);
+    zhashx_destroy(&discovery->members);
+    zhashx_destroy(&discovery->targets);
+    zhashx_destroy(&discovery->classifications);
+    free(discovery);
+}
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <czmq.h>
+#include <stdbool.h>
+
+#include "target.h"
+
+/*
+ * discovery_aggregation stores the supported levels of aggregation of the containers.
+ */
+enum discovery_aggregation
+{
+    DISCOVERY_AGGREGATION_UNKNOWN,
+    DISCOVERY_AGGREGATION_CONTAINER,
+    DISCOVERY_AGGREGATION_POD,
+    DISCOVERY_AGGREGATION_SLICE
+};
+
+/*
+ * discovery_aggregations_name stores the name (as string) of the supported aggregation levels.
+ */
+extern const char *discovery_aggregations_name[];
+
+/*
+ * discovery stores the state of the incremental discovery of the running targets.
+ * The cgroup hierarchy is watched using inotify, and a full rescan is only done periodically to reconcile the targets set.
+ */
+struct discovery
+{
+    const char *base_path;
+    enum target_type type_mask;
+    enum discovery_aggregation aggregation;
+    bool unified; /* cgroup v2 hierarchy, the cgroup.events files are watched */
+    int inotify_fd;
+    zhashx_t *watches; /* char *watch_descriptor -> char *path */
+    zhashx_t *classifications; /* char *cgroup_path -> struct target_classification *classification */
+    zhashx_t *leaves; /* char *cgroup_path -> char *target_path (running leaves only) */
+    zhashx_t *members; /* char *target_path -> int *num_leaves */
+    zhashx_t *targets; /* char *target_path -> struct target *target */
+    unsigned int shard_index;
+    unsigned int shard_count; /* the targets are spread over the sensors according to the hash of their path */
+    unsigned int rescan_interval; /* in milliseconds */
+    int64_t last_rescan;
+    bool rescan_needed;
+};
+
+/*
+ * discovery_aggregation_get_type returns the aggregation level corresponding to the given name.
+ */
+enum discovery_aggregation discovery_aggregation_get_type(const char *aggregation_name);
+
+/*
+ * discovery_create allocate the resources and do the initial discovery of the running targets.
+ * The containers of a pod are monitored as a single target at the pod or slice aggregation levels.
+ * Only the targets belonging to the given shard are discovered, the other shards are monitored by other sensors.
+ */
+struct discovery *discovery_create(const char *base_path, enum target_type type_mask, enum discovery_aggregation aggregation, unsigned int rescan_interval, unsigned int shard_index, unsigned int shard_count);
+
+/*
+ * discovery_update apply the pending changes of the cgroup hierarchy to the targets set, and do a full rescan when needed.
+ */
+int discovery_update(struct discovery *discovery);
+
+/*
+ * discovery_destroy free the allocated resources of the discovery.
+ */
+void discovery_destroy(struct discovery *discovery);
+
+#endif /* DISCOVERY_H */
@@ -32,10 +32,37 @@
 #include <czmq.h>
 #include <perfmon/pfmlib_perf_event.h>
 #include <stdlib.h>
+#include <strings.h>
 
 #include "events.h"
 #include "util.h"
 
+const char *events_group_levels_name[] = {
+    [EVENTS_GROUP_LEVEL_UNKNOWN] = "unknown",
+    [EVENTS_GROUP_LEVEL_CPU] = "cpu",
+    [EVENTS_GROUP_LEVEL_CORE] = "core",
+    [EVENTS_GROUP_LEVEL_PACKAGE] = "package",
+    [EVENTS_GROUP_LEVEL_HOST] = "host",
+};
+
+enum events_group_level
+events_group_level_get_type(const char *level_name)
+{
+    if (strcasecmp(level_name, events_group_levels_name[EVENTS_GROUP_LEVEL_CPU]) == 0)
+        return EVENTS_GROUP_LEVEL_CPU;
+
+    if (strcasecmp(level_name, events_group_levels_name[EVENTS_GROUP_LEVEL_CORE]) == 0)
+        return EVENTS_GROUP_LEVEL_CORE;
+
+    if (strcasecmp(level_name, events_group_levels_name[EVENTS_GROUP_LEVEL_PACKAGE]) == 0)
+        return EVENTS_GROUP_LEVEL_PACKAGE;
+
+    if (strcasecmp(level_name, events_group_levels_name[EVENTS_GROUP_LEVEL_HOST]) == 0)
+        return EVENTS_GROUP_LEVEL_HOST;
+
+    return EVENTS_GROUP_LEVEL_UNKNOWN;
+}
+
 static int
 setup_perf_event_attr(const char *event_name, struct perf_event_attr *attr)
 {
@@ -104,10 +131,16 @@ events_group_create(const char *name)
     if (group) {
         group->name = name;
         group->type = MONITOR_ALL_CPU_PER_SOCKET; /* by default, monitor all cpu of the available socket(s) */
+        group->period = 0;
+        group->level = EVENTS_GROUP_LEVEL_CPU; /* by default, report the counters of every cpu */
 
         group->events = zlistx_new();
         zlistx_set_duplicator(group->events, (zlistx_duplicator_fn *) event_config_dup);
         zlistx_set_destructor(group->events, (zlistx_destructor_fn *) event_config_destroy);
+
+        group->metrics = zhashx_new();
+        zhashx_set_duplicator(group->metrics, (zhashx_duplicator_fn *) strdup);
+        zhashx_set_destructor(group->metrics, (zhashx_destructor_fn *) ptrfree);
     }
 
     return group;
@@ -123,7 +156,10 @@ events_group_dup(struct events_group *group)
         if (copy) {
             copy->name = group->name;
             copy->type = group->type;
+            copy->period = group->period;
+            copy->level = group->level;
             copy->events = zlistx_dup(group->events);
+            copy->metrics = zhashx_dup(group->metrics);
         }
     }
 
@@ -148,11 +184,22 @@ events_group_append_event(struct events_group *group, const char *event_name)
     return ret;
 }
 
+int
+events_group_add_metric(struct events_group *group, const char *metric_name, const char *expression)
+{
+    if (!group || !metric_name || !*metric_name || !expression)
+        return -1;
+
+    zhashx_update(group->metrics, metric_name, (void *) expression);
+    return 0;
+}
+
 void
 events_group_destroy(struct events_group **group)
 {
     if (*group) {
         zlistx_destroy(&(*group)->events);
+        zhashx_destroy(&(*group)->metrics);
         free(*group);
     }
 }
@@ -44,6 +44,23 @@ enum events_group_monitoring_type
     MONITOR_ONE_CPU_PER_SOCKET
 };
 
+/*
+ * events_group_level stores the levels at which the counters of an events group can be reported.
+ */
+enum events_group_level
+{
+    EVENTS_GROUP_LEVEL_UNKNOWN,
+    EVENTS_GROUP_LEVEL_CPU,
+    EVENTS_GROUP_LEVEL_CORE,
+    EVENTS_GROUP_LEVEL_PACKAGE,
+    EVENTS_GROUP_LEVEL_HOST
+};
+
+/*
+ * events_group_levels_name stores the name (as string) of the supported report levels.
+ */
+extern const char *events_group_levels_name[];
+
 /*
  * event_config is the event configuration container.
  */
@@ -60,9 +77,17 @@ struct events_group
 {
     const char *name;
     enum events_group_monitoring_type type;
+    unsigned int period; /* in milliseconds, 0 to use the frequency of the sensor */
+    enum events_group_level level; /* the counters of the cpus are summed up to this level before being reported */
     zlistx_t *events; /* struct event_config *event */
+    zhashx_t *metrics; /* char *metric_name -> char *expression */
 };
 
+/*
+ * events_group_level_get_type returns the report level corresponding to the given name.
+ */
+enum events_group_level events_group_level_get_type(const char *level_name);
+
 /*
  * event_config_create allocate the required resources for the event config container.
  */
@@ -93,6 +118,11 @@ struct events_group *events_group_dup(struct events_group *group);
  */
 int events_group_append_event(struct events_group *group, const char *event_name);
 
+/*
+ * events_group_add_metric store the expression of a derived metric computed from the events of the group.
+ */
+int events_group_add_metric(struct events_group *group, const char *metric_name, const char *expression);
+
 /*
  * events_group_destroy free the allocated resources of the events group container.
  */
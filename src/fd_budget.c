@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "fd_budget.h"
+
+struct fd_budget *
+fd_budget_create(long capacity)
+{
+    struct fd_budget *budget = malloc(sizeof(struct fd_budget));
+
+    if (!budget)
+        return NULL;
+
+    budget->capacity = capacity;
+    atomic_init(&budget->available, capacity);
+    atomic_init(&budget->waiting, 0);
+
+    return budget;
+}
+
+bool
+fd_budget_acquire(struct fd_budget *budget, long count)
+{
+    long available = atomic_load_explicit(&budget->available, memory_order_relaxed);
+
+    do {
+        if (available < count)
+            return false;
+    } while (!atomic_compare_exchange_weak_explicit(&budget->available, &available, available - count, memory_order_relaxed, memory_order_relaxed));
+
+    return true;
+}
+
+void
+fd_budget_release(struct fd_budget *budget, long count)
+{
+    atomic_fetch_add_explicit(&budget->available, count, memory_order_relaxed);
+}
+
+void
+fd_budget_wait(struct fd_budget *budget, bool waiting)
+{
+    atomic_fetch_add_explicit(&budget->waiting, waiting ? 1 : -1, memory_order_relaxed);
+}
+
+bool
+fd_budget_has_waiters(struct fd_budget *budget)
+{
+    return atomic_load_explicit(&budget->waiting, memory_order_relaxed) > 0;
+}
+
+void
+fd_budget_destroy(struct fd_budget *budget)
+{
+    free(budget);
+}
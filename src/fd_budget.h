@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FD_BUDGET_H
+#define FD_BUDGET_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/*
+ * fd_budget stores the number of file descriptors available for the perf events, shared by all the monitoring workers.
+ */
+struct fd_budget
+{
+    long capacity;
+    atomic_long available;
+    atomic_long waiting; /* number of rotating targets waiting for a slot */
+};
+
+/*
+ * fd_budget_create allocate the resources of a budget of the given number of file descriptors.
+ */
+struct fd_budget *fd_budget_create(long capacity);
+
+/*
+ * fd_budget_acquire reserve the given number of file descriptors, returns false if not enough are available.
+ */
+bool fd_budget_acquire(struct fd_budget *budget, long count);
+
+/*
+ * fd_budget_release give back the given number of file descriptors to the budget.
+ */
+void fd_budget_release(struct fd_budget *budget, long count);
+
+/*
+ * fd_budget_wait register a rotating target waiting for a slot, or unregister it if waiting is false.
+ */
+void fd_budget_wait(struct fd_budget *budget, bool waiting);
+
+/*
+ * fd_budget_has_waiters returns true if rotating targets are waiting for a slot.
+ */
+bool fd_budget_has_waiters(struct fd_budget *budget);
+
+/*
+ * fd_budget_destroy free the allocated resources of the budget.
+ */
+void fd_budget_destroy(struct fd_budget *budget);
+
+#endif /* FD_BUDGET_H */
@@ -0,0 +1,483 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "handover.h"
+
+/*
+ * HANDOVER_VERSION is the version of the records exchanged by the sensors, the handover is refused on mismatch.
+ */
+#define HANDOVER_VERSION 1
+
+/*
+ * HANDOVER_RECEIVE_TIMEOUT is the maximum time (in seconds) to wait for a record from the previous sensor.
+ */
+#define HANDOVER_RECEIVE_TIMEOUT 10
+
+/*
+ * handover_record_kind stores the kinds of records exchanged by the sensors.
+ */
+enum handover_record_kind
+{
+    HANDOVER_RECORD_TARGET = 1,
+    HANDOVER_RECORD_CPU,
+    HANDOVER_RECORD_END,
+    HANDOVER_RECORD_ABORT
+};
+
+/*
+ * handover_record is the state descriptor sent with the fds, one record per message of the seqpacket socket.
+ */
+struct handover_record
+{
+    uint32_t version;
+    uint32_t kind;
+    uint32_t num_fds;
+    char target_key[1024];
+    char group_name[256];
+    char cpu_id[32];
+    struct handover_event events[HANDOVER_MAX_FDS];
+};
+
+static struct handover_cpu *
+handover_cpu_create(void)
+{
+    struct handover_cpu *cpu = malloc(sizeof(struct handover_cpu));
+
+    if (!cpu)
+        return NULL;
+
+    cpu->num_fds = 0;
+    return cpu;
+}
+
+static void
+handover_cpu_destroy(struct handover_cpu **cpu_ptr)
+{
+    unsigned int i;
+
+    if (!*cpu_ptr)
+        return;
+
+    for (i = 0; i < (*cpu_ptr)->num_fds; i++)
+        close((*cpu_ptr)->fds[i]);
+
+    free(*cpu_ptr);
+    *cpu_ptr = NULL;
+}
+
+static struct handover_target *
+handover_target_create(void)
+{
+    struct handover_target *target = malloc(sizeof(struct handover_target));
+
+    if (!target)
+        return NULL;
+
+    target->cgroup_fd = -1;
+    pthread_mutex_init(&target->lock, NULL);
+    target->cpus = zhashx_new();
+    zhashx_set_destructor(target->cpus, (zhashx_destructor_fn *) handover_cpu_destroy);
+
+    return target;
+}
+
+void
+handover_target_destroy(struct handover_target **target_ptr)
+{
+    if (!*target_ptr)
+        return;
+
+    if ((*target_ptr)->cgroup_fd != -1)
+        close((*target_ptr)->cgroup_fd);
+
+    zhashx_destroy(&(*target_ptr)->cpus);
+    pthread_mutex_destroy(&(*target_ptr)->lock);
+    free(*target_ptr);
+    *target_ptr = NULL;
+}
+
+static struct handover_state *
+handover_state_create(void)
+{
+    struct handover_state *state = malloc(sizeof(struct handover_state));
+
+    if (!state)
+        return NULL;
+
+    /* the targets are destroyed explicitly because they can be taken out of the state */
+    state->targets = zhashx_new();
+
+    return state;
+}
+
+void
+handover_state_destroy(struct handover_state **state_ptr)
+{
+    struct handover_target *target = NULL;
+
+    if (!*state_ptr)
+        return;
+
+    for (target = zhashx_first((*state_ptr)->targets); target; target = zhashx_next((*state_ptr)->targets))
+        handover_target_destroy(&target);
+
+    zhashx_destroy(&(*state_ptr)->targets);
+    free(*state_ptr);
+    *state_ptr = NULL;
+}
+
+struct handover_target *
+handover_state_take_target(struct handover_state *state, const char *target_key)
+{
+    struct handover_target *target = NULL;
+
+    if (!state)
+        return NULL;
+
+    target = zhashx_lookup(state->targets, target_key);
+    if (target)
+        zhashx_delete(state->targets, target_key);
+
+    return target;
+}
+
+int
+handover_target_take_cpu(struct handover_target *target, const char *group_name, const char *cpu_id, const struct handover_event *events, unsigned int num_events, int *fds)
+{
+    char cpu_key[512];
+    struct handover_cpu *cpu = NULL;
+    unsigned int i;
+
+    if (!target)
+        return -1;
+
+    snprintf(cpu_key, sizeof(cpu_key), "%s:%s", group_name, cpu_id);
+    pthread_mutex_lock(&target->lock);
+    cpu = zhashx_lookup(target->cpus, cpu_key);
+    if (!cpu)
+        goto mismatch;
+
+    /* the events of the group may have changed between the two sensors */
+    if (cpu->num_fds != num_events)
+        goto mismatch;
+
+    for (i = 0; i < num_events; i++) {
+        if (cpu->events[i].type != events[i].type || cpu->events[i].config != events[i].config)
+            goto mismatch;
+    }
+
+    memcpy(fds, cpu->fds, num_events * sizeof(int));
+    cpu->num_fds = 0;
+    zhashx_delete(target->cpus, cpu_key);
+    pthread_mutex_unlock(&target->lock);
+    return 0;
+
+mismatch:
+    zhashx_delete(target->cpus, cpu_key);
+    pthread_mutex_unlock(&target->lock);
+    return -1;
+}
+
+static int
+handover_send_record(int sock, struct handover_record *record, const int *fds)
+{
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {.iov_base = record, .iov_len = sizeof(struct handover_record)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+    struct cmsghdr *cmsg = NULL;
+
+    record->version = HANDOVER_VERSION;
+
+    if (record->num_fds > 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * record->num_fds);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * record->num_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * record->num_fds);
+    }
+
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) != (ssize_t) sizeof(struct handover_record)) {
+        zsys_error("handover: failed to send record: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+handover_receive_record(int sock, struct handover_record *record, int *fds)
+{
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {.iov_base = record, .iov_len = sizeof(struct handover_record)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer)};
+    struct cmsghdr *cmsg = NULL;
+    unsigned int num_fds = 0;
+    unsigned int i;
+
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != (ssize_t) sizeof(struct handover_record)) {
+        zsys_error("handover: failed to receive record: %s", strerror(errno));
+        return -1;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+        }
+    }
+
+    /* the received fds are closed if they do not match the descriptor */
+    if (record->version != HANDOVER_VERSION || (msg.msg_flags & MSG_CTRUNC) || num_fds != record->num_fds) {
+        zsys_error("handover: received an invalid record");
+        for (i = 0; i < num_fds; i++)
+            close(fds[i]);
+        return -1;
+    }
+
+    record->target_key[sizeof(record->target_key) - 1] = '\0';
+    record->group_name[sizeof(record->group_name) - 1] = '\0';
+    record->cpu_id[sizeof(record->cpu_id) - 1] = '\0';
+    return 0;
+}
+
+static int
+handover_store_record(struct handover_state *state, const struct handover_record *record, const int *fds)
+{
+    struct handover_target *target = zhashx_lookup(state->targets, record->target_key);
+    struct handover_cpu *cpu = NULL;
+    char cpu_key[512];
+
+    if (!target) {
+        target = handover_target_create();
+        if (!target)
+            return -1;
+
+        zhashx_insert(state->targets, record->target_key, target);
+    }
+
+    if (record->kind == HANDOVER_RECORD_TARGET) {
+        if (target->cgroup_fd != -1)
+            close(target->cgroup_fd);
+
+        target->cgroup_fd = (record->num_fds == 1) ? fds[0] : -1;
+        return 0;
+    }
+
+    cpu = handover_cpu_create();
+    if (!cpu)
+        return -1;
+
+    cpu->num_fds = record->num_fds;
+    memcpy(cpu->fds, fds, record->num_fds * sizeof(int));
+    memcpy(cpu->events, record->events, record->num_fds * sizeof(struct handover_event));
+
+    snprintf(cpu_key, sizeof(cpu_key), "%s:%s", record->group_name, record->cpu_id);
+    zhashx_update(target->cpus, cpu_key, cpu);
+    return 0;
+}
+
+static int
+handover_socket_address(const char *socket_path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(socket_path) >= sizeof(addr->sun_path)) {
+        zsys_error("handover: socket path is too long: %s", socket_path);
+        return -1;
+    }
+
+    strcpy(addr->sun_path, socket_path);
+    return 0;
+}
+
+struct handover_state *
+handover_receive(const char *socket_path, bool *aborted)
+{
+    struct sockaddr_un addr;
+    struct timeval timeout = {.tv_sec = HANDOVER_RECEIVE_TIMEOUT, .tv_usec = 0};
+    struct handover_state *state = NULL;
+    struct handover_record record;
+    int fds[HANDOVER_MAX_FDS];
+    unsigned int num_records = 0;
+    unsigned int i;
+    int sock;
+
+    *aborted = false;
+
+    if (handover_socket_address(socket_path, &addr))
+        return NULL;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        zsys_error("handover: failed to create socket: %s", strerror(errno));
+        return NULL;
+    }
+
+    /* no sensor is running, this is a regular start */
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(sock);
+        return NULL;
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    zsys_info("handover: receiving the perf fds of the running sensor from %s", socket_path);
+
+    state = handover_state_create();
+    if (!state)
+        goto error;
+
+    for (;;) {
+        if (handover_receive_record(sock, &record, fds))
+            goto error;
+
+        if (record.kind == HANDOVER_RECORD_END)
+            break;
+
+        /* the running sensor failed to send its counters and keeps monitoring the targets */
+        if (record.kind == HANDOVER_RECORD_ABORT) {
+            zsys_error("handover: the running sensor aborted the handover");
+            *aborted = true;
+            goto error;
+        }
+
+        if ((record.kind != HANDOVER_RECORD_TARGET && record.kind != HANDOVER_RECORD_CPU) || handover_store_record(state, &record, fds)) {
+            for (i = 0; i < record.num_fds; i++)
+                close(fds[i]);
+            goto error;
+        }
+
+        num_records++;
+    }
+
+    close(sock);
+    zsys_info("handover: received %u record(s) for %zu target(s)", num_records, zhashx_size(state->targets));
+    return state;
+
+error:
+    zsys_error("handover: failed to receive the perf fds, the counters will be opened again");
+    close(sock);
+    handover_state_destroy(&state);
+    return NULL;
+}
+
+int
+handover_listen(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if (handover_socket_address(socket_path, &addr))
+        return -1;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        zsys_error("handover: failed to create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    /* the socket of the previous sensor is replaced */
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) || listen(sock, 1)) {
+        zsys_error("handover: failed to listen on %s: %s", socket_path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+int
+handover_send_target(int sock, const char *target_key, int cgroup_fd)
+{
+    struct handover_record record = {0};
+
+    record.kind = HANDOVER_RECORD_TARGET;
+    record.num_fds = (cgroup_fd > -1) ? 1 : 0;
+    snprintf(record.target_key, sizeof(record.target_key), "%s", target_key);
+
+    return handover_send_record(sock, &record, &cgroup_fd);
+}
+
+int
+handover_send_cpu(int sock, const char *target_key, const char *group_name, const char *cpu_id, const struct handover_event *events, const int *fds, unsigned int num_fds)
+{
+    struct handover_record record = {0};
+
+    if (num_fds > HANDOVER_MAX_FDS)
+        return -1;
+
+    record.kind = HANDOVER_RECORD_CPU;
+    record.num_fds = num_fds;
+    snprintf(record.target_key, sizeof(record.target_key), "%s", target_key);
+    snprintf(record.group_name, sizeof(record.group_name), "%s", group_name);
+    snprintf(record.cpu_id, sizeof(record.cpu_id), "%s", cpu_id);
+    memcpy(record.events, events, num_fds * sizeof(struct handover_event));
+
+    return handover_send_record(sock, &record, fds);
+}
+
+int
+handover_send_end(int sock)
+{
+    struct handover_record record = {0};
+
+    record.kind = HANDOVER_RECORD_END;
+    return handover_send_record(sock, &record, NULL);
+}
+
+int
+handover_send_abort(int sock)
+{
+    struct handover_record record = {0};
+
+    record.kind = HANDOVER_RECORD_ABORT;
+    return handover_send_record(sock, &record, NULL);
+}
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HANDOVER_H
+#define HANDOVER_H
+
+#include <czmq.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * HANDOVER_MAX_FDS is the maximum number of perf events of a group that can be handed over for a cpu.
+ */
+#define HANDOVER_MAX_FDS 64
+
+/*
+ * handover_event stores the identity of a handed over perf event, used to check it matches the configured event.
+ */
+struct handover_event
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+/*
+ * handover_cpu stores the perf fds of an events group for a cpu, received from the previous sensor.
+ */
+struct handover_cpu
+{
+    unsigned int num_fds;
+    int fds[HANDOVER_MAX_FDS];
+    struct handover_event events[HANDOVER_MAX_FDS];
+};
+
+/*
+ * handover_target stores the fds of a target received from the previous sensor.
+ */
+struct handover_target
+{
+    int cgroup_fd; /* -1 if not handed over */
+    pthread_mutex_t lock; /* the cpus are taken by the threads opening the counters of the packages */
+    zhashx_t *cpus; /* char *group_name:cpu_id -> struct handover_cpu *cpu */
+};
+
+/*
+ * handover_state stores the fds of all the targets received from the previous sensor.
+ */
+struct handover_state
+{
+    zhashx_t *targets; /* char *target_key -> struct handover_target *target */
+};
+
+/*
+ * handover_receive connect to the handover socket of a running sensor and receive its perf fds.
+ * Returns NULL if no sensor is listening on the socket, or if the handover failed.
+ * The aborted flag is set if the running sensor failed to send its fds, and keeps monitoring the targets.
+ */
+struct handover_state *handover_receive(const char *socket_path, bool *aborted);
+
+/*
+ * handover_state_take_target remove the fds of the target from the state, the caller takes their ownership.
+ */
+struct handover_target *handover_state_take_target(struct handover_state *state, const char *target_key);
+
+/*
+ * handover_state_destroy close the fds that have not been taken and free the allocated resources.
+ */
+void handover_state_destroy(struct handover_state **state_ptr);
+
+/*
+ * handover_target_take_cpu move the fds of the events group for the cpu into the given array.
+ * Returns 0 if the handed over events match the given ones, otherwise their fds are closed and -1 is returned.
+ */
+int handover_target_take_cpu(struct handover_target *target, const char *group_name, const char *cpu_id, const struct handover_event *events, unsigned int num_events, int *fds);
+
+/*
+ * handover_target_destroy close the fds that have not been taken and free the allocated resources.
+ */
+void handover_target_destroy(struct handover_target **target_ptr);
+
+/*
+ * handover_listen create the handover socket waiting for a new sensor, returns its fd or -1 on error.
+ */
+int handover_listen(const char *socket_path);
+
+/*
+ * handover_send_target send the cgroup fd of a target to the new sensor.
+ */
+int handover_send_target(int sock, const char *target_key, int cgroup_fd);
+
+/*
+ * handover_send_cpu send the perf fds of an events group for a cpu to the new sensor.
+ */
+int handover_send_cpu(int sock, const char *target_key, const char *group_name, const char *cpu_id, const struct handover_event *events, const int *fds, unsigned int num_fds);
+
+/*
+ * handover_send_end notify the new sensor that all the fds have been sent.
+ */
+int handover_send_end(int sock);
+
+/*
+ * handover_send_abort notify the new sensor that the handover failed, and that the current sensor keeps monitoring the targets.
+ */
+int handover_send_abort(int sock);
+
+#endif /* HANDOVER_H */
@@ -61,6 +61,10 @@ hwinfo_pkg_create(void)
     zlistx_set_duplicator(pkg->cpus_id, (zlistx_duplicator_fn *) strdup);
     zlistx_set_destructor(pkg->cpus_id, (zlistx_destructor_fn *) ptrfree);
 
+    pkg->cores_id = zhashx_new();
+    zhashx_set_duplicator(pkg->cores_id, (zhashx_duplicator_fn *) strdup);
+    zhashx_set_destructor(pkg->cores_id, (zhashx_destructor_fn *) ptrfree);
+
     return pkg;
 }
 
@@ -73,6 +77,7 @@ hwinfo_pkg_dup(struct hwinfo_pkg *pkg)
         return NULL;
 
     pkgcpy->cpus_id = zlistx_dup(pkg->cpus_id);
+    pkgcpy->cores_id = zhashx_dup(pkg->cores_id);
 
     return pkgcpy;
 }
@@ -84,6 +89,7 @@ hwinfo_pkg_destroy(struct hwinfo_pkg **pkg_ptr)
         return;
 
     zlistx_destroy(&(*pkg_ptr)->cpus_id);
+    zhashx_destroy(&(*pkg_ptr)->cores_id);
     free(*pkg_ptr);
     *pkg_ptr = NULL;
 }
@@ -135,6 +141,27 @@ get_package_id(const char *cpu_dir)
     return id;
 }
 
+static char *
+get_core_id(const char *cpu_dir)
+{
+    FILE *f = NULL;
+    char path[PATH_MAX] = {0};
+    char buffer[24]; /* log10(ULLONG_MAX) */
+    char *id = NULL;
+
+    snprintf(path, PATH_MAX, "%s/%s/topology/core_id", SYSFS_CPU_PATH, cpu_dir);
+
+    f = fopen(path, "r");
+    if (f) {
+        if (fgets(buffer, sizeof(buffer), f)) {
+            id = strndup(buffer, strlen(buffer) - 1);
+        }
+        fclose(f);
+    }
+
+    return id;
+}
+
 static char *
 parse_cpu_id_from_name(const char *str)
 {
@@ -161,6 +188,7 @@ do_packages_detection(struct hwinfo *hwinfo)
     int cpu_online;
     char *cpu_id = NULL;
     char *pkg_id = NULL;
+    char *core_id = NULL;
     struct hwinfo_pkg *pkg = NULL;
 
     dir = opendir(SYSFS_CPU_PATH);
@@ -206,6 +234,12 @@ do_packages_detection(struct hwinfo *hwinfo)
 
             zlistx_add_end(pkg->cpus_id, cpu_id);
 
+            /* the core of the cpu is optional and the cpu is its own core when unknown */
+            core_id = get_core_id(entry->d_name);
+            zhashx_insert(pkg->cores_id, cpu_id, (core_id) ? core_id : cpu_id);
+            free(core_id);
+            core_id = NULL;
+
             free(cpu_id);
             cpu_id = NULL;
             free(pkg_id);
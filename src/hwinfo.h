@@ -42,6 +42,7 @@
 struct hwinfo_pkg
 {
     zlistx_t *cpus_id; /* char *cpu_id */
+    zhashx_t *cores_id; /* char *cpu_id -> char *core_id */
 };
 
 /*
@@ -0,0 +1,491 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <czmq.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "metric.h"
+#include "util.h"
+
+/*
+ * METRIC_OPERATORS stores the characters of the supported operators.
+ */
+#define METRIC_OPERATORS "+-*/"
+
+const char *metric_outputs_name[] = {
+    [METRIC_OUTPUT_UNKNOWN] = "unknown",
+    [METRIC_OUTPUT_RAW] = "raw",
+    [METRIC_OUTPUT_METRICS] = "metrics",
+    [METRIC_OUTPUT_BOTH] = "both",
+};
+
+enum metric_output
+metric_output_get_type(const char *output_name)
+{
+    if (strcasecmp(output_name, metric_outputs_name[METRIC_OUTPUT_RAW]) == 0)
+        return METRIC_OUTPUT_RAW;
+
+    if (strcasecmp(output_name, metric_outputs_name[METRIC_OUTPUT_METRICS]) == 0)
+        return METRIC_OUTPUT_METRICS;
+
+    if (strcasecmp(output_name, metric_outputs_name[METRIC_OUTPUT_BOTH]) == 0)
+        return METRIC_OUTPUT_BOTH;
+
+    return METRIC_OUTPUT_UNKNOWN;
+}
+
+/*
+ * metric_compiler stores the state of the compilation of an expression into reverse polish notation. (shunting-yard)
+ */
+struct metric_compiler
+{
+    struct metric *metric;
+    size_t depth; /* depth of the evaluation stack after the emitted instructions */
+    size_t num_pending;
+    char pending[METRIC_MAX_DEPTH]; /* operators and opening parentheses waiting to be emitted */
+};
+
+static int
+get_operator_precedence(char operator)
+{
+    return (operator == '*' || operator == '/') ? 2 : 1;
+}
+
+static int
+emit_op(struct metric_compiler *compiler, enum metric_op_type type, size_t operand, double constant)
+{
+    struct metric_op *op = &compiler->metric->ops[compiler->metric->num_ops++];
+
+    op->type = type;
+    op->operand = operand;
+    op->constant = constant;
+
+    if (type == METRIC_OP_OPERAND || type == METRIC_OP_CONSTANT) {
+        if (++compiler->depth > METRIC_MAX_DEPTH)
+            return -1;
+    }
+    else {
+        compiler->depth--;
+    }
+
+    return 0;
+}
+
+static int
+emit_operator(struct metric_compiler *compiler, char operator)
+{
+    switch (operator) {
+    case '+':
+        return emit_op(compiler, METRIC_OP_ADD, 0, 0.0);
+    case '-':
+        return emit_op(compiler, METRIC_OP_SUB, 0, 0.0);
+    case '*':
+        return emit_op(compiler, METRIC_OP_MUL, 0, 0.0);
+    default:
+        return emit_op(compiler, METRIC_OP_DIV, 0, 0.0);
+    }
+}
+
+static int
+find_operand(const char *name, size_t len, const char **operands, size_t num_operands, size_t *index)
+{
+    size_t i;
+
+    for (i = 0; i < num_operands; i++) {
+        if (strlen(operands[i]) == len && strncmp(operands[i], name, len) == 0) {
+            *index = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * metric_compile compile the expression of the metric into its instructions.
+ */
+static int
+metric_compile(struct metric *metric, const char **operands, size_t num_operands)
+{
+    struct metric_compiler compiler = {.metric = metric};
+    const char *p = metric->expression;
+    char *end = NULL;
+    bool expect_operand = true;
+    size_t operand;
+    size_t len;
+
+    /* every token is at least one character long */
+    metric->ops = calloc(strlen(metric->expression) + 1, sizeof(struct metric_op));
+    if (!metric->ops)
+        return -1;
+
+    while (*p) {
+        if (isspace((unsigned char) *p)) {
+            p++;
+            continue;
+        }
+
+        if (*p == '(') {
+            if (!expect_operand || compiler.num_pending == METRIC_MAX_DEPTH)
+                goto error;
+
+            compiler.pending[compiler.num_pending++] = *p++;
+            continue;
+        }
+
+        if (*p == ')') {
+            if (expect_operand)
+                goto error;
+
+            while (compiler.num_pending && compiler.pending[compiler.num_pending - 1] != '(')
+                emit_operator(&compiler, compiler.pending[--compiler.num_pending]);
+
+            if (!compiler.num_pending)
+                goto error;
+
+            compiler.num_pending--;
+            p++;
+            continue;
+        }
+
+        if (strchr(METRIC_OPERATORS, *p)) {
+            if (expect_operand)
+                goto error;
+
+            while (compiler.num_pending && compiler.pending[compiler.num_pending - 1] != '(' && get_operator_precedence(compiler.pending[compiler.num_pending - 1]) >= get_operator_precedence(*p))
+                emit_operator(&compiler, compiler.pending[--compiler.num_pending]);
+
+            if (compiler.num_pending == METRIC_MAX_DEPTH)
+                goto error;
+
+            compiler.pending[compiler.num_pending++] = *p++;
+            expect_operand = true;
+            continue;
+        }
+
+        if (!expect_operand)
+            goto error;
+
+        if (isdigit((unsigned char) *p) || (*p == '.' && isdigit((unsigned char) p[1]))) {
+            if (emit_op(&compiler, METRIC_OP_CONSTANT, 0, strtod(p, &end)))
+                goto error;
+
+            p = end;
+        }
+        else {
+            len = strcspn(p, " \t\n()" METRIC_OPERATORS);
+            if (find_operand(p, len, operands, num_operands, &operand)) {
+                zsys_error("metric: unknown event '%.*s' in metric %s", (int) len, p, metric->name);
+                return -1;
+            }
+
+            if (emit_op(&compiler, METRIC_OP_OPERAND, operand, 0.0))
+                goto error;
+
+            p += len;
+        }
+
+        expect_operand = false;
+    }
+
+    if (expect_operand)
+        goto error;
+
+    while (compiler.num_pending) {
+        if (compiler.pending[compiler.num_pending - 1] == '(')
+            goto error;
+
+        emit_operator(&compiler, compiler.pending[--compiler.num_pending]);
+    }
+
+    return 0;
+
+error:
+    zsys_error("metric: invalid expression '%s' for metric %s", metric->expression, metric->name);
+    return -1;
+}
+
+static int
+metric_compare_name(const void *a, const void *b)
+{
+    return strcmp(((const struct metric *) a)->name, ((const struct metric *) b)->name);
+}
+
+static void
+metric_plan_free(struct metric_plan *plan)
+{
+    size_t i;
+
+    if (plan->operands) {
+        for (i = 0; i < plan->num_operands; i++)
+            free(plan->operands[i]);
+    }
+
+    if (plan->metrics) {
+        for (i = 0; i < plan->num_metrics; i++) {
+            free(plan->metrics[i].name);
+            free(plan->metrics[i].expression);
+            free(plan->metrics[i].ops);
+        }
+    }
+
+    free(plan->operands);
+    free(plan->metrics);
+    free(plan);
+}
+
+struct metric_plan *
+metric_plan_create(zhashx_t *definitions, const char **events_name, size_t num_events)
+{
+    struct metric_plan *plan = calloc(1, sizeof(struct metric_plan));
+    const char *expression = NULL;
+    struct metric *metric = NULL;
+    size_t operand;
+
+    if (!plan)
+        return NULL;
+
+    atomic_init(&plan->refcount, 1);
+
+    plan->operands = calloc(num_events, sizeof(char *));
+    plan->metrics = calloc(zhashx_size(definitions), sizeof(struct metric));
+    if ((!plan->operands && num_events) || (!plan->metrics && zhashx_size(definitions)))
+        goto error;
+
+    for (plan->num_operands = 0; plan->num_operands < num_events; plan->num_operands++) {
+        plan->operands[plan->num_operands] = strdup(events_name[plan->num_operands]);
+        if (!plan->operands[plan->num_operands])
+            goto error;
+    }
+
+    for (expression = zhashx_first(definitions); expression; expression = zhashx_next(definitions)) {
+        metric = &plan->metrics[plan->num_metrics++];
+        metric->name = strdup(zhashx_cursor(definitions));
+        metric->expression = strdup(expression);
+        if (!metric->name || !metric->expression)
+            goto error;
+
+        /* the metrics are reported next to the events, their names cannot be mixed up */
+        if (find_operand(metric->name, strlen(metric->name), events_name, num_events, &operand) == 0) {
+            zsys_error("metric: the metric %s has the name of an event", metric->name);
+            goto error;
+        }
+
+        if (metric_compile(metric, events_name, num_events))
+            goto error;
+    }
+
+    /* the metrics are ordered by name, to be compared and reported in a stable order */
+    qsort(plan->metrics, plan->num_metrics, sizeof(struct metric), metric_compare_name);
+
+    return plan;
+
+error:
+    metric_plan_free(plan);
+    return NULL;
+}
+
+struct metric_plan *
+metric_plan_acquire(struct metric_plan *plan)
+{
+    if (plan)
+        atomic_fetch_add_explicit(&plan->refcount, 1, memory_order_relaxed);
+
+    return plan;
+}
+
+void
+metric_plan_release(struct metric_plan **plan_ptr)
+{
+    if (!*plan_ptr)
+        return;
+
+    /* the plan is shared by the monitoring actors and the reporting actor */
+    if (atomic_fetch_sub_explicit(&(*plan_ptr)->refcount, 1, memory_order_acq_rel) == 1)
+        metric_plan_free(*plan_ptr);
+
+    *plan_ptr = NULL;
+}
+
+bool
+metric_plan_equal(const struct metric_plan *a, const struct metric_plan *b)
+{
+    size_t i;
+
+    if (!a || !b)
+        return a == b;
+
+    if (a->num_metrics != b->num_metrics)
+        return false;
+
+    for (i = 0; i < a->num_metrics; i++) {
+        if (!streq(a->metrics[i].name, b->metrics[i].name) || !streq(a->metrics[i].expression, b->metrics[i].expression))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * metric_evaluate run the instructions of the metric on the given operands values, returns false if the metric cannot be computed.
+ */
+static bool
+metric_evaluate(const struct metric *metric, const double *values, double *result)
+{
+    double stack[METRIC_MAX_DEPTH];
+    size_t depth = 0;
+    size_t i;
+    double rhs;
+
+    for (i = 0; i < metric->num_ops; i++) {
+        switch (metric->ops[i].type) {
+        case METRIC_OP_OPERAND:
+            if (isnan(values[metric->ops[i].operand]))
+                return false;
+
+            stack[depth++] = values[metric->ops[i].operand];
+            break;
+        case METRIC_OP_CONSTANT:
+            stack[depth++] = metric->ops[i].constant;
+            break;
+        case METRIC_OP_ADD:
+            rhs = stack[--depth];
+            stack[depth - 1] += rhs;
+            break;
+        case METRIC_OP_SUB:
+            rhs = stack[--depth];
+            stack[depth - 1] -= rhs;
+            break;
+        case METRIC_OP_MUL:
+            rhs = stack[--depth];
+            stack[depth - 1] *= rhs;
+            break;
+        case METRIC_OP_DIV:
+            rhs = stack[--depth];
+            if (rhs == 0.0)
+                return false;
+
+            stack[depth - 1] /= rhs;
+            break;
+        }
+    }
+
+    *result = stack[0];
+    return isfinite(*result);
+}
+
+/*
+ * evaluate_cpu_metrics compute the metrics of the plan from the events values of the cpu.
+ */
+static int
+evaluate_cpu_metrics(const struct metric_plan *plan, struct payload_cpu_data *cpu_data, double *values)
+{
+    zhashx_t *metrics = NULL;
+    const uint64_t *event_value = NULL;
+    double *metric_value = NULL;
+    double result;
+    size_t i;
+
+    metrics = zhashx_new();
+    if (!metrics)
+        return -1;
+
+    zhashx_set_destructor(metrics, (zhashx_destructor_fn *) ptrfree);
+
+    /* the events are looked up once for all the metrics, the missing ones are marked as not a number */
+    for (i = 0; i < plan->num_operands; i++) {
+        event_value = zhashx_lookup(cpu_data->events, plan->operands[i]);
+        values[i] = (event_value) ? (double) *event_value : NAN;
+    }
+
+    for (i = 0; i < plan->num_metrics; i++) {
+        if (!metric_evaluate(&plan->metrics[i], values, &result))
+            continue;
+
+        metric_value = malloc(sizeof(double));
+        if (!metric_value) {
+            zhashx_destroy(&metrics);
+            return -1;
+        }
+
+        *metric_value = result;
+        zhashx_insert(metrics, plan->metrics[i].name, metric_value);
+    }
+
+    zhashx_destroy(&cpu_data->metrics);
+    cpu_data->metrics = metrics;
+    return 0;
+}
+
+int
+metric_evaluate_payload(struct payload *payload, enum metric_output output)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    double *values = NULL;
+
+    if (output == METRIC_OUTPUT_RAW)
+        return 0;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        if (group_data->plan) {
+            values = malloc((group_data->plan->num_operands + 1) * sizeof(double));
+            if (!values)
+                return -1;
+        }
+
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                if (values && evaluate_cpu_metrics(group_data->plan, cpu_data, values)) {
+                    free(values);
+                    return -1;
+                }
+
+                /* only the metrics are emitted, the raw values and their callchains are dropped, unless the group has no metric */
+                if (output == METRIC_OUTPUT_METRICS && group_data->plan)
+                    zhashx_purge(cpu_data->events);
+            }
+        }
+
+        if (output == METRIC_OUTPUT_METRICS && group_data->plan)
+            zhashx_destroy(&group_data->summaries);
+
+        free(values);
+        values = NULL;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef METRIC_H
+#define METRIC_H
+
+#include <czmq.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "payload.h"
+
+/*
+ * METRIC_MAX_DEPTH is the maximum depth of the evaluation stack of a metric expression.
+ */
+#define METRIC_MAX_DEPTH 32
+
+/*
+ * metric_output stores the kind of values emitted by the storage modules.
+ */
+enum metric_output
+{
+    METRIC_OUTPUT_UNKNOWN,
+    METRIC_OUTPUT_RAW,
+    METRIC_OUTPUT_METRICS,
+    METRIC_OUTPUT_BOTH
+};
+
+/*
+ * metric_outputs_name stores the name (as string) of the supported outputs.
+ */
+extern const char *metric_outputs_name[];
+
+/*
+ * metric_op_type stores the type of an instruction of the evaluation plan of a metric.
+ */
+enum metric_op_type
+{
+    METRIC_OP_OPERAND,
+    METRIC_OP_CONSTANT,
+    METRIC_OP_ADD,
+    METRIC_OP_SUB,
+    METRIC_OP_MUL,
+    METRIC_OP_DIV
+};
+
+/*
+ * metric_op stores an instruction of the evaluation plan of a metric.
+ */
+struct metric_op
+{
+    enum metric_op_type type;
+    size_t operand; /* index of the event in the operands of the plan, for METRIC_OP_OPERAND */
+    double constant; /* for METRIC_OP_CONSTANT */
+};
+
+/*
+ * metric stores a derived metric compiled into a sequence of instructions in reverse polish notation.
+ */
+struct metric
+{
+    char *name;
+    char *expression;
+    size_t num_ops;
+    struct metric_op *ops;
+};
+
+/*
+ * metric_plan stores the compiled metrics of an events group.
+ * The plan is immutable and reference counted, because it is shared by the payloads of the group until they are stored.
+ */
+struct metric_plan
+{
+    atomic_uint refcount;
+    size_t num_operands;
+    char **operands; /* name of the events used by the metrics */
+    size_t num_metrics;
+    struct metric *metrics;
+};
+
+/*
+ * metric_output_get_type returns the output corresponding to the given name.
+ */
+enum metric_output metric_output_get_type(const char *output_name);
+
+/*
+ * metric_plan_create compile the given metric expressions, using the given event names as operands.
+ * The expressions support the + - * / operators, parentheses, numeric constants and the names of the events.
+ * The returned plan holds one reference owned by the caller, NULL is returned if an expression is invalid.
+ */
+struct metric_plan *metric_plan_create(zhashx_t *definitions, const char **events_name, size_t num_events);
+
+/*
+ * metric_plan_acquire take a new reference on the plan, and returns it.
+ */
+struct metric_plan *metric_plan_acquire(struct metric_plan *plan);
+
+/*
+ * metric_plan_release drop a reference on the plan, which is freed when it was the last one.
+ */
+void metric_plan_release(struct metric_plan **plan_ptr);
+
+/*
+ * metric_plan_equal returns true if the plans have the same metrics and expressions.
+ */
+bool metric_plan_equal(const struct metric_plan *a, const struct metric_plan *b);
+
+/*
+ * metric_evaluate_payload compute the metrics of every cpu of the groups of the payload, then drop the raw values of the groups having metrics if only the metrics are emitted.
+ * A metric is not reported for a cpu if one of its events is missing or if it divides by zero.
+ */
+int metric_evaluate_payload(struct payload *payload, enum metric_output output);
+
+#endif /* METRIC_H */
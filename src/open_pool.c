@@ -0,0 +1,148 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "open_pool.h"
+
+static void *
+open_pool_thread(void *arg)
+{
+    struct open_pool *pool = arg;
+    struct open_pool_job *job = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->head && !pool->stopped)
+            pthread_cond_wait(&pool->queued, &pool->lock);
+
+        if (!pool->head)
+            break;
+
+        job = pool->head;
+        pool->head = job->next;
+        if (!pool->head)
+            pool->tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+        job->run(job->arg);
+        pthread_mutex_lock(&pool->lock);
+
+        job->done = true;
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+struct open_pool *
+open_pool_create(size_t num_threads)
+{
+    struct open_pool *pool = malloc(sizeof(struct open_pool));
+
+    if (!pool)
+        return NULL;
+
+    pool->num_threads = 0;
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->stopped = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->queued, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (!pool->threads && num_threads)
+        goto error;
+
+    for (; pool->num_threads < num_threads; pool->num_threads++) {
+        if (pthread_create(&pool->threads[pool->num_threads], NULL, open_pool_thread, pool))
+            goto error;
+    }
+
+    return pool;
+
+error:
+    open_pool_destroy(pool);
+    return NULL;
+}
+
+void
+open_pool_submit(struct open_pool *pool, struct open_pool_job *job)
+{
+    job->done = false;
+    job->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+open_pool_wait(struct open_pool *pool, struct open_pool_job *job)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (!job->done)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+open_pool_destroy(struct open_pool *pool)
+{
+    size_t thread_i;
+
+    if (!pool)
+        return;
+
+    /* the queued jobs are run before the threads exit, so no caller waits forever */
+    pthread_mutex_lock(&pool->lock);
+    pool->stopped = true;
+    pthread_cond_broadcast(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (thread_i = 0; thread_i < pool->num_threads; thread_i++)
+        pthread_join(pool->threads[thread_i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->queued);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OPEN_POOL_H
+#define OPEN_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * open_pool_job stores a job run by the threads of an open pool.
+ */
+struct open_pool_job
+{
+    void (*run)(void *arg);
+    void *arg;
+    bool done;
+    struct open_pool_job *next;
+};
+
+/*
+ * open_pool stores the persistent threads opening the counters of the packages, shared by all the monitoring workers.
+ */
+struct open_pool
+{
+    size_t num_threads;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t queued; /* signaled when a job is queued or when the pool is stopped */
+    pthread_cond_t done; /* broadcasted when a job is done */
+    struct open_pool_job *head;
+    struct open_pool_job *tail;
+    bool stopped;
+};
+
+/*
+ * open_pool_create allocate the resources and start the given number of threads of the pool.
+ */
+struct open_pool *open_pool_create(size_t num_threads);
+
+/*
+ * open_pool_submit queue the job to be run by a thread of the pool.
+ */
+void open_pool_submit(struct open_pool *pool, struct open_pool_job *job);
+
+/*
+ * open_pool_wait block until the job has been run by a thread of the pool.
+ */
+void open_pool_wait(struct open_pool *pool, struct open_pool_job *job);
+
+/*
+ * open_pool_destroy stop the threads and free the allocated resources of the pool.
+ */
+void open_pool_destroy(struct open_pool *pool);
+
+#endif /* OPEN_POOL_H */
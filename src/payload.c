@@ -33,8 +33,15 @@
 #include <stdlib.h>
 
 #include "util.h"
+#include "metric.h"
 #include "payload.h"
 
+bool
+payload_is_counter_value(const char *name)
+{
+    return !streq(name, "time_enabled") && !streq(name, "time_running") && !streq(name, "callchain");
+}
+
 struct payload_cpu_data *
 payload_cpu_data_create(void)
 {
@@ -46,12 +53,45 @@ payload_cpu_data_create(void)
     data->events = zhashx_new();
     zhashx_set_duplicator(data->events, (zhashx_duplicator_fn *) uint64ptrdup);
     zhashx_set_destructor(data->events, (zhashx_destructor_fn *) ptrfree);
+    data->metrics = NULL;
 
     return data;
 }
 
 void
 payload_cpu_data_destroy(struct payload_cpu_data **data_ptr)
+{
+    if (!*data_ptr)
+        return;
+
+    zhashx_destroy(&(*data_ptr)->events);
+    zhashx_destroy(&(*data_ptr)->metrics);
+    free(*data_ptr);
+    *data_ptr = NULL;
+}
+
+struct payload_function_data *
+payload_function_data_create(void)
+{
+    struct payload_function_data *data = malloc(sizeof(struct payload_function_data));
+
+    if (!data)
+        return NULL;
+
+    data->samples = 0;
+    data->energy = -1.0;
+    data->events = zhashx_new();
+    if (!data->events) {
+        free(data);
+        return NULL;
+    }
+
+    zhashx_set_destructor(data->events, (zhashx_destructor_fn *) ptrfree);
+    return data;
+}
+
+void
+payload_function_data_destroy(struct payload_function_data **data_ptr)
 {
     if (!*data_ptr)
         return;
@@ -96,6 +136,8 @@ payload_group_data_create(void)
 
     data->pkgs = zhashx_new();
     zhashx_set_destructor(data->pkgs, (zhashx_destructor_fn *) payload_pkg_data_destroy);
+    data->summaries = NULL;
+    data->plan = NULL;
 
     return data;
 }
@@ -107,6 +149,8 @@ payload_group_data_destroy(struct payload_group_data **data_ptr)
         return;
 
     zhashx_destroy(&(*data_ptr)->pkgs);
+    zhashx_destroy(&(*data_ptr)->summaries);
+    metric_plan_release(&(*data_ptr)->plan);
     free(*data_ptr);
     *data_ptr = NULL;
 }
@@ -120,9 +164,16 @@ payload_create(uint64_t timestamp, const char *target_name)
         return NULL;
 
     payload->timestamp = timestamp;
+    payload->interval = 0;
+    payload->burst = false;
+    payload->heartbeat = false;
+    payload->suppressed = 0;
+    payload->power = -1.0;
     payload->target_name = strdup(target_name);
+    payload->labels = NULL;
     payload->groups = zhashx_new();
     zhashx_set_destructor(payload->groups, (zhashx_destructor_fn *) payload_group_data_destroy);
+    payload->functions = NULL;
 
     return payload;
 }
@@ -134,7 +185,145 @@ payload_destroy(struct payload *payload)
         return;
 
     free(payload->target_name);
+    zhashx_destroy(&payload->labels);
     zhashx_destroy(&payload->groups);
+    zhashx_destroy(&payload->functions);
     free(payload);
 }
 
+
+static int
+payload_cpu_data_merge(struct payload_cpu_data *dst, struct payload_cpu_data *src)
+{
+    const char *event_name = NULL;
+    void *src_value = NULL;
+    void *dst_value = NULL;
+    char *callchain = NULL;
+    uint64_t *value = NULL;
+
+    /* values are allocated here, the container must not duplicate them again */
+    zhashx_set_duplicator(dst->events, NULL);
+
+    for (src_value = zhashx_first(src->events); src_value; src_value = zhashx_next(src->events)) {
+        event_name = zhashx_cursor(src->events);
+        dst_value = zhashx_lookup(dst->events, event_name);
+
+        /* callchains are stored as strings in the events container */
+        if (streq(event_name, "callchain")) {
+            if (dst_value) {
+                callchain = malloc(strlen(src_value) + strlen(dst_value) + 1);
+                if (!callchain)
+                    return -1;
+
+                strcpy(callchain, src_value);
+                strcat(callchain, dst_value);
+            }
+            else {
+                callchain = strdup(src_value);
+                if (!callchain)
+                    return -1;
+            }
+
+            zhashx_update(dst->events, event_name, callchain);
+            continue;
+        }
+
+        if (dst_value) {
+            *(uint64_t *) dst_value += *(uint64_t *) src_value;
+            continue;
+        }
+
+        value = uint64dup(*(uint64_t *) src_value);
+        if (!value)
+            return -1;
+
+        zhashx_insert(dst->events, event_name, value);
+    }
+
+    return 0;
+}
+
+int
+payload_group_data_merge(struct payload_group_data *dst, struct payload_group_data *src)
+{
+    struct payload_pkg_data *src_pkg = NULL;
+    struct payload_pkg_data *dst_pkg = NULL;
+    const char *pkg_id = NULL;
+    struct payload_cpu_data *src_cpu = NULL;
+    struct payload_cpu_data *dst_cpu = NULL;
+    const char *cpu_id = NULL;
+
+    /* the merged values cover more than one period */
+    zhashx_destroy(&dst->summaries);
+
+    /* the metrics are evaluated from the merged values when the payload is stored */
+    if (!dst->plan && src->plan)
+        dst->plan = metric_plan_acquire(src->plan);
+
+    for (src_pkg = zhashx_first(src->pkgs); src_pkg; src_pkg = zhashx_next(src->pkgs)) {
+        pkg_id = zhashx_cursor(src->pkgs);
+        dst_pkg = zhashx_lookup(dst->pkgs, pkg_id);
+        if (!dst_pkg) {
+            dst_pkg = payload_pkg_data_create();
+            if (!dst_pkg)
+                return -1;
+
+            zhashx_insert(dst->pkgs, pkg_id, dst_pkg);
+        }
+
+        for (src_cpu = zhashx_first(src_pkg->cpus); src_cpu; src_cpu = zhashx_next(src_pkg->cpus)) {
+            cpu_id = zhashx_cursor(src_pkg->cpus);
+            dst_cpu = zhashx_lookup(dst_pkg->cpus, cpu_id);
+            if (!dst_cpu) {
+                dst_cpu = payload_cpu_data_create();
+                if (!dst_cpu)
+                    return -1;
+
+                zhashx_insert(dst_pkg->cpus, cpu_id, dst_cpu);
+            }
+
+            if (payload_cpu_data_merge(dst_cpu, src_cpu))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+payload_merge(struct payload *dst, struct payload *src)
+{
+    struct payload_group_data *src_group = NULL;
+    struct payload_group_data *dst_group = NULL;
+    const char *group_name = NULL;
+
+    /* the labels of the target can be resolved after the dst payload has been created */
+    if (!dst->labels && src->labels)
+        dst->labels = zhashx_dup(src->labels);
+
+    /* the merged values cover more than one period */
+    dst->interval = 0;
+
+    /* the merged values are only stored apart if they have all been read during a capture window */
+    dst->burst = dst->burst && src->burst;
+    dst->heartbeat = dst->heartbeat && src->heartbeat;
+    dst->suppressed += src->suppressed;
+    dst->power = -1.0;
+
+    for (src_group = zhashx_first(src->groups); src_group; src_group = zhashx_next(src->groups)) {
+        group_name = zhashx_cursor(src->groups);
+        dst_group = zhashx_lookup(dst->groups, group_name);
+        if (!dst_group) {
+            dst_group = payload_group_data_create();
+            if (!dst_group)
+                return -1;
+
+            zhashx_insert(dst->groups, group_name, dst_group);
+        }
+
+        if (payload_group_data_merge(dst_group, src_group))
+            return -1;
+    }
+
+    return 0;
+}
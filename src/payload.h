@@ -33,6 +33,9 @@
 #define PAYLOAD_H
 
 #include <czmq.h>
+#include <stdbool.h>
+
+struct metric_plan;
 
 /*
  * payload_cpu_data stores the events values of a cpu.
@@ -40,6 +43,7 @@
 struct payload_cpu_data
 {
     zhashx_t *events; /* char *event_name -> uint64_t *event_value */
+    zhashx_t *metrics; /* char *metric_name -> double *metric_value, NULL until the metrics are evaluated before storage */
 };
 
 /*
@@ -50,12 +54,37 @@ struct payload_pkg_data
     zhashx_t *cpus; /* char *cpu_id -> struct payload_cpu_data *cpu_data */
 };
 
+/*
+ * payload_event_summary stores the distribution of the rates (per second) of an event over the reads of a report period.
+ */
+struct payload_event_summary
+{
+    unsigned int reads;
+    double min;
+    double max;
+    double p50;
+    double p95;
+    double p99;
+};
+
 /*
  * payload_group_data stores the payloads for an events group.
  */
 struct payload_group_data
 {
     zhashx_t *pkgs; /* char *pkg_id -> struct payload_pkg_data *pkg_data */
+    zhashx_t *summaries; /* char *event_name -> struct payload_event_summary *summary, NULL if the group is not read at a faster rate */
+    struct metric_plan *plan; /* derived metrics of the group (reference), NULL if the group has none */
+};
+
+/*
+ * payload_function_data stores the share of the values of a target attributed to a sampled function.
+ */
+struct payload_function_data
+{
+    unsigned int samples; /* number of callchains sampled in the function */
+    double energy; /* in joules, negative if the energy of the target is unknown */
+    zhashx_t *events; /* char *event_name -> double *event_value */
 };
 
 /*
@@ -64,10 +93,23 @@ struct payload_group_data
 struct payload
 {
     uint64_t timestamp;
+    unsigned int interval; /* period (in milliseconds) of the reported groups, 0 if the values do not cover exactly one period */
+    bool burst; /* true if the values have been read during a high resolution capture window */
+    bool heartbeat; /* true if the payload has no values, and only reports the idle reports suppressed for the target */
+    unsigned int suppressed; /* number of idle reports suppressed, whose values are folded into this one */
+    double power; /* estimated power (in watts) of the target, negative if not estimated */
     char *target_name;
+    zhashx_t *labels; /* char *label_name -> char *label_value, NULL if the target have no labels */
     zhashx_t *groups; /* char *group_name -> struct payload_group_data *group_data */
+    zhashx_t *functions; /* char *function_name -> struct payload_function_data *function_data, NULL until the samples are attributed before storage */
 };
 
+/*
+ * payload_is_counter_value returns true if the value stored under the given name in the events container of a cpu is an event counter.
+ * The time enabled and running of the group, and the sampled callchains are stored alongside the counters.
+ */
+bool payload_is_counter_value(const char *name);
+
 /*
  * payload_create allocate the required resources of a monitoring payload.
  */
@@ -78,6 +120,18 @@ struct payload *payload_create(uint64_t timestamp, const char *target_name);
  */
 void payload_destroy(struct payload *payload);
 
+/*
+ * payload_merge sum the events values of the src payload into the dst payload.
+ * Callchains are concatenated, and the timestamp of the dst payload is kept, but not its interval.
+ */
+int payload_merge(struct payload *dst, struct payload *src);
+
+/*
+ * payload_group_data_merge add the values of the src group to the dst group.
+ * The summaries of the dst group are dropped, because the distributions of different periods cannot be merged.
+ */
+int payload_group_data_merge(struct payload_group_data *dst, struct payload_group_data *src);
+
 /*
  * payload_group_data_create allocate the resources of an events group data container.
  */
@@ -108,5 +162,15 @@ struct payload_cpu_data *payload_cpu_data_create(void);
  */
 void payload_cpu_data_destroy(struct payload_cpu_data **data_ptr);
 
+/*
+ * payload_function_data_create allocate the resources of a function data container.
+ */
+struct payload_function_data *payload_function_data_create(void);
+
+/*
+ * payload_function_data_destroy free the allocated resources of the function data container.
+ */
+void payload_function_data_destroy(struct payload_function_data **data_ptr);
+
 #endif /* PAYLOAD_H */
 
@@ -39,26 +39,45 @@
 #include <unistd.h>
 #include <sys/mman.h>
 
+#include "config_snapshot.h"
+#include "cpuset.h"
 #include "target.h"
-#include "hwinfo.h"
-#include "events.h"
 #include "payload.h"
 #include "perf.h"
 #include "util.h"
 #include "report.h"
+#include "report_queue.h"
+
+/*
+ * PERF_MMAP_DATA_PAGES is the number of data pages of the mmap buffer used to sample the callchains. (must be a power of 2)
+ */
+#define PERF_MMAP_DATA_PAGES 16
+
+/*
+ * PERF_CPUSET_CHECK_INTERVAL is the interval (in milliseconds) between two checks of the effective cpuset of the target.
+ */
+#define PERF_CPUSET_CHECK_INTERVAL 5000
 
 struct perf_config *
-perf_config_create(struct hwinfo *hwinfo, zhashx_t *events_groups, struct target *target, unsigned int callchain_frequency)
+perf_config_create(struct config_snapshot *snapshot, struct target *target, unsigned int callchain_frequency, struct report_queue *queue, struct target_resolver *resolver, unsigned int activity_threshold, unsigned int idle_period, struct fd_budget *budget, struct open_pool *opener, struct burst *burst)
 {
     struct perf_config *config = malloc(sizeof(struct perf_config));
     
     if (!config)
         return NULL;
 
-    config->hwinfo = hwinfo_dup(hwinfo);
-    config->events_groups = zhashx_dup(events_groups);
+    config->snapshot = config_snapshot_acquire(snapshot);
     config->target = target;
     config->callchain_frequency = callchain_frequency;
+    config->queue = queue;
+    config->resolver = resolver;
+    config->activity_threshold = activity_threshold;
+    config->idle_period = idle_period;
+    config->budget = budget;
+    config->opener = opener;
+    config->request_timestamp = zclock_mono();
+    config->handover = NULL;
+    config->burst = burst;
 
     return config;
 }
@@ -69,12 +88,26 @@ perf_config_destroy(struct perf_config *config)
     if (!config)
         return;
 
-    hwinfo_destroy(config->hwinfo);
-    zhashx_destroy(&config->events_groups);
+    config_snapshot_release(&config->snapshot);
     target_destroy(config->target);
+    handover_target_destroy(&config->handover);
     free(config);
 }
 
+/*
+ * get_callchain_frequency returns the sampling frequency of the group leaders, which is raised during a capture window.
+ */
+static unsigned int
+get_callchain_frequency(struct perf_context *ctx)
+{
+    struct burst *burst = ctx->config->burst;
+
+    if (ctx->burst_period && burst && burst->callchain_frequency)
+        return burst->callchain_frequency;
+
+    return ctx->config->callchain_frequency;
+}
+
 static void
 perf_event_fd_destroy(int **fd_ptr)
 {
@@ -87,14 +120,22 @@ perf_event_fd_destroy(int **fd_ptr)
 }
 
 static struct perf_group_cpu_context *
-perf_group_cpu_context_create(void)
+perf_group_cpu_context_create(const char *core_id, size_t core_index)
 {
     struct perf_group_cpu_context *ctx = malloc(sizeof(struct perf_group_cpu_context));
 
     if (!ctx)
         return NULL;
 
+    ctx->core_id = strdup(core_id);
+    if (!ctx->core_id) {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->core_index = core_index;
     ctx->buffer = NULL;
+    ctx->adopted = false;
     ctx->perf_fds = zlistx_new();
     zlistx_set_duplicator(ctx->perf_fds, (zlistx_duplicator_fn *) intptrdup);
     zlistx_set_destructor(ctx->perf_fds, (zlistx_destructor_fn *) perf_event_fd_destroy);
@@ -108,7 +149,11 @@ perf_group_cpu_context_destroy(struct perf_group_cpu_context **ctx)
     if (!*ctx)
         return;
 
+    if ((*ctx)->buffer)
+        munmap((*ctx)->buffer, (PERF_MMAP_DATA_PAGES + 1) * getpagesize());
+
     zlistx_destroy(&(*ctx)->perf_fds);
+    free((*ctx)->core_id);
     free(*ctx);
     *ctx = NULL;
 }
@@ -139,7 +184,7 @@ perf_group_pkg_context_destroy(struct perf_group_pkg_context **ctx)
 }
 
 static struct perf_group_context *
-perf_group_context_create(struct events_group *group)
+perf_group_context_create(const struct config_snapshot_group *group)
 {
     struct perf_group_context *ctx = malloc(sizeof(struct perf_group_context));
 
@@ -147,6 +192,8 @@ perf_group_context_create(struct events_group *group)
         return NULL;
 
     ctx->config = group;
+    ctx->counting_timestamp = 0;
+    ctx->counting_period = 0;
     ctx->pkgs_ctx = zhashx_new();
     zhashx_set_destructor(ctx->pkgs_ctx, (zhashx_destructor_fn *) perf_group_pkg_context_destroy);
 
@@ -165,7 +212,7 @@ perf_group_context_destroy(struct perf_group_context **ctx)
 }
 
 static struct perf_context *
-perf_context_create(struct perf_config *config, zsock_t *pipe, const char *target_name)
+perf_context_create(struct perf_config *config, char *target_name)
 {
     struct perf_context *ctx = malloc(sizeof(struct perf_context));
 
@@ -174,16 +221,37 @@ perf_context_create(struct perf_config *config, zsock_t *pipe, const char *targe
 
     ctx->config = config;
     ctx->target_name = target_name;
-    ctx->terminated = false;
-    ctx->pipe = pipe;
-    ctx->ticker = zsock_new_sub("inproc://ticker", "CLOCK_TICK");
-    ctx->poller = zpoller_new(ctx->pipe, ctx->ticker, NULL);
-    ctx->reporting = zsock_new_push("inproc://reporting");
+    ctx->metadata = NULL;
+    ctx->metadata_final = false;
+    ctx->reporting = report_queue_producer_create(config->queue);
     ctx->cgroup_fd = -1; /* by default, system wide monitoring */
+    ctx->cpus_restricted = false;
+    ctx->last_cpuset_check = 0;
+    ctx->attached = false;
+    ctx->last_cpu_usage = 0;
+    ctx->last_cpu_usage_timestamp = 0;
+    ctx->last_active_timestamp = 0;
+    ctx->fds_acquired = 0;
+    ctx->rotating = false;
+    ctx->waiting = false;
+    ctx->last_tick_timestamp = 0;
+    ctx->last_tick_deadline = (uint64_t) zclock_mono();
+    ctx->burst_period = 0;
+    ctx->burst_end_deadline = 0;
+    ctx->estimate = NULL;
+    ctx->accumulator = accumulator_create();
+    ctx->first_sample_reported = false;
     ctx->groups_ctx = zhashx_new();
     zhashx_set_destructor(ctx->groups_ctx, (zhashx_destructor_fn *) perf_group_context_destroy);
     ctx->dwfl = NULL;
 
+    if (!ctx->accumulator) {
+        report_queue_producer_destroy(ctx->reporting);
+        zhashx_destroy(&ctx->groups_ctx);
+        free(ctx);
+        return NULL;
+    }
+
     return ctx;
 }
 
@@ -193,24 +261,73 @@ perf_context_destroy(struct perf_context *ctx)
     if (!ctx)
         return;
 
-    zpoller_destroy(&ctx->poller);
-    zsock_destroy(&ctx->ticker);
-    zsock_destroy(&ctx->reporting);
+    report_queue_producer_destroy(ctx->reporting);
     close(ctx->cgroup_fd);
+    if (ctx->config->budget) {
+        fd_budget_release(ctx->config->budget, ctx->fds_acquired);
+        if (ctx->waiting)
+            fd_budget_wait(ctx->config->budget, false);
+    }
     zhashx_destroy(&ctx->groups_ctx);
     dwfl_end(ctx->dwfl);
+    payload_destroy(ctx->estimate);
+    accumulator_destroy(ctx->accumulator);
+    free(ctx->target_name);
+    target_metadata_destroy(&ctx->metadata);
     free(ctx);
 }
 
+/*
+ * perf_events_group_adopt_cpu try to reuse the fds of the events group for the cpu handed over by the previous sensor.
+ */
+static int
+perf_events_group_adopt_cpu(struct perf_context *ctx, struct perf_group_cpu_context *cpu_ctx, const struct config_snapshot_group *group, const char *cpu_id)
+{
+    struct handover_event events[HANDOVER_MAX_FDS];
+    int fds[HANDOVER_MAX_FDS];
+    void *buffer = NULL;
+    size_t event_i;
+
+    if (!ctx->config->handover || group->num_events > HANDOVER_MAX_FDS)
+        return -1;
+
+    for (event_i = 0; event_i < group->num_events; event_i++) {
+        events[event_i].type = group->events[event_i]->attr.type;
+        events[event_i].config = group->events[event_i]->attr.config;
+    }
+
+    if (handover_target_take_cpu(ctx->config->handover, group->name, cpu_id, events, group->num_events, fds))
+        return -1;
+
+    for (event_i = 0; event_i < group->num_events; event_i++)
+        zlistx_add_end(cpu_ctx->perf_fds, &fds[event_i]);
+
+    /* the ring buffer of the sampling leader is mapped again, the samples not yet consumed are kept by the kernel */
+    if (ctx->cgroup_fd > -1) {
+        buffer = mmap(NULL, (PERF_MMAP_DATA_PAGES + 1) * getpagesize(), PROT_READ|PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (buffer == MAP_FAILED) {
+            zsys_error("mmap<%s>: failed mapping handed over buffer for group=%s cpu=%s errno=%d", ctx->target_name, group->name, cpu_id, errno);
+            zlistx_purge(cpu_ctx->perf_fds);
+            return -1;
+        }
+
+        cpu_ctx->buffer = buffer;
+    }
+
+    cpu_ctx->adopted = true;
+    return 0;
+}
+
 static int
-perf_events_group_setup_cpu(struct perf_context *ctx, struct perf_group_cpu_context *cpu_ctx, struct events_group *group, unsigned long perf_flags, const char *cpu_id)
+perf_events_group_setup_cpu(struct perf_context *ctx, struct perf_group_cpu_context *cpu_ctx, const struct config_snapshot_group *group, unsigned long perf_flags, const char *cpu_id)
 {
     int group_fd = -1;
     int perf_fd;
+    int open_errno;
     char *cpu_id_endp = NULL;
     long cpu;
-    struct event_config *event = NULL;
-    size_t num_pages = 16;
+    const struct event_config *event = NULL;
+    size_t event_i;
 
     errno = 0;
     cpu = strtol(cpu_id, &cpu_id_endp, 0);
@@ -223,13 +340,17 @@ perf_events_group_setup_cpu(struct perf_context *ctx, struct perf_group_cpu_cont
         return -1;
     }
 
-    for (event = zlistx_first(group->events); event; event = zlistx_next(group->events)) {
+    if (perf_events_group_adopt_cpu(ctx, cpu_ctx, group, cpu_id) == 0)
+        return 0;
+
+    for (event_i = 0; event_i < group->num_events; event_i++) {
+        event = group->events[event_i];
         errno = 0;
 
         if (group_fd == -1 && ctx->cgroup_fd > -1) { /* Set up IP sampling for group leader */
             struct perf_event_attr attr = event->attr;
             attr.sample_type = PERF_SAMPLE_CALLCHAIN;
-            attr.sample_freq = ctx->config->callchain_frequency;
+            attr.sample_freq = get_callchain_frequency(ctx);
             attr.freq = 1;
             attr.mmap = 1;
             attr.cgroup = 1;
@@ -238,12 +359,14 @@ perf_events_group_setup_cpu(struct perf_context *ctx, struct perf_group_cpu_cont
 
             perf_fd = perf_event_open(&attr, ctx->cgroup_fd, (int) cpu, -1, perf_flags);
             if (perf_fd < 1) {
-                zsys_error("perf<%s>: failed opening perf event for group=%s cpu=%d event=%s groupfd=%d errno=%d", ctx->target_name, group->name, (int) cpu, event->name, group_fd, errno);
+                open_errno = errno;
+                zsys_error("perf<%s>: failed opening perf event for group=%s cpu=%d event=%s groupfd=%d errno=%d", ctx->target_name, group->name, (int) cpu, event->name, group_fd, open_errno);
+                errno = open_errno;
                 return -1;
             }
 
             /* Create mmap page for storing IPs */
-            void *buffer = mmap(NULL, (num_pages + 1) * getpagesize(), PROT_READ|PROT_WRITE, MAP_SHARED, perf_fd, 0);
+            void *buffer = mmap(NULL, (PERF_MMAP_DATA_PAGES + 1) * getpagesize(), PROT_READ|PROT_WRITE, MAP_SHARED, perf_fd, 0);
             if (buffer == MAP_FAILED) {
                     zsys_error("mmap<%s>: failed creating mmap buffer for group=%s cpu=%d event=%s errno=%d", ctx->target_name, group->name, (int) cpu, event->name, errno);
                     return -1;
@@ -253,9 +376,12 @@ perf_events_group_setup_cpu(struct perf_context *ctx, struct perf_group_cpu_cont
             cpu_ctx->buffer = buffer;
 
         } else { /* Start other events in group normally */
-            perf_fd = perf_event_open(&event->attr, ctx->cgroup_fd, (int) cpu, group_fd, perf_flags);
+            struct perf_event_attr attr = event->attr; /* the events of the snapshot are shared with the other targets */
+            perf_fd = perf_event_open(&attr, ctx->cgroup_fd, (int) cpu, group_fd, perf_flags);
             if (perf_fd < 1) {
-                zsys_error("perf<%s>: failed opening perf event for group=%s cpu=%d event=%s groupfd=%d errno=%d", ctx->target_name, group->name, (int) cpu, event->name, group_fd,  errno);
+                open_errno = errno;
+                zsys_error("perf<%s>: failed opening perf event for group=%s cpu=%d event=%s groupfd=%d errno=%d", ctx->target_name, group->name, (int) cpu, event->name, group_fd, open_errno);
+                errno = open_errno;
                 return -1;
             }
         }
@@ -353,126 +479,309 @@ pid_t get_pid_from_cgroup(char *cgroup_path)
     return first_pid;
 }
 
+static bool
+perf_is_cpu_allowed(struct perf_context *ctx, const char *cpu_id)
+{
+    char *cpu_id_endp = NULL;
+    long cpu;
+
+    if (!ctx->cpus_restricted)
+        return true;
+
+    errno = 0;
+    cpu = strtol(cpu_id, &cpu_id_endp, 0);
+    if (*cpu_id == '\0' || *cpu_id_endp != '\0' || errno)
+        return true; /* let the setup of the cpu report the invalid id */
+
+    return cpuset_is_set(&ctx->cpus, cpu);
+}
+
+/*
+ * perf_pkg_open_task stores the opening of the counters of a target on the cpus of a package.
+ */
+struct perf_pkg_open_task
+{
+    struct perf_context *ctx;
+    const struct config_snapshot_pkg *pkg;
+    unsigned long perf_flags;
+    const bool *groups_mask; /* groups of the snapshot to open, NULL for all of them */
+    struct perf_group_pkg_context **pkgs_ctx; /* one package context per events group of the snapshot */
+    struct open_pool_job job;
+    bool queued;
+    int status;
+    int open_errno; /* errno of the perf_event_open call that failed, 0 if none */
+};
+
+/*
+ * perf_events_pkg_initialize open the counters of all the events groups on the cpus of a package.
+ * The cpus are processed in order, and all the groups of a cpu are opened before moving to the next one.
+ */
 static int
-perf_events_groups_initialize(struct perf_context *ctx)
+perf_events_pkg_initialize(struct perf_pkg_open_task *task)
 {
-    unsigned long perf_flags = 0;
-    struct events_group *events_group = NULL;
-    const char *events_group_name = NULL;
-    struct perf_group_context *group_ctx = NULL;
-    struct hwinfo_pkg *pkg = NULL;
-    const char *pkg_id = NULL;
-    struct perf_group_pkg_context *pkg_ctx = NULL;
+    struct perf_context *ctx = task->ctx;
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    const struct config_snapshot_group *events_group = NULL;
     const char *cpu_id = NULL;
     struct perf_group_cpu_context *cpu_ctx = NULL;
+    size_t group_i, cpu_i;
+
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        if (task->groups_mask && !task->groups_mask[group_i])
+            continue;
+
+        task->pkgs_ctx[group_i] = perf_group_pkg_context_create();
+        if (!task->pkgs_ctx[group_i]) {
+            zsys_error("perf<%s>: failed to create pkg context for group=%s pkg=%s", ctx->target_name, snapshot->groups[group_i].name, task->pkg->id);
+            return -1;
+        }
+    }
+
+    for (cpu_i = 0; cpu_i < task->pkg->num_cpus; cpu_i++) {
+        cpu_id = task->pkg->cpus_id[cpu_i];
+
+        for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+            events_group = &snapshot->groups[group_i];
+            if (task->groups_mask && !task->groups_mask[group_i])
+                continue;
+
+            /* the per-package events are only opened on the first cpu, the other events only where the target can run */
+            if (events_group->type == MONITOR_ONE_CPU_PER_SOCKET ? cpu_i > 0 : !perf_is_cpu_allowed(ctx, cpu_id))
+                continue;
+
+            /* create cpu context */
+            cpu_ctx = perf_group_cpu_context_create(task->pkg->cores_id[cpu_i], task->pkg->cores_index[cpu_i]);
+            if (!cpu_ctx) {
+                zsys_error("perf<%s>: failed to create cpu context for group=%s pkg=%s cpu=%s", ctx->target_name, events_group->name, task->pkg->id, cpu_id);
+                return -1;
+            }
+
+            /* open events of the group for the cpu */
+            errno = 0;
+            if (perf_events_group_setup_cpu(ctx, cpu_ctx, events_group, task->perf_flags, cpu_id)) {
+                task->open_errno = errno;
+                zsys_error("perf<%s>: failed to setup perf for group=%s pkg=%s cpu=%s", ctx->target_name, events_group->name, task->pkg->id, cpu_id);
+                perf_group_cpu_context_destroy(&cpu_ctx);
+                return -1;
+            }
+
+            /* store cpu context */
+            zhashx_insert(task->pkgs_ctx[group_i]->cpus_ctx, cpu_id, cpu_ctx);
+            cpu_ctx = NULL;
+        }
+    }
+
+    return 0;
+}
+
+static void
+perf_events_pkg_initialize_job(void *arg)
+{
+    struct perf_pkg_open_task *task = arg;
+
+    task->status = perf_events_pkg_initialize(task);
+}
+
+/*
+ * perf_pkg_has_counters returns true if counters of the given groups have to be opened on the cpus of the package.
+ */
+static bool
+perf_pkg_has_counters(struct perf_context *ctx, const struct config_snapshot_pkg *pkg, const bool *groups_mask)
+{
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    size_t group_i, cpu_i;
+
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        if ((!groups_mask || groups_mask[group_i]) && snapshot->groups[group_i].type == MONITOR_ONE_CPU_PER_SOCKET)
+            return pkg->num_cpus > 0;
+    }
+
+    for (cpu_i = 0; cpu_i < pkg->num_cpus; cpu_i++) {
+        if (perf_is_cpu_allowed(ctx, pkg->cpus_id[cpu_i]))
+            return true;
+    }
+
+    return false;
+}
+
+static void
+perf_pkg_open_tasks_destroy(struct perf_pkg_open_task *tasks, size_t num_tasks, size_t num_groups)
+{
+    size_t pkg_i, group_i;
+
+    for (pkg_i = 0; pkg_i < num_tasks; pkg_i++) {
+        if (!tasks[pkg_i].pkgs_ctx)
+            continue;
+
+        for (group_i = 0; group_i < num_groups; group_i++)
+            perf_group_pkg_context_destroy(&tasks[pkg_i].pkgs_ctx[group_i]);
+
+        free(tasks[pkg_i].pkgs_ctx);
+    }
+
+    free(tasks);
+}
+
+/*
+ * perf_events_groups_initialize open the counters of the given groups of the snapshot (all of them if groups_mask is NULL).
+ * On failure, errno is set to the error of the perf_event_open call that failed, or to 0 if the failure has another cause.
+ */
+static int
+perf_events_groups_initialize(struct perf_context *ctx, const bool *groups_mask)
+{
+    unsigned long perf_flags = 0;
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    struct perf_pkg_open_task *tasks = NULL;
+    struct perf_group_context *group_ctx = NULL;
+    size_t group_i, pkg_i;
+    size_t num_spanned = 0;
+    int open_errno = 0;
 
     char *cgroup_path = ctx->config->target->cgroup_path;
     if (cgroup_path) {
         perf_flags |= PERF_FLAG_PID_CGROUP;
         errno = 0;
-        ctx->cgroup_fd = open(cgroup_path, O_RDONLY); 
+        if (ctx->cgroup_fd == -1 && ctx->config->handover && ctx->config->handover->cgroup_fd > -1) {
+            ctx->cgroup_fd = ctx->config->handover->cgroup_fd;
+            ctx->config->handover->cgroup_fd = -1;
+        }
+        if (ctx->cgroup_fd == -1)
+            ctx->cgroup_fd = open(cgroup_path, O_RDONLY);
         if (ctx->cgroup_fd < 1) {
             zsys_error("perf<%s>: cannot open cgroup dir path=%s errno=%d", ctx->target_name, cgroup_path, errno);
             goto error;
         }
     }
 
-    for (events_group = zhashx_first(ctx->config->events_groups); events_group; events_group = zhashx_next(ctx->config->events_groups)) {
-        events_group_name = zhashx_cursor(ctx->config->events_groups);
+    tasks = calloc(snapshot->num_pkgs, sizeof(struct perf_pkg_open_task));
+    if (!tasks && snapshot->num_pkgs) {
+        zsys_error("perf<%s>: failed to allocate the packages open tasks", ctx->target_name);
+        goto error;
+    }
 
-        /* create group context */
-        group_ctx = perf_group_context_create(events_group);
-        if (!group_ctx) {
-            zsys_error("perf<%s>: failed to create context for group=%s", ctx->target_name, events_group_name);
+    for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+        tasks[pkg_i].ctx = ctx;
+        tasks[pkg_i].pkg = &snapshot->pkgs[pkg_i];
+        tasks[pkg_i].perf_flags = perf_flags;
+        tasks[pkg_i].groups_mask = groups_mask;
+        tasks[pkg_i].pkgs_ctx = calloc(snapshot->num_groups, sizeof(struct perf_group_pkg_context *));
+        if (!tasks[pkg_i].pkgs_ctx && snapshot->num_groups) {
+            zsys_error("perf<%s>: failed to allocate the contexts of pkg=%s", ctx->target_name, tasks[pkg_i].pkg->id);
             goto error;
         }
+    }
 
-        for (pkg = zhashx_first(ctx->config->hwinfo->pkgs); pkg; pkg = zhashx_next(ctx->config->hwinfo->pkgs)) {
-            pkg_id = zhashx_cursor(ctx->config->hwinfo->pkgs);
-
-            /* create package context */
-            pkg_ctx = perf_group_pkg_context_create();
-            if (!pkg_ctx) {
-                zsys_error("perf<%s>: failed to create pkg context for group=%s pkg=%s", ctx->target_name, events_group_name, pkg_id);
-                goto error;
-            }
+    /*
+     * The packages spanned by the target are opened in parallel, the first one by the current thread and the others by the opening threads.
+     * A target spanning a single package is opened by the current thread only.
+     */
+    for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+        if (!perf_pkg_has_counters(ctx, tasks[pkg_i].pkg, groups_mask))
+            continue;
+
+        if (num_spanned++ && ctx->config->opener && ctx->config->opener->num_threads) {
+            tasks[pkg_i].job.run = perf_events_pkg_initialize_job;
+            tasks[pkg_i].job.arg = &tasks[pkg_i];
+            open_pool_submit(ctx->config->opener, &tasks[pkg_i].job);
+            tasks[pkg_i].queued = true;
+        }
+    }
 
-            for (cpu_id = zlistx_first(pkg->cpus_id); cpu_id; cpu_id = zlistx_next(pkg->cpus_id)) {
-                /* create cpu context */
-                cpu_ctx = perf_group_cpu_context_create();
-                if (!cpu_ctx) {
-                    zsys_error("perf<%s>: failed to create cpu context for group=%s pkg=%s cpu=%s", ctx->target_name, events_group_name, pkg_id, cpu_id);
-                    goto error;
-                }
+    for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+        if (tasks[pkg_i].queued)
+            open_pool_wait(ctx->config->opener, &tasks[pkg_i].job);
+        else
+            tasks[pkg_i].status = perf_events_pkg_initialize(&tasks[pkg_i]);
+    }
 
-                /* open events of the group for the cpu */
-                if (perf_events_group_setup_cpu(ctx, cpu_ctx, events_group, perf_flags, cpu_id)) {
-                    zsys_error("perf<%s>: failed to setup perf for group=%s pkg=%s cpu=%s", ctx->target_name, events_group_name, pkg_id, cpu_id);
-                    goto error;
-                }
+    for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+        if (tasks[pkg_i].status) {
+            open_errno = tasks[pkg_i].open_errno;
+            goto error;
+        }
+    }
 
-                /* store cpu context */
-                zhashx_insert(pkg_ctx->cpus_ctx, cpu_id, cpu_ctx);
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        if (groups_mask && !groups_mask[group_i])
+            continue;
 
-                if (events_group->type == MONITOR_ONE_CPU_PER_SOCKET)
-                    break;
-            }
+        /* create group context */
+        group_ctx = perf_group_context_create(&snapshot->groups[group_i]);
+        if (!group_ctx) {
+            zsys_error("perf<%s>: failed to create context for group=%s", ctx->target_name, snapshot->groups[group_i].name);
+            goto error;
+        }
 
-            /* store pkg context */
-            zhashx_insert(group_ctx->pkgs_ctx, pkg_id, pkg_ctx);
+        /* store pkg context, unless the target cannot run on any cpu of the package */
+        for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+            if (zhashx_size(tasks[pkg_i].pkgs_ctx[group_i]->cpus_ctx))
+                zhashx_insert(group_ctx->pkgs_ctx, tasks[pkg_i].pkg->id, tasks[pkg_i].pkgs_ctx[group_i]);
+            else
+                perf_group_pkg_context_destroy(&tasks[pkg_i].pkgs_ctx[group_i]);
+            tasks[pkg_i].pkgs_ctx[group_i] = NULL;
         }
 
         /* stores per-cpu events fd for group */
-        zhashx_insert(ctx->groups_ctx, events_group_name, group_ctx);
+        zhashx_insert(ctx->groups_ctx, snapshot->groups[group_i].name, group_ctx);
+        group_ctx = NULL;
     }
 
+    perf_pkg_open_tasks_destroy(tasks, snapshot->num_pkgs, snapshot->num_groups);
     return 0;
 
 error:
     close(ctx->cgroup_fd);
+    ctx->cgroup_fd = -1;
     perf_group_context_destroy(&group_ctx);
-    perf_group_pkg_context_destroy(&pkg_ctx);
-    perf_group_cpu_context_destroy(&cpu_ctx);
+    if (tasks)
+        perf_pkg_open_tasks_destroy(tasks, snapshot->num_pkgs, snapshot->num_groups);
+    errno = open_errno;
     return -1;
 }
 
 static void
-perf_events_groups_enable(struct perf_context *ctx)
+perf_events_group_enable(struct perf_context *ctx, const char *group_name, struct perf_group_context *group_ctx)
 {
-    struct perf_group_context *group_ctx = NULL;
-    const char *group_name = NULL;
     struct perf_group_pkg_context *pkg_ctx = NULL;
     const char *pkg_id = NULL;
     struct perf_group_cpu_context *cpu_ctx = NULL;
     const char *cpu_id = NULL;
     const int *group_leader_fd = NULL;
 
-    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
-        group_name = zhashx_cursor(ctx->groups_ctx);
-
-        for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
-            pkg_id = zhashx_cursor(group_ctx->pkgs_ctx);
+    for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
+        pkg_id = zhashx_cursor(group_ctx->pkgs_ctx);
 
-            for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
-                cpu_id = zhashx_cursor(pkg_ctx->cpus_ctx);
-                group_leader_fd = zlistx_first(cpu_ctx->perf_fds);
-                if (!group_leader_fd) {
-                    zsys_error("perf<%s>: no group leader fd for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
-                    continue;
-                }
+        for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
+            cpu_id = zhashx_cursor(pkg_ctx->cpus_ctx);
+            group_leader_fd = zlistx_first(cpu_ctx->perf_fds);
+            if (!group_leader_fd) {
+                zsys_error("perf<%s>: no group leader fd for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
+                continue;
+            }
 
-                errno = 0;
-                if (ioctl(*group_leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP))
-                    zsys_error("perf<%s>: cannot reset events for group=%s pkg=%s cpu=%s errno=%d", ctx->target_name, group_name, pkg_id, cpu_id, errno);
+            /* the handed over counters keep the values counted since the last read of the previous sensor */
+            errno = 0;
+            if (!cpu_ctx->adopted && ioctl(*group_leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP))
+                zsys_error("perf<%s>: cannot reset events for group=%s pkg=%s cpu=%s errno=%d", ctx->target_name, group_name, pkg_id, cpu_id, errno);
+            cpu_ctx->adopted = false;
 
-                errno = 0;
-                if (ioctl(*group_leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP))
-                    zsys_error("perf<%s>: cannot enable events for group=%s pkg=%s cpu=%s errno=%d", ctx->target_name, group_name, pkg_id, cpu_id, errno);
-            }
+            errno = 0;
+            if (ioctl(*group_leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP))
+                zsys_error("perf<%s>: cannot enable events for group=%s pkg=%s cpu=%s errno=%d", ctx->target_name, group_name, pkg_id, cpu_id, errno);
         }
     }
 }
 
+static void
+perf_events_groups_enable(struct perf_context *ctx)
+{
+    struct perf_group_context *group_ctx = NULL;
+
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
+        perf_events_group_enable(ctx, zhashx_cursor(ctx->groups_ctx), group_ctx);
+    }
+}
+
 static int
 perf_events_group_read_cpu(struct perf_group_cpu_context *cpu_ctx, struct perf_read_format *buffer, size_t buffer_size)
 {
@@ -492,21 +801,6 @@ perf_events_group_read_cpu(struct perf_group_cpu_context *cpu_ctx, struct perf_r
     return 0;
 }
 
-static void
-handle_pipe(struct perf_context *ctx)
-{
-    char *command = zstr_recv(ctx->pipe);
-    
-    if (streq(command, "$TERM")) {
-        ctx->terminated = true;
-        zsys_info("perf<%s>: shutting down actor", ctx->target_name);
-    }
-    else
-        zsys_error("perf<%s>: invalid pipe command: %s", ctx->target_name, command);
-
-    zstr_free(&command);
-}
-
 static inline double
 compute_perf_multiplexing_ratio(struct perf_read_format *report)
 {
@@ -605,184 +899,1336 @@ char *get_callchains(struct perf_event_mmap_page *buffer, Dwfl *dwfl)
     return strfreewrap(callchains);
 }
 
-static int
-populate_payload(struct perf_context *ctx, struct payload *payload)
+/*
+ * get_level_cpu_key returns the key under which the counters of a cpu are reported at the given level.
+ */
+static const char *
+get_level_cpu_key(enum events_group_level level, const char *cpu_id, const char *core_id, char *buffer, size_t size)
 {
-    struct perf_group_context *group_ctx = NULL;
-    const char *group_name = NULL;
-    struct payload_group_data *group_data = NULL;
-    struct perf_group_pkg_context *pkg_ctx = NULL;
-    const char *pkg_id = NULL;
-    struct payload_pkg_data *pkg_data = NULL;
-    struct perf_group_cpu_context *cpu_ctx = NULL;
-    const char *cpu_id = NULL;
-    struct payload_cpu_data *cpu_data = NULL;
-    size_t perf_read_buffer_size;
-    struct perf_read_format *perf_read_buffer = NULL;
-    double perf_multiplexing_ratio;
-    const struct event_config *event = NULL;
-    int event_i;
-
-    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
-        group_name = zhashx_cursor(ctx->groups_ctx);
-        group_data = payload_group_data_create();
-        if (!group_data) {
-            zsys_error("perf<%s>: failed to allocate group data for group=%s", ctx->target_name, group_name);
-            goto error;
-        }
-
-        /* shared perf read buffer */
-        perf_read_buffer_size = offsetof(struct perf_read_format, values) + sizeof(struct perf_counter_value[zlistx_size(group_ctx->config->events)]);
-        perf_read_buffer = malloc(perf_read_buffer_size);
-        if (!perf_read_buffer) {
-            zsys_error("perf<%s>: failed to allocate perf read buffer for group=%s", ctx->target_name, group_name);
-            goto error;
-        }
-
-        for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
-            pkg_id = zhashx_cursor(group_ctx->pkgs_ctx);
-            pkg_data = payload_pkg_data_create();
-            if (!pkg_data) {
-                zsys_error("perf<%s>: failed to allocate pkg data for group=%s pkg=%s", ctx->target_name, group_name, pkg_id);
-                goto error;
-            }
-
-            for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
-                cpu_id = zhashx_cursor(pkg_ctx->cpus_ctx);
-                cpu_data = payload_cpu_data_create();
-                if (!cpu_data) {
-                    zsys_error("perf<%s>: failed to allocate cpu data for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
-                    goto error;
-                }
-
-                /* read counters value for the cpu */
-                if (perf_events_group_read_cpu(cpu_ctx, perf_read_buffer, perf_read_buffer_size)) {
-                    zsys_error("perf<%s>: cannot read perf values for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
-                    goto error;
-                }
+    switch (level) {
+    case EVENTS_GROUP_LEVEL_CORE:
+        snprintf(buffer, size, "core%s", core_id);
+        return buffer;
+    case EVENTS_GROUP_LEVEL_PACKAGE:
+    case EVENTS_GROUP_LEVEL_HOST:
+        return "all";
+    default:
+        return cpu_id;
+    }
+}
 
-                /* warn if PMU multiplexing is happening */
-                perf_multiplexing_ratio = compute_perf_multiplexing_ratio(perf_read_buffer);
-                if (perf_multiplexing_ratio < 1.0) {
-                    zsys_warning("perf<%s>: perf multiplexing for group=%s pkg=%s cpu=%s ratio=%f", ctx->target_name, group_name, pkg_id, cpu_id, perf_multiplexing_ratio);
-                }
+/*
+ * perf_reduction stores the counters of the cpus of an events group summed per core, package or host during a read.
+ * The values of a unit are stored contiguously in the order of the perf read format, so a cpu is added with a single loop.
+ * The units are indexed by the index of their core in the package, computed once in the snapshot, or are a single one above the core level.
+ */
+struct perf_reduction
+{
+    enum events_group_level level;
+    size_t width; /* number of values of a unit: time_enabled, time_running, then the value of each event */
+    size_t num_units;
+    const char **units_id; /* id of each unit, NULL if no cpu has been added to it */
+    uint64_t *values; /* width values per unit */
+    char **callchains; /* callchains sampled on the cpus of each unit, NULL if none */
+};
 
-                /* store events value */
-                zhashx_insert(cpu_data->events, "time_enabled", &perf_read_buffer->time_enabled);
-                zhashx_insert(cpu_data->events, "time_running", &perf_read_buffer->time_running);
-                for (event = zlistx_first(group_ctx->config->events), event_i = 0; event; event = zlistx_next(group_ctx->config->events), event_i++) {
-                    zhashx_insert(cpu_data->events, event->name, &perf_read_buffer->values[event_i].value);
-                }
+/* the values of the events directly follow the times in the perf read buffer */
+_Static_assert(offsetof(struct perf_read_format, values) == offsetof(struct perf_read_format, time_enabled) + 2 * sizeof(uint64_t) && sizeof(struct perf_counter_value) == sizeof(uint64_t), "perf read format values are not contiguous");
 
-                /* store callchain */
-                struct perf_event_mmap_page *buffer = (struct perf_event_mmap_page *)cpu_ctx->buffer;
-                if (buffer) {
-                    zhashx_set_duplicator(cpu_data->events, NULL); // Disable the uint64ptrdup duplicator
-                    char *callchain = get_callchains(cpu_ctx->buffer, ctx->dwfl);
-                    if (callchain)
-                        zhashx_insert(cpu_data->events, "callchain", callchain);
-                }
+static int
+perf_reduction_init(struct perf_reduction *reduction, const struct config_snapshot *snapshot, const struct config_snapshot_group *group)
+{
+    size_t pkg_i;
 
-                zhashx_insert(pkg_data->cpus, cpu_id, cpu_data);
-            }
+    reduction->level = group->level;
+    reduction->width = 2 + group->num_events;
 
-            zhashx_insert(group_data->pkgs, pkg_id, pkg_data);
+    /* a package has one unit per core at the core level, the package and the host have a single one */
+    reduction->num_units = 1;
+    if (group->level == EVENTS_GROUP_LEVEL_CORE) {
+        for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+            if (snapshot->pkgs[pkg_i].num_cores > reduction->num_units)
+                reduction->num_units = snapshot->pkgs[pkg_i].num_cores;
         }
-
-        free(perf_read_buffer);
-        perf_read_buffer = NULL;
-        zhashx_insert(payload->groups, group_name, group_data);
     }
 
-    return 0;
+    reduction->units_id = calloc(reduction->num_units, sizeof(char *));
+    reduction->values = calloc(reduction->num_units * reduction->width, sizeof(uint64_t));
+    reduction->callchains = calloc(reduction->num_units, sizeof(char *));
+    if (!reduction->units_id || !reduction->values || !reduction->callchains)
+        return -1;
 
-error:
-    free(perf_read_buffer);
-    payload_cpu_data_destroy(&cpu_data);
-    payload_pkg_data_destroy(&pkg_data);
-    payload_group_data_destroy(&group_data);
-    return -1;
+    return 0;
 }
 
 static void
-handle_ticker(struct perf_context *ctx)
+perf_reduction_fini(struct perf_reduction *reduction)
 {
-    uint64_t timestamp;
-    struct payload *payload = NULL;
-    
-    /* get tick timestamp */
-    zsock_recv(ctx->ticker, "s8", NULL, &timestamp);
+    size_t unit_i;
 
-    payload = payload_create(timestamp, ctx->target_name);
-    if (!payload) {
-        zsys_error("perf<%s>: failed to allocate payload for timestamp=%lu", ctx->target_name, timestamp);
-        return;
+    if (reduction->callchains) {
+        for (unit_i = 0; unit_i < reduction->num_units; unit_i++)
+            free(reduction->callchains[unit_i]);
     }
 
-    /* If we don't have a PID, try to get one */
-    if (!ctx->dwfl && ctx->config->target->cgroup_path) {
-        pid_t pid = get_pid_from_cgroup(ctx->config->target->cgroup_path);
-        if (pid > -1)
-            ctx->dwfl = init_dwfl(pid);
-    }
+    free(reduction->units_id);
+    free(reduction->values);
+    free(reduction->callchains);
+}
 
-    if (populate_payload(ctx, payload)) {
-        zsys_error("perf<%s>: failed to populate payload for timestamp=%lu", ctx->target_name, timestamp);
-        payload_destroy(payload);
-        return;
-    }
+/*
+ * perf_reduction_sum add the values of a cpu to the values of its unit.
+ */
+static inline void
+perf_reduction_sum(uint64_t *restrict dst, const uint64_t *restrict src, size_t width)
+{
+    size_t i;
 
-    /* send payload to reporting socket */
-    zsock_send(ctx->reporting, "p", payload);
+    for (i = 0; i < width; i++)
+        dst[i] += src[i];
 }
 
-void
-perf_monitoring_actor(zsock_t *pipe, void *args)
-{
-    struct perf_config *config = args;
+/*
+ * perf_reduction_add add the values read on a cpu to the unit at the given index, and takes the ownership of the callchain.
+ */
+static int
+perf_reduction_add(struct perf_reduction *reduction, size_t unit_i, const char *unit_id, const struct perf_read_format *buffer, char *callchain)
+{
+    char *merged = NULL;
+
+    if (unit_i >= reduction->num_units) {
+        free(callchain);
+        return -1;
+    }
+
+    /* time_enabled and time_running are summed with the counters, to keep the multiplexing ratio of the unit */
+    reduction->units_id[unit_i] = unit_id;
+    perf_reduction_sum(&reduction->values[unit_i * reduction->width], &buffer->time_enabled, reduction->width);
+
+    if (callchain) {
+        if (!reduction->callchains[unit_i]) {
+            reduction->callchains[unit_i] = callchain;
+            return 0;
+        }
+
+        merged = realloc(reduction->callchains[unit_i], strlen(reduction->callchains[unit_i]) + strlen(callchain) + 1);
+        if (!merged) {
+            free(callchain);
+            return -1;
+        }
+
+        strcat(merged, callchain);
+        reduction->callchains[unit_i] = merged;
+        free(callchain);
+    }
+
+    return 0;
+}
+
+/*
+ * perf_reduction_flush store the values of the units into the package data, and clear the units for the next package.
+ */
+static int
+perf_reduction_flush(struct perf_reduction *reduction, const struct config_snapshot_group *group, struct payload_pkg_data *pkg_data)
+{
+    char unit_key[32]; /* "core" followed by log10(ULLONG_MAX) digits */
+    struct payload_cpu_data *cpu_data = NULL;
+    uint64_t *values = NULL;
+    size_t unit_i, event_i;
+
+    for (unit_i = 0; unit_i < reduction->num_units; unit_i++) {
+        if (!reduction->units_id[unit_i])
+            continue;
+
+        cpu_data = payload_cpu_data_create();
+        if (!cpu_data)
+            return -1;
+
+        values = &reduction->values[unit_i * reduction->width];
+        zhashx_insert(cpu_data->events, "time_enabled", &values[0]);
+        zhashx_insert(cpu_data->events, "time_running", &values[1]);
+        for (event_i = 0; event_i < group->num_events; event_i++) {
+            zhashx_insert(cpu_data->events, group->events[event_i]->name, &values[2 + event_i]);
+        }
+
+        if (reduction->callchains[unit_i]) {
+            zhashx_set_duplicator(cpu_data->events, NULL); /* the callchain is moved into the events container */
+            zhashx_insert(cpu_data->events, "callchain", reduction->callchains[unit_i]);
+            reduction->callchains[unit_i] = NULL;
+        }
+
+        /* the units of the core level are identified by their core id, the other ones are already named after their key */
+        zhashx_insert(pkg_data->cpus, get_level_cpu_key(reduction->level, reduction->units_id[unit_i], reduction->units_id[unit_i], unit_key, sizeof(unit_key)), cpu_data);
+        reduction->units_id[unit_i] = NULL;
+    }
+
+    memset(reduction->values, 0, reduction->num_units * reduction->width * sizeof(uint64_t));
+    return 0;
+}
+
+/*
+ * read_group read the counters of the group at the given timestamp, returns their values or NULL on error.
+ * The counters of the cpus are summed per core, package or host when the group is not reported at the cpu level.
+ */
+static struct payload_group_data *
+read_group(struct perf_context *ctx, const char *group_name, struct perf_group_context *group_ctx, uint64_t timestamp)
+{
+    const enum events_group_level level = group_ctx->config->level;
+    struct perf_reduction reduction = {0};
+    struct payload_group_data *group_data = NULL;
+    struct perf_group_pkg_context *pkg_ctx = NULL;
+    const char *pkg_id = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct perf_group_cpu_context *cpu_ctx = NULL;
+    const char *cpu_id = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    char *callchain = NULL;
+    size_t perf_read_buffer_size;
+    struct perf_read_format *perf_read_buffer = NULL;
+    double perf_multiplexing_ratio;
+    int reduced;
+    size_t event_i;
+
+    group_data = payload_group_data_create();
+    if (!group_data) {
+        zsys_error("perf<%s>: failed to allocate group data for group=%s", ctx->target_name, group_name);
+        goto error;
+    }
+
+    /* shared perf read buffer */
+    perf_read_buffer_size = offsetof(struct perf_read_format, values) + sizeof(struct perf_counter_value[group_ctx->config->num_events]);
+    perf_read_buffer = malloc(perf_read_buffer_size);
+    if (!perf_read_buffer) {
+        zsys_error("perf<%s>: failed to allocate perf read buffer for group=%s", ctx->target_name, group_name);
+        goto error;
+    }
+
+    if (level != EVENTS_GROUP_LEVEL_CPU && perf_reduction_init(&reduction, ctx->config->snapshot, group_ctx->config)) {
+        zsys_error("perf<%s>: failed to allocate reduction buffers for group=%s", ctx->target_name, group_name);
+        goto error;
+    }
+
+    for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
+        pkg_id = zhashx_cursor(group_ctx->pkgs_ctx);
+
+        /* at the host level, the cpus of all the packages are summed into a single package */
+        if (!pkg_data) {
+            pkg_data = payload_pkg_data_create();
+            if (!pkg_data) {
+                zsys_error("perf<%s>: failed to allocate pkg data for group=%s pkg=%s", ctx->target_name, group_name, pkg_id);
+                goto error;
+            }
+        }
+
+        for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
+            cpu_id = zhashx_cursor(pkg_ctx->cpus_ctx);
+
+            /* read counters value for the cpu */
+            if (perf_events_group_read_cpu(cpu_ctx, perf_read_buffer, perf_read_buffer_size)) {
+                zsys_error("perf<%s>: cannot read perf values for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
+                goto error;
+            }
+
+            /* warn if PMU multiplexing is happening */
+            perf_multiplexing_ratio = compute_perf_multiplexing_ratio(perf_read_buffer);
+            if (perf_multiplexing_ratio < 1.0) {
+                zsys_warning("perf<%s>: perf multiplexing for group=%s pkg=%s cpu=%s ratio=%f", ctx->target_name, group_name, pkg_id, cpu_id, perf_multiplexing_ratio);
+            }
+
+            /* get the sampled callchains */
+            callchain = (cpu_ctx->buffer) ? get_callchains(cpu_ctx->buffer, ctx->dwfl) : NULL;
+
+            if (level != EVENTS_GROUP_LEVEL_CPU) {
+                if (level == EVENTS_GROUP_LEVEL_CORE)
+                    reduced = perf_reduction_add(&reduction, cpu_ctx->core_index, cpu_ctx->core_id, perf_read_buffer, callchain);
+                else
+                    reduced = perf_reduction_add(&reduction, 0, "all", perf_read_buffer, callchain);
+                if (reduced) {
+                    zsys_error("perf<%s>: failed to sum perf values for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
+                    goto error;
+                }
+                continue;
+            }
+
+            cpu_data = payload_cpu_data_create();
+            if (!cpu_data) {
+                zsys_error("perf<%s>: failed to allocate cpu data for group=%s pkg=%s cpu=%s", ctx->target_name, group_name, pkg_id, cpu_id);
+                free(callchain);
+                goto error;
+            }
+
+            /* store events value */
+            zhashx_insert(cpu_data->events, "time_enabled", &perf_read_buffer->time_enabled);
+            zhashx_insert(cpu_data->events, "time_running", &perf_read_buffer->time_running);
+            for (event_i = 0; event_i < group_ctx->config->num_events; event_i++) {
+                zhashx_insert(cpu_data->events, group_ctx->config->events[event_i]->name, &perf_read_buffer->values[event_i].value);
+            }
+
+            /* store callchain */
+            if (callchain) {
+                zhashx_set_duplicator(cpu_data->events, NULL); // Disable the uint64ptrdup duplicator
+                zhashx_insert(cpu_data->events, "callchain", callchain);
+            }
+
+            zhashx_insert(pkg_data->cpus, cpu_id, cpu_data);
+            cpu_data = NULL;
+        }
+
+        if (level == EVENTS_GROUP_LEVEL_HOST)
+            continue;
+
+        if (level != EVENTS_GROUP_LEVEL_CPU && perf_reduction_flush(&reduction, group_ctx->config, pkg_data)) {
+            zsys_error("perf<%s>: failed to store summed perf values for group=%s pkg=%s", ctx->target_name, group_name, pkg_id);
+            goto error;
+        }
+
+        zhashx_insert(group_data->pkgs, pkg_id, pkg_data);
+        pkg_data = NULL;
+    }
+
+    if (level == EVENTS_GROUP_LEVEL_HOST && pkg_data) {
+        if (perf_reduction_flush(&reduction, group_ctx->config, pkg_data)) {
+            zsys_error("perf<%s>: failed to store summed perf values for group=%s", ctx->target_name, group_name);
+            goto error;
+        }
+
+        zhashx_insert(group_data->pkgs, "all", pkg_data);
+        pkg_data = NULL;
+    }
+
+    perf_reduction_fini(&reduction);
+    free(perf_read_buffer);
+
+    /* the counters are reset at each read */
+    group_ctx->counting_period = (group_ctx->counting_timestamp && timestamp > group_ctx->counting_timestamp) ? timestamp - group_ctx->counting_timestamp : 0;
+    group_ctx->counting_timestamp = timestamp;
+    return group_data;
+
+error:
+    perf_reduction_fini(&reduction);
+    free(perf_read_buffer);
+    payload_cpu_data_destroy(&cpu_data);
+    payload_pkg_data_destroy(&pkg_data);
+    payload_group_data_destroy(&group_data);
+    return NULL;
+}
+
+/*
+ * accumulate_group read the counters of the group and add their values to the accumulator of the target.
+ */
+static int
+accumulate_group(struct perf_context *ctx, const char *group_name, struct perf_group_context *group_ctx, uint64_t timestamp)
+{
+    struct payload_group_data *group_data = read_group(ctx, group_name, group_ctx, timestamp);
+    int ret;
+
+    if (!group_data)
+        return -1;
+
+    ret = accumulator_add(ctx->accumulator, group_name, group_data, group_ctx->counting_period);
+    if (ret)
+        zsys_error("perf<%s>: failed to accumulate the values of group=%s", ctx->target_name, group_name);
+
+    payload_group_data_destroy(&group_data);
+    return ret;
+}
+
+/*
+ * populate_payload read the counters of the groups having the given period (0 for all the groups) and store their values into the payload.
+ * The groups read at a faster rate are reported with the values accumulated since their last report, and the summaries of their rates.
+ */
+static int
+populate_payload(struct perf_context *ctx, struct payload *payload, unsigned int period)
+{
+    struct perf_group_context *group_ctx = NULL;
+    const char *group_name = NULL;
+    struct payload_group_data *group_data = NULL;
+
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
+        if (period && group_ctx->config->period != period)
+            continue;
+
+        group_name = zhashx_cursor(ctx->groups_ctx);
+        if (group_ctx->config->read_period || accumulator_has_group(ctx->accumulator, group_name)) {
+            if (accumulate_group(ctx, group_name, group_ctx, payload->timestamp))
+                return -1;
+
+            group_data = accumulator_take(ctx->accumulator, group_name);
+        }
+        else {
+            group_data = read_group(ctx, group_name, group_ctx, payload->timestamp);
+        }
+
+        if (!group_data)
+            return -1;
+
+        zhashx_insert(payload->groups, group_name, group_data);
+    }
+
+    return 0;
+}
+
+/*
+ * accumulate_fast_reads read the counters of the groups whose read period elapsed, but not their period.
+ * The groups whose period elapsed are read when they are reported.
+ */
+static void
+accumulate_fast_reads(struct perf_context *ctx, uint64_t timestamp, uint64_t previous, uint64_t deadline)
+{
+    struct perf_group_context *group_ctx = NULL;
+    const struct config_snapshot_group *group = NULL;
+
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
+        group = group_ctx->config;
+        if (!group->read_period || deadline / group->read_period == previous / group->read_period || deadline / group->period > previous / group->period)
+            continue;
+
+        accumulate_group(ctx, zhashx_cursor(ctx->groups_ctx), group_ctx, timestamp);
+    }
+}
+
+/*
+ * populate_idle_payload store zero values for the groups having the given period (0 for all the groups) into the payload.
+ * The zero values are reported with the keys of the level of the group, as the counters would be.
+ */
+static int
+populate_idle_payload(struct perf_context *ctx, struct payload *payload, unsigned int period)
+{
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    const struct config_snapshot_group *events_group = NULL;
+    struct payload_group_data *group_data = NULL;
+    const struct config_snapshot_pkg *pkg = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    const char *cpu_id = NULL;
+    char cpu_key_buffer[32]; /* "core" followed by log10(ULLONG_MAX) digits */
+    const char *cpu_key = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    size_t group_i, pkg_i, cpu_i, event_i;
+    uint64_t zero = 0;
+
+    /* the idle targets are reported with zero values on the cpus where their counters would be opened */
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        events_group = &snapshot->groups[group_i];
+        if (period && events_group->period != period)
+            continue;
+
+        group_data = payload_group_data_create();
+        if (!group_data)
+            goto error;
+
+        for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+            pkg = &snapshot->pkgs[pkg_i];
+            if (!pkg_data) {
+                pkg_data = payload_pkg_data_create();
+                if (!pkg_data)
+                    goto error;
+            }
+
+            for (cpu_i = 0; cpu_i < pkg->num_cpus; cpu_i++) {
+                cpu_id = pkg->cpus_id[cpu_i];
+                if (events_group->type != MONITOR_ONE_CPU_PER_SOCKET && !perf_is_cpu_allowed(ctx, cpu_id))
+                    continue;
+
+                cpu_key = get_level_cpu_key(events_group->level, cpu_id, pkg->cores_id[cpu_i], cpu_key_buffer, sizeof(cpu_key_buffer));
+                if (!zhashx_lookup(pkg_data->cpus, cpu_key)) {
+                    cpu_data = payload_cpu_data_create();
+                    if (!cpu_data)
+                        goto error;
+
+                    zhashx_insert(cpu_data->events, "time_enabled", &zero);
+                    zhashx_insert(cpu_data->events, "time_running", &zero);
+                    for (event_i = 0; event_i < events_group->num_events; event_i++) {
+                        zhashx_insert(cpu_data->events, events_group->events[event_i]->name, &zero);
+                    }
+
+                    zhashx_insert(pkg_data->cpus, cpu_key, cpu_data);
+                    cpu_data = NULL;
+                }
+
+                if (events_group->type == MONITOR_ONE_CPU_PER_SOCKET)
+                    break;
+            }
+
+            /* at the host level, the cpus of all the packages are stored into a single package */
+            if (events_group->level == EVENTS_GROUP_LEVEL_HOST)
+                continue;
+
+            if (zhashx_size(pkg_data->cpus))
+                zhashx_insert(group_data->pkgs, pkg->id, pkg_data);
+            else
+                payload_pkg_data_destroy(&pkg_data);
+            pkg_data = NULL;
+        }
+
+        if (pkg_data) {
+            if (zhashx_size(pkg_data->cpus))
+                zhashx_insert(group_data->pkgs, "all", pkg_data);
+            else
+                payload_pkg_data_destroy(&pkg_data);
+            pkg_data = NULL;
+        }
+
+        zhashx_insert(payload->groups, events_group->name, group_data);
+        group_data = NULL;
+    }
+
+    return 0;
+
+error:
+    zsys_error("perf<%s>: failed to allocate idle payload", ctx->target_name);
+    payload_cpu_data_destroy(&cpu_data);
+    payload_pkg_data_destroy(&pkg_data);
+    payload_group_data_destroy(&group_data);
+    return -1;
+}
+
+static bool
+is_activity_gated(struct perf_context *ctx)
+{
+    return ctx->config->activity_threshold > 0 && ctx->config->target->cgroup_path;
+}
+
+/*
+ * update_target_activity check the cpu usage of the target since the last call against the activity threshold.
+ */
+static void
+update_target_activity(struct perf_context *ctx, uint64_t timestamp)
+{
+    uint64_t cpu_usage;
+    uint64_t elapsed;
+
+    /* the target is considered active if its cpu usage cannot be read */
+    if (target_read_cpu_usage(ctx->config->target, &cpu_usage)) {
+        ctx->last_active_timestamp = timestamp;
+        return;
+    }
+
+    if (ctx->last_cpu_usage_timestamp && timestamp > ctx->last_cpu_usage_timestamp && cpu_usage >= ctx->last_cpu_usage) {
+        elapsed = (timestamp - ctx->last_cpu_usage_timestamp) * 1000000; /* in nanoseconds */
+        if ((cpu_usage - ctx->last_cpu_usage) * 100 >= (uint64_t) ctx->config->activity_threshold * elapsed)
+            ctx->last_active_timestamp = timestamp;
+    }
+
+    ctx->last_cpu_usage = cpu_usage;
+    ctx->last_cpu_usage_timestamp = timestamp;
+}
+
+/*
+ * compute_fds_demand returns the number of file descriptors needed to open the counters of the target.
+ */
+static long
+compute_fds_demand(struct perf_context *ctx)
+{
+    long demand = (ctx->config->target->cgroup_path) ? 1 : 0;
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    const struct config_snapshot_group *events_group = NULL;
+    const struct config_snapshot_pkg *pkg = NULL;
+    size_t group_i, pkg_i, cpu_i;
+    long num_cpus;
+
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        events_group = &snapshot->groups[group_i];
+        for (pkg_i = 0; pkg_i < snapshot->num_pkgs; pkg_i++) {
+            pkg = &snapshot->pkgs[pkg_i];
+            num_cpus = 0;
+            for (cpu_i = 0; cpu_i < pkg->num_cpus; cpu_i++) {
+                if (events_group->type == MONITOR_ONE_CPU_PER_SOCKET) {
+                    num_cpus = 1;
+                    break;
+                }
+                if (perf_is_cpu_allowed(ctx, pkg->cpus_id[cpu_i]))
+                    num_cpus++;
+            }
+            demand += num_cpus * (long) events_group->num_events;
+        }
+    }
+
+    return demand;
+}
+
+/*
+ * perf_budget_acquire reserve the file descriptors needed by the counters of the target, returns false if the budget is exhausted.
+ */
+static bool
+perf_budget_acquire(struct perf_context *ctx)
+{
+    long demand;
+
+    if (!ctx->config->budget)
+        return true;
+
+    demand = compute_fds_demand(ctx);
+    if (demand > ctx->fds_acquired && !fd_budget_acquire(ctx->config->budget, demand - ctx->fds_acquired))
+        return false;
+
+    if (demand < ctx->fds_acquired)
+        fd_budget_release(ctx->config->budget, ctx->fds_acquired - demand);
+
+    ctx->fds_acquired = demand;
+    return true;
+}
+
+static void
+perf_budget_release(struct perf_context *ctx)
+{
+    if (!ctx->config->budget)
+        return;
+
+    fd_budget_release(ctx->config->budget, ctx->fds_acquired);
+    ctx->fds_acquired = 0;
+}
+
+static void
+perf_budget_set_waiting(struct perf_context *ctx, bool waiting)
+{
+    if (!ctx->config->budget || ctx->waiting == waiting)
+        return;
+
+    fd_budget_wait(ctx->config->budget, waiting);
+    ctx->waiting = waiting;
+}
+
+/*
+ * is_perf_limit_error returns true if perf_event_open failed because a limit of the process or of the kernel has been reached.
+ */
+static bool
+is_perf_limit_error(int open_errno)
+{
+    return open_errno == EMFILE || open_errno == ENFILE || open_errno == ENOSPC;
+}
+
+static int
+perf_monitor_attach(struct perf_context *ctx, uint64_t timestamp)
+{
+    struct perf_group_context *group_ctx = NULL;
+    int64_t open_timestamp;
+    int open_errno;
+
+    /* the targets that cannot get enough file descriptors are rotated through the slots left in the budget */
+    if (!perf_budget_acquire(ctx)) {
+        if (!ctx->rotating)
+            zsys_warning("perf<%s>: file descriptors budget exhausted, counters are rotated with the other targets", ctx->target_name);
+
+        ctx->rotating = true;
+        perf_budget_set_waiting(ctx, true);
+        return -1;
+    }
+
+    perf_budget_set_waiting(ctx, false);
+
+    open_timestamp = zclock_mono();
+    if (perf_events_groups_initialize(ctx, NULL)) {
+        open_errno = errno;
+        zhashx_purge(ctx->groups_ctx);
+        perf_budget_release(ctx);
+
+        /* the budget does not account for the fds of the other processes, nor for the counters limits of the kernel */
+        if (is_perf_limit_error(open_errno)) {
+            if (!ctx->rotating)
+                zsys_warning("perf<%s>: perf events limit reached (errno=%d), counters are rotated with the other targets", ctx->target_name, open_errno);
+
+            ctx->rotating = true;
+            perf_budget_set_waiting(ctx, true);
+            return -1;
+        }
+
+        zsys_error("perf<%s>: cannot initialize perf monitoring", ctx->target_name);
+        return -1;
+    }
+
+    if (!ctx->first_sample_reported)
+        zsys_info("perf<%s>: counters opened in %" PRId64 " ms", ctx->target_name, zclock_mono() - open_timestamp);
+
+    perf_events_groups_enable(ctx);
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx))
+        group_ctx->counting_timestamp = timestamp;
+
+    ctx->attached = true;
+    return 0;
+}
+
+static void
+perf_monitor_detach(struct perf_context *ctx)
+{
+    zhashx_purge(ctx->groups_ctx);
+    accumulator_clear(ctx->accumulator);
+    close(ctx->cgroup_fd);
+    ctx->cgroup_fd = -1;
+    ctx->attached = false;
+    perf_budget_release(ctx);
+}
+
+/*
+ * copy_scaled_group copy the events values of the src group into the dst payload, multiplied by the given factor.
+ * The callchains are not copied, because they cannot be estimated.
+ */
+static int
+copy_scaled_group(struct payload *dst, const char *group_name, struct payload_group_data *src_group, double factor)
+{
+    struct payload_group_data *dst_group = NULL;
+    struct payload_pkg_data *src_pkg = NULL;
+    struct payload_pkg_data *dst_pkg = NULL;
+    struct payload_cpu_data *src_cpu = NULL;
+    struct payload_cpu_data *dst_cpu = NULL;
+    const char *event_name = NULL;
+    uint64_t *src_value = NULL;
+    uint64_t value;
+
+    dst_group = payload_group_data_create();
+    if (!dst_group)
+        return -1;
+
+    /* the previous values of the group are replaced */
+    zhashx_update(dst->groups, group_name, dst_group);
+
+    for (src_pkg = zhashx_first(src_group->pkgs); src_pkg; src_pkg = zhashx_next(src_group->pkgs)) {
+        dst_pkg = payload_pkg_data_create();
+        if (!dst_pkg)
+            return -1;
+
+        zhashx_insert(dst_group->pkgs, zhashx_cursor(src_group->pkgs), dst_pkg);
+
+        for (src_cpu = zhashx_first(src_pkg->cpus); src_cpu; src_cpu = zhashx_next(src_pkg->cpus)) {
+            dst_cpu = payload_cpu_data_create();
+            if (!dst_cpu)
+                return -1;
+
+            zhashx_insert(dst_pkg->cpus, zhashx_cursor(src_pkg->cpus), dst_cpu);
+
+            for (src_value = zhashx_first(src_cpu->events); src_value; src_value = zhashx_next(src_cpu->events)) {
+                event_name = zhashx_cursor(src_cpu->events);
+                if (streq(event_name, "callchain"))
+                    continue;
+
+                value = (uint64_t) ((double) *src_value * factor);
+                zhashx_insert(dst_cpu->events, event_name, &value);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * populate_estimate_payload store the values of the last rotation of the groups having the given period into the payload.
+ */
+static int
+populate_estimate_payload(struct perf_context *ctx, struct payload *payload, unsigned int period)
+{
+    struct payload_group_data *group_data = NULL;
+    const char *group_name = NULL;
+    const struct config_snapshot_group *group = NULL;
+
+    for (group_data = zhashx_first(ctx->estimate->groups); group_data; group_data = zhashx_next(ctx->estimate->groups)) {
+        group_name = zhashx_cursor(ctx->estimate->groups);
+        group = config_snapshot_find_group(ctx->config->snapshot, group_name);
+        if (!group || group->period != period)
+            continue;
+
+        if (copy_scaled_group(payload, group_name, group_data, 1.0))
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * update_rotation_estimate store the values just read by a rotating target, normalized to the period of their group.
+ */
+static void
+update_rotation_estimate(struct perf_context *ctx, struct payload *payload, uint64_t timestamp)
+{
+    struct payload_group_data *group_data = NULL;
+    const char *group_name = NULL;
+    struct perf_group_context *group_ctx = NULL;
+    double factor;
+
+    if (!ctx->estimate) {
+        ctx->estimate = payload_create(timestamp, ctx->target_name);
+        if (!ctx->estimate)
+            return;
+    }
+
+    /* the estimate keeps the values of the groups that have not been read at this tick */
+    ctx->estimate->timestamp = timestamp;
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        group_name = zhashx_cursor(payload->groups);
+        group_ctx = zhashx_lookup(ctx->groups_ctx, group_name);
+
+        /* the counters may have been attached for more than one period, so the values are normalized to a single period */
+        factor = 1.0;
+        if (group_ctx && group_ctx->counting_period > 0)
+            factor = (double) group_ctx->config->period / (double) group_ctx->counting_period;
+
+        if (copy_scaled_group(ctx->estimate, group_name, group_data, factor)) {
+            zsys_error("perf<%s>: failed to store the rotation estimate", ctx->target_name);
+            payload_destroy(ctx->estimate);
+            ctx->estimate = NULL;
+            return;
+        }
+    }
+}
+
+static void
+update_target_metadata(struct perf_context *ctx)
+{
+    struct target *target = ctx->config->target;
+    enum target_resolver_state state;
     char *target_name = NULL;
-    struct perf_context *ctx = NULL;
-    zsock_t *which = NULL;
 
-    zsock_signal(pipe, 0);
+    if (ctx->metadata_final || !ctx->config->resolver || !target->container_id)
+        return;
+
+    /* nothing is copied while the resolver is retrying, an unresolvable target keeps its cgroup path as name */
+    ctx->metadata = target_resolver_lookup(ctx->config->resolver, target->container_id, &state);
+    ctx->metadata_final = (state != TARGET_RESOLVER_PENDING);
+    if (!ctx->metadata || !ctx->metadata->name)
+        return;
+
+    target_name = strdup(ctx->metadata->name);
+    if (!target_name)
+        return;
+
+    zsys_info("perf<%s>: target name resolved as %s", ctx->target_name, target_name);
+    free(ctx->target_name);
+    ctx->target_name = target_name;
+}
+
+static struct payload *
+create_target_payload(struct perf_context *ctx, uint64_t timestamp)
+{
+    struct payload *payload = NULL;
+
+    /* the target is reported under its cgroup path until its metadata are resolved */
+    update_target_metadata(ctx);
+
+    payload = payload_create(timestamp, ctx->target_name);
+    if (!payload) {
+        zsys_error("perf<%s>: failed to allocate payload for timestamp=%lu", ctx->target_name, timestamp);
+        return NULL;
+    }
+
+    if (ctx->metadata && zhashx_size(ctx->metadata->labels))
+        payload->labels = zhashx_dup(ctx->metadata->labels);
+
+    return payload;
+}
+
+/*
+ * add_period add the period to the array if it is not already stored in it.
+ */
+static void
+add_period(unsigned int *periods, size_t *num_periods, unsigned int period)
+{
+    size_t i;
+
+    for (i = 0; i < *num_periods; i++) {
+        if (periods[i] == period)
+            return;
+    }
+
+    periods[(*num_periods)++] = period;
+}
+
+/*
+ * collect_group_periods split the distinct periods of the events groups between the due ones and the pending ones.
+ * A period is due when one of its multiples has been crossed between the previous and the current deadline.
+ */
+static void
+collect_group_periods(const struct config_snapshot *snapshot, uint64_t previous, uint64_t deadline, unsigned int *due, size_t *num_due, unsigned int *pending, size_t *num_pending)
+{
+    unsigned int period;
+    size_t group_i;
+
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        period = snapshot->groups[group_i].period;
+        if (period && deadline / period > previous / period)
+            add_period(due, num_due, period);
+        else if (period)
+            add_period(pending, num_pending, period);
+    }
+}
+
+/*
+ * tag_payload_interval set the period covered by the payload of the groups having the given period.
+ * The first read of a group after a capture window does not cover a full period, so its interval is left unknown.
+ */
+static void
+tag_payload_interval(struct perf_context *ctx, struct payload *payload, unsigned int period)
+{
+    if (ctx->burst_period) {
+        payload->interval = ctx->burst_period;
+        payload->burst = true;
+    }
+    else if (ctx->last_tick_deadline - ctx->burst_end_deadline >= period) {
+        payload->interval = period;
+    }
+}
+
+/*
+ * attach_metric_plans give the groups of the payload a reference on their metrics, which are evaluated when the payload is stored.
+ */
+static void
+attach_metric_plans(struct perf_context *ctx, struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    const struct config_snapshot_group *group = NULL;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        group = config_snapshot_find_group(ctx->config->snapshot, zhashx_cursor(payload->groups));
+        if (group && !group_data->plan)
+            group_data->plan = metric_plan_acquire(group->metrics);
+    }
+}
+
+/*
+ * report_attached_groups read the counters of the groups having the given periods, and send one payload per period to the reporting queue.
+ */
+static int
+report_attached_groups(struct perf_context *ctx, uint64_t timestamp, const unsigned int *periods, size_t num_periods)
+{
+    struct payload *payload = NULL;
+    int ret = 0;
+    size_t i;
+
+    for (i = 0; i < num_periods; i++) {
+        payload = create_target_payload(ctx, timestamp);
+        if (!payload)
+            return -1;
+
+        if (populate_payload(ctx, payload, periods[i])) {
+            zsys_error("perf<%s>: failed to populate payload for timestamp=%lu period=%u", ctx->target_name, timestamp, periods[i]);
+            payload_destroy(payload);
+            ret = -1;
+            continue;
+        }
+
+        if (ctx->rotating)
+            update_rotation_estimate(ctx, payload, timestamp);
+
+        /* the values read outside of a capture window can start one */
+        if (ctx->config->burst && !ctx->burst_period)
+            burst_check_payload(ctx->config->burst, payload);
+
+        /* send payload to reporting queue, the overload policy of the queue applies if it is full */
+        tag_payload_interval(ctx, payload, periods[i]);
+        attach_metric_plans(ctx, payload);
+        report_queue_producer_push(ctx->reporting, payload);
+    }
+
+    return ret;
+}
+
+/*
+ * report_detached_groups send the payloads of the groups having the given periods for a target whose counters are not attached.
+ * A rotated out target is reported with the values of its last rotation, the others with zero values.
+ */
+static void
+report_detached_groups(struct perf_context *ctx, uint64_t timestamp, const unsigned int *periods, size_t num_periods)
+{
+    struct payload *payload = NULL;
+    size_t i;
+
+    for (i = 0; i < num_periods; i++) {
+        payload = create_target_payload(ctx, timestamp);
+        if (!payload)
+            return;
+
+        if ((ctx->estimate && populate_estimate_payload(ctx, payload, periods[i])) || (!zhashx_size(payload->groups) && populate_idle_payload(ctx, payload, periods[i]))) {
+            payload_destroy(payload);
+            continue;
+        }
+
+        tag_payload_interval(ctx, payload, periods[i]);
+        attach_metric_plans(ctx, payload);
+        report_queue_producer_push(ctx->reporting, payload);
+    }
+}
+
+/*
+ * perf_reconcile_cpuset reopen the counters of the target on the cpus of its effective cpuset if it has changed.
+ * The groups whose period did not elapse are read before closing their counters.
+ */
+static void
+perf_reconcile_cpuset(struct perf_context *ctx, uint64_t timestamp, const unsigned int *pending, size_t num_pending)
+{
+    struct cpuset cpus = {0};
+    bool cpus_restricted;
+
+    cpus_restricted = (target_read_effective_cpus(ctx->config->target, &cpus) == 0);
+    if (cpus_restricted == ctx->cpus_restricted && (!cpus_restricted || cpuset_equal(&cpus, &ctx->cpus)))
+        return;
+
+    zsys_info("perf<%s>: effective cpuset changed, reopening counters on %u cpu(s)", ctx->target_name, cpus_restricted ? cpuset_count(&cpus) : 0);
+
+    /* the number of file descriptors needed depends on the cpuset, so they are reserved again */
+    report_attached_groups(ctx, timestamp, pending, num_pending);
+    perf_monitor_detach(ctx);
+    ctx->cpus_restricted = cpus_restricted;
+    ctx->cpus = cpus;
+
+    if (perf_monitor_attach(ctx, timestamp))
+        zsys_error("perf<%s>: cannot reopen the counters for the new cpuset", ctx->target_name);
+}
+
+/*
+ * perf_update_callchain_frequency apply the current sampling frequency to the opened group leaders.
+ */
+static void
+perf_update_callchain_frequency(struct perf_context *ctx)
+{
+    struct perf_group_context *group_ctx = NULL;
+    struct perf_group_pkg_context *pkg_ctx = NULL;
+    struct perf_group_cpu_context *cpu_ctx = NULL;
+    const int *group_leader_fd = NULL;
+    uint64_t frequency = get_callchain_frequency(ctx);
+
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
+        for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
+            for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
+                /* only the group leaders having a mmap buffer are sampling */
+                group_leader_fd = zlistx_first(cpu_ctx->perf_fds);
+                if (!cpu_ctx->buffer || !group_leader_fd)
+                    continue;
+
+                errno = 0;
+                if (ioctl(*group_leader_fd, PERF_EVENT_IOC_PERIOD, &frequency))
+                    zsys_error("perf<%s>: cannot update the sampling frequency for group=%s errno=%d", ctx->target_name, (const char *) zhashx_cursor(ctx->groups_ctx), errno);
+            }
+        }
+    }
+}
+
+void
+perf_monitor_tick(struct perf_context *ctx, uint64_t timestamp, uint64_t deadline, unsigned int burst_period)
+{
+    const struct config_snapshot *snapshot = ctx->config->snapshot;
+    unsigned int *due = NULL;
+    unsigned int *pending = NULL;
+    size_t num_due = 0;
+    size_t num_pending = 0;
+    unsigned int previous_frequency;
+    bool gated = is_activity_gated(ctx);
+
+    due = calloc(2 * snapshot->num_groups + 1, sizeof(unsigned int));
+    if (!due) {
+        zsys_error("perf<%s>: failed to allocate the periods of the groups", ctx->target_name);
+        return;
+    }
+
+    /* the sampling frequency is raised during a capture window, and restored at its end */
+    if (burst_period != ctx->burst_period) {
+        if (!burst_period)
+            ctx->burst_end_deadline = ctx->last_tick_deadline;
+
+        previous_frequency = get_callchain_frequency(ctx);
+        ctx->burst_period = burst_period;
+        if (ctx->attached && get_callchain_frequency(ctx) != previous_frequency)
+            perf_update_callchain_frequency(ctx);
+    }
+
+    /* nothing is done for the target until the period of one of its groups elapsed, every group is due during a capture window */
+    pending = due + snapshot->num_groups;
+    if (burst_period)
+        due[num_due++] = 0;
+    else
+        collect_group_periods(snapshot, ctx->last_tick_deadline, deadline, due, &num_due, pending, &num_pending);
+
+    /* the groups read at a faster rate accumulate their values until their period elapses */
+    if (ctx->attached && !burst_period)
+        accumulate_fast_reads(ctx, timestamp, ctx->last_tick_deadline, deadline);
+
+    ctx->last_tick_deadline = deadline;
+    if (!num_due)
+        goto out;
+
+    if (gated)
+        update_target_activity(ctx, timestamp);
+
+    /* the counters are only attached when the target is active and a slot is available, they count from the next tick */
+    if (!ctx->attached) {
+        if (gated && ctx->last_active_timestamp != timestamp) {
+            perf_budget_set_waiting(ctx, false);
+            payload_destroy(ctx->estimate);
+            ctx->estimate = NULL;
+        }
+        else if (ctx->rotating && ctx->estimate && ctx->estimate->timestamp == ctx->last_tick_timestamp) {
+            /* a target that has just given its slot back lets the other waiting targets take it first */
+            perf_budget_set_waiting(ctx, true);
+        }
+        else if (!perf_monitor_attach(ctx, timestamp)) {
+            if (gated)
+                zsys_info("perf<%s>: target is active, counters attached", ctx->target_name);
+        }
+
+        /* nothing is captured for a target whose counters are not attached, so it is only reported outside of the capture windows */
+        if (!burst_period)
+            report_detached_groups(ctx, timestamp, due, num_due);
+        ctx->last_tick_timestamp = timestamp;
+        goto out;
+    }
+
+    /* If we don't have a PID, try to get one */
+    if (!ctx->dwfl && ctx->config->target->cgroup_path) {
+        pid_t pid = get_pid_from_cgroup(ctx->config->target->cgroup_path);
+        if (pid > -1)
+            ctx->dwfl = init_dwfl(pid);
+    }
+
+    if (report_attached_groups(ctx, timestamp, due, num_due)) {
+        ctx->last_tick_timestamp = timestamp;
+        goto out;
+    }
+
+    if (!ctx->first_sample_reported) {
+        zsys_info("perf<%s>: first sample reported %" PRId64 " ms after the monitoring request", ctx->target_name, zclock_mono() - ctx->config->request_timestamp);
+        ctx->first_sample_reported = true;
+    }
+
+    ctx->last_tick_timestamp = timestamp;
+
+    /* the counters of the groups whose period did not elapse are read before being closed, so no value is lost */
+    if (gated && timestamp - ctx->last_active_timestamp >= ctx->config->idle_period) {
+        zsys_info("perf<%s>: target is idle, counters detached", ctx->target_name);
+        report_attached_groups(ctx, timestamp, pending, num_pending);
+        perf_monitor_detach(ctx);
+        payload_destroy(ctx->estimate);
+        ctx->estimate = NULL;
+        goto out;
+    }
+
+    /* a rotating target keeps its slot until another rotating target is waiting for one */
+    if (ctx->rotating && ctx->config->budget && fd_budget_has_waiters(ctx->config->budget)) {
+        report_attached_groups(ctx, timestamp, pending, num_pending);
+        perf_monitor_detach(ctx);
+        goto out;
+    }
+
+    /* the counters have just been read, so they can be reopened without losing any value */
+    if (timestamp - ctx->last_cpuset_check >= PERF_CPUSET_CHECK_INTERVAL) {
+        ctx->last_cpuset_check = timestamp;
+        perf_reconcile_cpuset(ctx, timestamp, pending, num_pending);
+    }
+
+out:
+    free(due);
+}
+
+void
+perf_monitor_flush(struct perf_context *ctx, uint64_t timestamp)
+{
+    struct payload *payload = NULL;
+
+    /* nothing has been counted since the last tick if the counters are not attached */
+    if (!ctx->attached)
+        return;
+
+    payload = create_target_payload(ctx, timestamp);
+    if (!payload)
+        return;
+
+    if (populate_payload(ctx, payload, 0)) {
+        zsys_error("perf<%s>: failed to populate final payload for timestamp=%lu", ctx->target_name, timestamp);
+        payload_destroy(payload);
+        return;
+    }
+
+    attach_metric_plans(ctx, payload);
+    report_queue_producer_push(ctx->reporting, payload);
+}
+
+int
+perf_monitor_reconfigure(struct perf_context *ctx, struct perf_config *config)
+{
+    struct perf_config *previous = ctx->config;
+    const struct config_snapshot *snapshot = config->snapshot;
+    struct perf_group_context *group_ctx = NULL;
+    const struct config_snapshot_group *group = NULL;
+    zlistx_t *groups_name = NULL;
+    const char *group_name = NULL;
+    bool *groups_mask = NULL;
+    size_t group_i;
+    size_t num_kept = 0;
+    size_t num_opened = 0;
+    int ret = 0;
+
+    groups_mask = calloc(snapshot->num_groups + 1, sizeof(bool));
+    if (!groups_mask) {
+        zsys_error("perf<%s>: failed to allocate the groups mask, configuration not reloaded", ctx->target_name);
+        perf_config_destroy(config);
+        return 0;
+    }
+
+    /* the unchanged groups keep their counters and buffers, and now refer to the events of the new snapshot */
+    groups_name = zhashx_keys(ctx->groups_ctx);
+    for (group_name = zlistx_first(groups_name); group_name; group_name = zlistx_next(groups_name)) {
+        group_ctx = zhashx_lookup(ctx->groups_ctx, group_name);
+        group = config_snapshot_find_group(snapshot, group_name);
+        if (group && config_snapshot_group_equal(group_ctx->config, group)) {
+            /* the values accumulated at the previous level cannot be merged with the new ones */
+            if (group->level != group_ctx->config->level)
+                accumulator_remove(ctx->accumulator, group_name);
+
+            group_ctx->config = group;
+            num_kept++;
+        }
+        else {
+            zhashx_delete(ctx->groups_ctx, group_name);
+            accumulator_remove(ctx->accumulator, group_name);
+        }
+    }
+    zlistx_destroy(&groups_name);
+
+    for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+        groups_mask[group_i] = !zhashx_lookup(ctx->groups_ctx, snapshot->groups[group_i].name);
+        if (groups_mask[group_i])
+            num_opened++;
+    }
+
+    ctx->config = config;
+    payload_destroy(ctx->estimate);
+    ctx->estimate = NULL;
+
+    if (ctx->attached) {
+        if (config->callchain_frequency != previous->callchain_frequency)
+            perf_update_callchain_frequency(ctx);
+
+        if (!perf_budget_acquire(ctx)) {
+            zsys_warning("perf<%s>: file descriptors budget exhausted, counters are rotated with the other targets", ctx->target_name);
+            perf_monitor_detach(ctx);
+            ctx->rotating = true;
+            perf_budget_set_waiting(ctx, true);
+        }
+        else if (num_opened && perf_events_groups_initialize(ctx, groups_mask)) {
+            zsys_error("perf<%s>: cannot open the counters of the reloaded groups", ctx->target_name);
+            ret = -1;
+        }
+        else {
+            /* only the new groups are reset, the values of the kept groups are read at the next tick */
+            for (group_i = 0; group_i < snapshot->num_groups; group_i++) {
+                group_ctx = (groups_mask[group_i]) ? zhashx_lookup(ctx->groups_ctx, snapshot->groups[group_i].name) : NULL;
+                if (group_ctx)
+                    perf_events_group_enable(ctx, snapshot->groups[group_i].name, group_ctx);
+            }
+        }
+    }
+
+    if (ctx->attached && !ret)
+        zsys_info("perf<%s>: configuration reloaded, %zu group(s) kept and %zu group(s) opened", ctx->target_name, num_kept, num_opened);
+    else
+        zsys_info("perf<%s>: configuration reloaded", ctx->target_name);
+    free(groups_mask);
+    perf_config_destroy(previous);
+    return ret;
+}
+
+struct perf_context *
+perf_monitor_create(struct perf_config *config)
+{
+    char *target_name = NULL;
+    struct perf_context *ctx = NULL;
 
     target_name = target_resolve_real_name(config->target);
     if (!target_name) {
         zsys_error("perf: failed to resolve name of target for cgroup '%s'", config->target->cgroup_path);
-        goto cleanup;
+        perf_config_destroy(config);
+        return NULL;
     }
 
-    ctx = perf_context_create(args, pipe, target_name);
+    ctx = perf_context_create(config, target_name);
     if (!ctx) {
         zsys_error("perf<%s>: cannot create perf context", target_name);
-        goto cleanup;
+        free(target_name);
+        perf_config_destroy(config);
+        return NULL;
+    }
+
+    /* only open the counters on the cpus where the target is allowed to run */
+    ctx->cpus_restricted = (target_read_effective_cpus(config->target, &ctx->cpus) == 0);
+    if (ctx->cpus_restricted)
+        zsys_info("perf<%s>: restricted to the %u cpu(s) of its effective cpuset", target_name, cpuset_count(&ctx->cpus));
+
+    /* the counters of the activity gated targets are only attached when they are active, or if they were attached by the previous sensor */
+    if (is_activity_gated(ctx) && !config->handover) {
+        zsys_info("perf<%s>: monitoring started (idle until its cpu usage exceeds %u%%)", target_name, config->activity_threshold);
+        return ctx;
     }
 
-    if (perf_events_groups_initialize(ctx)) {
-        zsys_error("perf<%s>: cannot initialize perf monitoring", target_name);
-        goto cleanup;
+    /* a target rotating through the budget is not an error, its counters are attached at its next tick */
+    if (perf_monitor_attach(ctx, 0) && !ctx->rotating) {
+        perf_monitor_destroy(&ctx);
+        return NULL;
     }
 
-    perf_events_groups_enable(ctx);
+    /* the handed over fds that have not been adopted are closed */
+    if (config->handover) {
+        zsys_info("perf<%s>: counters handed over by the previous sensor", target_name);
+        handover_target_destroy(&config->handover);
+    }
+
+    zsys_info("perf<%s>: monitoring started%s", target_name, ctx->rotating ? " (rotating)" : "");
+    return ctx;
+}
+
+int
+perf_monitor_export(struct perf_context *ctx, const char *target_key, int sock)
+{
+    struct handover_event events[HANDOVER_MAX_FDS];
+    int fds[HANDOVER_MAX_FDS];
+    struct perf_group_context *group_ctx = NULL;
+    struct perf_group_pkg_context *pkg_ctx = NULL;
+    struct perf_group_cpu_context *cpu_ctx = NULL;
+    const int *perf_fd = NULL;
+    size_t event_i;
 
-    zsys_info("perf<%s>: monitoring actor started", target_name);
+    /* the idle and rotating targets have nothing to hand over, the new sensor opens their counters when needed */
+    if (!ctx->attached)
+        return 0;
 
-    while (!ctx->terminated) {
-        which = zpoller_wait(ctx->poller, -1);
+    if (handover_send_target(sock, target_key, ctx->cgroup_fd))
+        return -1;
 
-        if (zpoller_terminated(ctx->poller))
-            break;
+    for (group_ctx = zhashx_first(ctx->groups_ctx); group_ctx; group_ctx = zhashx_next(ctx->groups_ctx)) {
+        if (group_ctx->config->num_events > HANDOVER_MAX_FDS)
+            continue;
+
+        for (event_i = 0; event_i < group_ctx->config->num_events; event_i++) {
+            events[event_i].type = group_ctx->config->events[event_i]->attr.type;
+            events[event_i].config = group_ctx->config->events[event_i]->attr.config;
+        }
+
+        for (pkg_ctx = zhashx_first(group_ctx->pkgs_ctx); pkg_ctx; pkg_ctx = zhashx_next(group_ctx->pkgs_ctx)) {
+            for (cpu_ctx = zhashx_first(pkg_ctx->cpus_ctx); cpu_ctx; cpu_ctx = zhashx_next(pkg_ctx->cpus_ctx)) {
+                if (zlistx_size(cpu_ctx->perf_fds) != group_ctx->config->num_events)
+                    continue;
+
+                event_i = 0;
+                for (perf_fd = zlistx_first(cpu_ctx->perf_fds); perf_fd; perf_fd = zlistx_next(cpu_ctx->perf_fds))
+                    fds[event_i++] = *perf_fd;
 
-        if (which == ctx->pipe)
-            handle_pipe(ctx);
-        else if (which == ctx->ticker)
-            handle_ticker(ctx);
+                if (handover_send_cpu(sock, target_key, group_ctx->config->name, zhashx_cursor(pkg_ctx->cpus_ctx), events, fds, group_ctx->config->num_events))
+                    return -1;
+            }
+        }
     }
 
-cleanup:
-    free(target_name);
+    return 0;
+}
+
+void
+perf_monitor_destroy(struct perf_context **ctx_ptr)
+{
+    struct perf_config *config = NULL;
+
+    if (!*ctx_ptr)
+        return;
+
+    zsys_info("perf<%s>: monitoring stopped", (*ctx_ptr)->target_name);
+
+    config = (*ctx_ptr)->config;
+    perf_context_destroy(*ctx_ptr);
     perf_config_destroy(config);
-    perf_context_destroy(ctx);
+    *ctx_ptr = NULL;
 }
 
 int
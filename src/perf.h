@@ -36,18 +36,35 @@
 #include <elfutils/libdwfl.h>
 #include <elfutils/libdw.h>
 #include <libelf.h>
-#include "hwinfo.h"
-#include "events.h"
+#include "config_snapshot.h"
+#include "accumulator.h"
+#include "burst.h"
+#include "cpuset.h"
+#include "fd_budget.h"
+#include "open_pool.h"
+#include "handover.h"
+#include "payload.h"
+#include "report_queue.h"
+#include "target_metadata.h"
+#include "target_resolver.h"
 
 /*
- * perf_config stores the configuration of a perf actor.
+ * perf_config stores the monitoring configuration of a target.
  */
 struct perf_config
 {
-    struct hwinfo *hwinfo;
-    zhashx_t *events_groups; /* char *group_name -> struct events_group *group_config */
+    struct config_snapshot *snapshot; /* shared with the other targets */
     struct target *target;
     unsigned int callchain_frequency;
+    struct report_queue *queue;
+    struct target_resolver *resolver; /* NULL if the target metadata are not resolved */
+    unsigned int activity_threshold; /* in percent of a cpu, 0 to always attach the counters */
+    unsigned int idle_period; /* in milliseconds */
+    struct fd_budget *budget; /* NULL if the opened file descriptors are not accounted */
+    struct open_pool *opener; /* shared with the other targets, NULL to open the counters of all the packages from the worker */
+    int64_t request_timestamp; /* monotonic timestamp (in milliseconds) of the monitoring request */
+    struct handover_target *handover; /* fds handed over by the previous sensor, NULL if none */
+    struct burst *burst; /* shared with the other targets, NULL if the capture windows are disabled */
 };
 
 /*
@@ -59,6 +76,10 @@ struct perf_group_cpu_context
     
     /* For sampling instruction pointers */
     void *buffer; /* -> struct perf_event_mmap_page */
+
+    bool adopted; /* the fds have been handed over by the previous sensor and are already counting */
+    char *core_id; /* core of the cpu, used to name the counters summed at the core level */
+    size_t core_index; /* index of the core among the distinct cores of the package, used to sum the counters at the core level */
 };
 
 /*
@@ -74,23 +95,40 @@ struct perf_group_pkg_context
  */
 struct perf_group_context
 {
-    struct events_group *config;
+    const struct config_snapshot_group *config;
+    uint64_t counting_timestamp; /* timestamp (in milliseconds) since when the counters are counting, 0 if unknown */
+    uint64_t counting_period; /* duration (in milliseconds) covered by the last read of the counters, 0 if unknown */
     zhashx_t *pkgs_ctx; /* char *pkg_id -> struct perf_group_pkg_context *pkg_ctx */
 };
 
 /*
- * perf_context stores the context of a perf actor.
+ * perf_context stores the monitoring context of a target.
  */
 struct perf_context
 {
     struct perf_config *config;
-    const char *target_name;
-    bool terminated;
-    zsock_t *pipe;
-    zsock_t *ticker;
-    zpoller_t *poller;
-    zsock_t *reporting;
+    char *target_name;
+    struct target_metadata *metadata; /* NULL until resolved */
+    bool metadata_final; /* the resolver resolved the metadata or gave up, they are not looked up anymore */
+    struct report_queue_producer *reporting;
     int cgroup_fd;
+    bool cpus_restricted; /* the counters are only opened on the cpus of the effective cpuset of the target */
+    struct cpuset cpus;
+    uint64_t last_cpuset_check; /* timestamp (in milliseconds) of the last check of the cpuset */
+    bool attached; /* the counters are opened, false while the target is idle */
+    uint64_t last_cpu_usage; /* in nanoseconds */
+    uint64_t last_cpu_usage_timestamp; /* in milliseconds */
+    uint64_t last_active_timestamp; /* in milliseconds */
+    long fds_acquired; /* number of file descriptors reserved in the budget */
+    bool rotating; /* the counters share the slots left in the budget with the other rotating targets */
+    bool waiting; /* the target is registered as waiting for a slot in the budget */
+    uint64_t last_tick_timestamp; /* in milliseconds */
+    uint64_t last_tick_deadline; /* monotonic time (in milliseconds) of the last tick, used to find the groups whose period elapsed */
+    unsigned int burst_period; /* period (in milliseconds) of the running capture window, 0 if none */
+    uint64_t burst_end_deadline; /* monotonic time (in milliseconds) of the last tick of the previous capture window */
+    struct payload *estimate; /* last values read by a rotating target, used while its counters are not attached */
+    struct accumulator *accumulator; /* values of the groups read at a faster rate, since their last report */
+    bool first_sample_reported;
     zhashx_t *groups_ctx; /* char *group_name -> struct perf_group_context *group_ctx */
     Dwfl *dwfl; /* For symbolizing instruction pointers of this cgroup */
 };
@@ -114,8 +152,9 @@ struct perf_read_format {
 
 /*
  * perf_config_create allocate and configure a perf configuration structure.
+ * The configuration takes a reference on the snapshot, and the ownership of the target.
  */
-struct perf_config *perf_config_create(struct hwinfo *hwinfo, zhashx_t *events_groups, struct target *target, unsigned int callchain_frequency);
+struct perf_config *perf_config_create(struct config_snapshot *snapshot, struct target *target, unsigned int callchain_frequency, struct report_queue *queue, struct target_resolver *resolver, unsigned int activity_threshold, unsigned int idle_period, struct fd_budget *budget, struct open_pool *opener, struct burst *burst);
 
 /*
  * perf_config_destroy free the resources allocated for the perf configuration structure.
@@ -123,9 +162,41 @@ struct perf_config *perf_config_create(struct hwinfo *hwinfo, zhashx_t *events_g
 void perf_config_destroy(struct perf_config *config);
 
 /*
- * perf_monitoring_actor handle the monitoring of a cgroup using perf_event. 
+ * perf_monitor_create setup the monitoring of the target using perf_event.
+ * The monitor takes the ownership of the config, which is destroyed if the monitor cannot be created.
+ */
+struct perf_context *perf_monitor_create(struct perf_config *config);
+
+/*
+ * perf_monitor_tick read the counters of the groups whose period elapsed since the previous tick, and send their payloads to the reporting queue.
+ * The deadline is the monotonic time (in milliseconds) of the tick, the groups having the same period are reported in the same payload.
+ * During a capture window (burst period greater than 0), every group is read at each tick and reported in a single burst payload.
+ */
+void perf_monitor_tick(struct perf_context *ctx, uint64_t timestamp, uint64_t deadline, unsigned int burst_period);
+
+/*
+ * perf_monitor_flush read the values counted since the last tick and send them to the reporting queue.
+ * This is used to report the last partial interval of a target before its monitoring is stopped.
+ */
+void perf_monitor_flush(struct perf_context *ctx, uint64_t timestamp);
+
+/*
+ * perf_monitor_reconfigure apply a new config to the monitor, which takes its ownership.
+ * Only the counters of the events groups that have changed are closed and opened again.
+ * Returns -1 if the counters of the changed groups cannot be opened, the monitor then only holds the unchanged groups and has to be destroyed.
+ */
+int perf_monitor_reconfigure(struct perf_context *ctx, struct perf_config *config);
+
+/*
+ * perf_monitor_export send the fds of the attached counters of the target to a new sensor through the handover socket.
+ * The fds stay open in the current process, which must stop reading them once the handover is done.
+ */
+int perf_monitor_export(struct perf_context *ctx, const char *target_key, int sock);
+
+/*
+ * perf_monitor_destroy stop the monitoring of the target and free the allocated resources.
  */
-void perf_monitoring_actor(zsock_t *pipe, void *args);
+void perf_monitor_destroy(struct perf_context **ctx_ptr);
 
 /*
  * perf_try_event_open try to open a global counting event using the perf_event_open syscall.
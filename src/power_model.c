@@ -0,0 +1,381 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "power_model.h"
+#include "util.h"
+
+/*
+ * POWER_MODEL_RIDGE is the regularization (per sample) of the fit of the standardized rates, keeping the correlated events stable.
+ */
+#define POWER_MODEL_RIDGE 1e-3
+
+struct power_model *
+power_model_create(const char *group_name, const char *energy_event, unsigned int window, unsigned int refit_interval)
+{
+    struct power_model *model = calloc(1, sizeof(struct power_model));
+
+    if (!model)
+        return NULL;
+
+    model->group_name = strdup(group_name);
+    model->energy_event = strdup(energy_event);
+    if (!model->group_name || !model->energy_event) {
+        power_model_destroy(model);
+        return NULL;
+    }
+
+    model->window = window;
+    model->refit_interval = refit_interval;
+    return model;
+}
+
+/*
+ * sum_group_event returns the sum of the values of the event over the cpus of the group, and if it has been found.
+ */
+static double
+sum_group_event(struct payload_group_data *group_data, const char *event_name, bool *found)
+{
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    double sum = 0.0;
+
+    for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+        for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+            value = zhashx_lookup(cpu_data->events, event_name);
+            if (value) {
+                sum += (double) *value;
+                *found = true;
+            }
+        }
+    }
+
+    return sum;
+}
+
+/*
+ * setup_features take the events of the group as the inputs of the model, in the order of their names.
+ */
+static int
+setup_features(struct power_model *model, struct payload_group_data *group_data)
+{
+    struct payload_pkg_data *pkg_data = zhashx_first(group_data->pkgs);
+    struct payload_cpu_data *cpu_data = (pkg_data) ? zhashx_first(pkg_data->cpus) : NULL;
+    zlistx_t *events_name = NULL;
+    const char *event_name = NULL;
+
+    if (!cpu_data)
+        return -1;
+
+    events_name = zhashx_keys(cpu_data->events);
+    if (!events_name)
+        return -1;
+
+    zlistx_set_comparator(events_name, (zlistx_comparator_fn *) strcmp);
+    zlistx_sort(events_name);
+
+    model->features = calloc(zlistx_size(events_name), sizeof(char *));
+    if (!model->features)
+        goto error;
+
+    for (event_name = zlistx_first(events_name); event_name; event_name = zlistx_next(events_name)) {
+        if (!payload_is_counter_value(event_name))
+            continue;
+
+        model->features[model->num_features] = strdup(event_name);
+        if (!model->features[model->num_features])
+            goto error;
+
+        model->num_features++;
+    }
+
+    model->rates = calloc(model->window * model->num_features, sizeof(double));
+    model->power = calloc(model->window, sizeof(double));
+    model->coefficients = calloc(model->num_features, sizeof(double));
+    if (!model->num_features || !model->rates || !model->power || !model->coefficients)
+        goto error;
+
+    zlistx_destroy(&events_name);
+    return 0;
+
+error:
+    /* the inputs are taken again from the next report of the system */
+    while (model->features && model->num_features)
+        free(model->features[--model->num_features]);
+
+    free(model->features);
+    free(model->rates);
+    free(model->power);
+    free(model->coefficients);
+    model->features = NULL;
+    model->rates = NULL;
+    model->power = NULL;
+    model->coefficients = NULL;
+    zlistx_destroy(&events_name);
+    return -1;
+}
+
+/*
+ * get_group_rates store the rates (per second) of the features of the model in the group, returns false if one is missing.
+ */
+static bool
+get_group_rates(struct power_model *model, struct payload_group_data *group_data, unsigned int interval, double *rates)
+{
+    bool found;
+    size_t i;
+
+    for (i = 0; i < model->num_features; i++) {
+        found = false;
+        rates[i] = sum_group_event(group_data, model->features[i], &found) * 1000.0 / interval;
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * solve_linear_system solve the n x n system a x = b in place with a gaussian elimination, the solution is stored into b.
+ */
+static int
+solve_linear_system(double *a, double *b, size_t n)
+{
+    size_t i, j, k, pivot;
+    double factor, tmp;
+
+    for (k = 0; k < n; k++) {
+        pivot = k;
+        for (i = k + 1; i < n; i++) {
+            if (fabs(a[i * n + k]) > fabs(a[pivot * n + k]))
+                pivot = i;
+        }
+
+        if (a[pivot * n + k] == 0.0)
+            return -1;
+
+        if (pivot != k) {
+            for (j = 0; j < n; j++) {
+                tmp = a[k * n + j];
+                a[k * n + j] = a[pivot * n + j];
+                a[pivot * n + j] = tmp;
+            }
+            tmp = b[k];
+            b[k] = b[pivot];
+            b[pivot] = tmp;
+        }
+
+        for (i = k + 1; i < n; i++) {
+            factor = a[i * n + k] / a[k * n + k];
+            for (j = k; j < n; j++)
+                a[i * n + j] -= factor * a[k * n + j];
+            b[i] -= factor * b[k];
+        }
+    }
+
+    for (k = n; k-- > 0;) {
+        for (j = k + 1; j < n; j++)
+            b[k] -= a[k * n + j] * b[j];
+        b[k] /= a[k * n + k];
+    }
+
+    return 0;
+}
+
+/*
+ * power_model_fit fit the model on the samples of the window with a ridge regression of the standardized rates.
+ * The previous fit is kept if the system cannot be solved.
+ */
+static void
+power_model_fit(struct power_model *model)
+{
+    const size_t k = model->num_features;
+    const size_t n = model->count;
+    double *mean = calloc(k, sizeof(double));
+    double *scale = calloc(k, sizeof(double));
+    double *a = calloc(k * k, sizeof(double));
+    double *b = calloc(k, sizeof(double));
+    double mean_power = 0.0;
+    double zi, zj;
+    size_t s, i, j;
+
+    if (!mean || !scale || !a || !b)
+        goto out;
+
+    for (s = 0; s < n; s++) {
+        mean_power += model->power[s] / n;
+        for (i = 0; i < k; i++)
+            mean[i] += model->rates[s * k + i] / n;
+    }
+
+    for (s = 0; s < n; s++) {
+        for (i = 0; i < k; i++)
+            scale[i] += (model->rates[s * k + i] - mean[i]) * (model->rates[s * k + i] - mean[i]) / n;
+    }
+
+    for (i = 0; i < k; i++)
+        scale[i] = sqrt(scale[i]);
+
+    /* normal equations of the centered and scaled rates, the constant events do not contribute */
+    for (s = 0; s < n; s++) {
+        for (i = 0; i < k; i++) {
+            zi = (scale[i] > 0.0) ? (model->rates[s * k + i] - mean[i]) / scale[i] : 0.0;
+            b[i] += zi * (model->power[s] - mean_power);
+            for (j = 0; j < k; j++) {
+                zj = (scale[j] > 0.0) ? (model->rates[s * k + j] - mean[j]) / scale[j] : 0.0;
+                a[i * k + j] += zi * zj;
+            }
+        }
+    }
+
+    for (i = 0; i < k; i++)
+        a[i * k + i] += POWER_MODEL_RIDGE * n;
+
+    if (solve_linear_system(a, b, k)) {
+        zsys_warning("power_model: failed to fit the model on %zu samples, the previous fit is kept", n);
+        goto out;
+    }
+
+    model->intercept = mean_power;
+    for (i = 0; i < k; i++) {
+        model->coefficients[i] = (scale[i] > 0.0) ? b[i] / scale[i] : 0.0;
+        model->intercept -= model->coefficients[i] * mean[i];
+    }
+
+    model->fitted = true;
+    model->pending = 0;
+    zsys_debug("power_model: fitted on %zu samples, static power=%f W", n, model->intercept);
+
+out:
+    free(mean);
+    free(scale);
+    free(a);
+    free(b);
+}
+
+void
+power_model_observe(struct power_model *model, const struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_group_data *energy_group = NULL;
+    double energy = 0.0;
+    bool found = false;
+    double *rates = NULL;
+
+    if (!streq(payload->target_name, POWER_MODEL_SYSTEM_TARGET) || payload->heartbeat || !payload->interval)
+        return;
+
+    group_data = zhashx_lookup(payload->groups, model->group_name);
+    if (!group_data)
+        return;
+
+    /* the energy event is read by its own group, reported with the inputs of the model when they have the same period */
+    for (energy_group = zhashx_first(payload->groups); energy_group; energy_group = zhashx_next(payload->groups))
+        energy += sum_group_event(energy_group, model->energy_event, &found);
+
+    if (!found)
+        return;
+
+    if (!model->features && setup_features(model, group_data)) {
+        zsys_error("power_model: failed to setup the inputs of the model from group %s", model->group_name);
+        return;
+    }
+
+    rates = &model->rates[model->next * model->num_features];
+    if (!get_group_rates(model, group_data, payload->interval, rates))
+        return;
+
+    model->power[model->next] = energy * POWER_MODEL_RAPL_UNIT * 1000.0 / payload->interval;
+    model->next = (model->next + 1) % model->window;
+    if (model->count < model->window)
+        model->count++;
+
+    /* the model needs more samples than inputs to be fitted */
+    model->pending++;
+    if (model->count > model->num_features + 1 && (!model->fitted || model->pending >= model->refit_interval))
+        power_model_fit(model);
+}
+
+void
+power_model_estimate(struct power_model *model, struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    double *rates = NULL;
+    double power = 0.0;
+    size_t i;
+
+    if (!model->fitted || streq(payload->target_name, POWER_MODEL_SYSTEM_TARGET) || payload->heartbeat || !payload->interval)
+        return;
+
+    group_data = zhashx_lookup(payload->groups, model->group_name);
+    if (!group_data)
+        return;
+
+    rates = malloc(model->num_features * sizeof(double));
+    if (!rates)
+        return;
+
+    if (get_group_rates(model, group_data, payload->interval, rates)) {
+        for (i = 0; i < model->num_features; i++)
+            power += model->coefficients[i] * rates[i];
+
+        /* a target cannot give back power to the packages */
+        payload->power = (power > 0.0) ? power : 0.0;
+    }
+
+    free(rates);
+}
+
+void
+power_model_destroy(struct power_model *model)
+{
+    size_t i;
+
+    if (!model)
+        return;
+
+    if (model->features) {
+        for (i = 0; i < model->num_features; i++)
+            free(model->features[i]);
+    }
+
+    free(model->features);
+    free(model->rates);
+    free(model->power);
+    free(model->coefficients);
+    free(model->group_name);
+    free(model->energy_event);
+    free(model);
+}
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef POWER_MODEL_H
+#define POWER_MODEL_H
+
+#include <czmq.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "payload.h"
+
+/*
+ * POWER_MODEL_RAPL_UNIT is the energy (in joules) of a count of the RAPL events exposed by perf. (2^-32 J)
+ */
+#define POWER_MODEL_RAPL_UNIT 2.3283064365386962890625e-10
+
+/*
+ * POWER_MODEL_SYSTEM_TARGET is the name of the target whose reports are used to fit the model.
+ */
+#define POWER_MODEL_SYSTEM_TARGET "all"
+
+/*
+ * power_model stores the online regression of the power of the packages against the rates of the events of a group.
+ * The model is fitted on the reports of the system over a sliding window, and applied to the reports of the other targets.
+ */
+struct power_model
+{
+    char *group_name; /* events group whose events are the inputs of the model */
+    char *energy_event; /* RAPL event measuring the energy of the packages */
+    size_t window; /* maximum number of samples used to fit the model */
+    unsigned int refit_interval; /* number of new samples between two fits */
+    size_t num_features;
+    char **features; /* events of the group, taken from the first report of the system */
+    double *rates; /* window rows of num_features rates (per second) */
+    double *power; /* power (in watts) of each sample */
+    size_t count;
+    size_t next; /* index of the oldest sample, replaced by the next one when the window is full */
+    unsigned int pending; /* samples added since the last fit */
+    bool fitted;
+    double *coefficients; /* power (in watts) of an event per second, for each feature */
+    double intercept; /* static power (in watts) of the packages, not attributed to the targets */
+};
+
+/*
+ * power_model_create allocate the resources of an empty power model.
+ */
+struct power_model *power_model_create(const char *group_name, const char *energy_event, unsigned int window, unsigned int refit_interval);
+
+/*
+ * power_model_observe add the report of the system to the samples of the model, and fit it again when needed.
+ * The reports of the other targets, and the reports whose values do not cover exactly one period are ignored.
+ */
+void power_model_observe(struct power_model *model, const struct payload *payload);
+
+/*
+ * power_model_estimate store the estimated power of the target of the report into the payload, once the model is fitted.
+ * Only the dynamic power is attributed to the targets, the static power of the packages stays with the system.
+ */
+void power_model_estimate(struct power_model *model, struct payload *payload);
+
+/*
+ * power_model_destroy free the resources of the power model.
+ */
+void power_model_destroy(struct power_model *model);
+
+#endif /* POWER_MODEL_H */
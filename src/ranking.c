@@ -0,0 +1,429 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ranking.h"
+#include "power_model.h"
+#include "util.h"
+
+const char *ranking_tails_name[] = {
+    [RANKING_TAIL_UNKNOWN] = "unknown",
+    [RANKING_TAIL_SAMPLE] = "sample",
+    [RANKING_TAIL_AGGREGATE] = "aggregate",
+};
+
+enum ranking_tail
+ranking_tail_get_type(const char *tail_name)
+{
+    if (strcasecmp(tail_name, ranking_tails_name[RANKING_TAIL_SAMPLE]) == 0)
+        return RANKING_TAIL_SAMPLE;
+
+    if (strcasecmp(tail_name, ranking_tails_name[RANKING_TAIL_AGGREGATE]) == 0)
+        return RANKING_TAIL_AGGREGATE;
+
+    return RANKING_TAIL_UNKNOWN;
+}
+
+static void
+ranking_tail_target_destroy(struct ranking_tail_target **target_ptr)
+{
+    if (!*target_ptr)
+        return;
+
+    payload_destroy((*target_ptr)->pending);
+    free(*target_ptr);
+    *target_ptr = NULL;
+}
+
+struct ranking *
+ranking_create(unsigned int top_k, const char *rank_key, enum ranking_tail tail, unsigned int tail_interval, unsigned int rank_period)
+{
+    struct ranking *ranking = calloc(1, sizeof(struct ranking));
+
+    if (!ranking)
+        return NULL;
+
+    ranking->top_k = top_k;
+    ranking->tail = tail;
+    ranking->tail_interval = tail_interval;
+    ranking->rank_period = rank_period;
+    ranking->next_rank = (uint64_t) zclock_mono() + rank_period;
+    ranking->capacity = (size_t) top_k * RANKING_CAPACITY_FACTOR;
+    ranking->rank_key = strdup(rank_key);
+    ranking->heap = calloc(ranking->capacity, sizeof(struct ranking_counter *));
+    ranking->counters = zhashx_new();
+    ranking->tail_targets = zhashx_new();
+    ranking->others = zhashx_new();
+    if (!ranking->rank_key || !ranking->heap || !ranking->counters || !ranking->tail_targets || !ranking->others) {
+        ranking_destroy(ranking);
+        return NULL;
+    }
+
+    /* the counters are owned by the heap, and the aggregated payloads are extracted when flushed */
+    zhashx_set_destructor(ranking->tail_targets, (zhashx_destructor_fn *) ranking_tail_target_destroy);
+    return ranking;
+}
+
+static void
+heap_swap(struct ranking *ranking, size_t a, size_t b)
+{
+    struct ranking_counter *counter = ranking->heap[a];
+
+    ranking->heap[a] = ranking->heap[b];
+    ranking->heap[b] = counter;
+    ranking->heap[a]->index = a;
+    ranking->heap[b]->index = b;
+}
+
+static void
+heap_sift_up(struct ranking *ranking, size_t index)
+{
+    size_t parent;
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (ranking->heap[parent]->count <= ranking->heap[index]->count)
+            break;
+
+        heap_swap(ranking, parent, index);
+        index = parent;
+    }
+}
+
+static void
+heap_sift_down(struct ranking *ranking, size_t index)
+{
+    size_t child;
+
+    while ((child = 2 * index + 1) < ranking->size) {
+        if (child + 1 < ranking->size && ranking->heap[child + 1]->count < ranking->heap[child]->count)
+            child++;
+
+        if (ranking->heap[index]->count <= ranking->heap[child]->count)
+            break;
+
+        heap_swap(ranking, index, child);
+        index = child;
+    }
+}
+
+/*
+ * get_payload_weight returns the weight of the payload, which is the value of the rank event summed over the groups, packages
+ * and cpus, or the energy (in joules) estimated by the power model.
+ */
+static double
+get_payload_weight(struct ranking *ranking, struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    double weight = 0.0;
+
+    if (streq(ranking->rank_key, RANKING_POWER_KEY))
+        return (payload->power > 0.0) ? payload->power * payload->interval / 1000.0 : 0.0;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                value = zhashx_lookup(cpu_data->events, ranking->rank_key);
+                if (value)
+                    weight += (double) *value;
+            }
+        }
+    }
+
+    return weight;
+}
+
+/*
+ * update_counter add the weight to the counter of the target, the counter of the lightest target is taken over if the summary is full.
+ * The update costs O(log(capacity)) per report, so the ranking costs O(targets) per tick.
+ */
+static struct ranking_counter *
+update_counter(struct ranking *ranking, const char *target_name, double weight)
+{
+    struct ranking_counter *counter = zhashx_lookup(ranking->counters, target_name);
+    char *name = NULL;
+
+    if (counter) {
+        counter->count += weight;
+        heap_sift_down(ranking, counter->index);
+        return counter;
+    }
+
+    if (ranking->size < ranking->capacity) {
+        counter = calloc(1, sizeof(struct ranking_counter));
+        if (!counter)
+            return NULL;
+
+        counter->target_name = strdup(target_name);
+        if (!counter->target_name) {
+            free(counter);
+            return NULL;
+        }
+
+        counter->count = weight;
+        counter->index = ranking->size;
+        ranking->heap[ranking->size++] = counter;
+        heap_sift_up(ranking, counter->index);
+        zhashx_insert(ranking->counters, target_name, counter);
+        return counter;
+    }
+
+    /* the evicted target may have been lighter than its count, the new target inherits it as its overestimation */
+    name = strdup(target_name);
+    if (!name)
+        return NULL;
+
+    counter = ranking->heap[0];
+    zhashx_delete(ranking->counters, counter->target_name);
+    free(counter->target_name);
+    counter->target_name = name;
+    counter->error = counter->count;
+    counter->count += weight;
+    counter->top = false;
+    heap_sift_down(ranking, 0);
+    zhashx_insert(ranking->counters, target_name, counter);
+    return counter;
+}
+
+/*
+ * sample_tail_payload returns the payload if it is the tail_interval-th report of the target, otherwise it is held back.
+ */
+static struct payload *
+sample_tail_payload(struct ranking *ranking, struct payload *payload)
+{
+    struct ranking_tail_target *target = zhashx_lookup(ranking->tail_targets, payload->target_name);
+
+    if (!target) {
+        target = calloc(1, sizeof(struct ranking_tail_target));
+        if (!target)
+            return payload;
+
+        zhashx_insert(ranking->tail_targets, payload->target_name, target);
+    }
+
+    /* the skipped values are folded into the next report, so the integrals of the values are kept */
+    if (target->pending) {
+        if (payload_merge(payload, target->pending)) {
+            zsys_error("ranking: failed to fold the skipped reports of target=%s into timestamp=%" PRIu64 ", it is stored", payload->target_name, payload->timestamp);
+            return payload;
+        }
+
+        payload_destroy(target->pending);
+        target->pending = NULL;
+    }
+
+    if (++target->count < ranking->tail_interval) {
+        target->pending = payload;
+        return NULL;
+    }
+
+    target->count = 0;
+    return payload;
+}
+
+/*
+ * aggregate_tail_payload fold the payload into the report of the others target of its period.
+ * Returns the previous report of the others target when the payload belongs to a newer tick, NULL otherwise.
+ */
+static struct payload *
+aggregate_tail_payload(struct ranking *ranking, struct payload *payload)
+{
+    char interval[16] = {0};
+    struct payload *others = NULL;
+    unsigned int others_interval;
+    double others_power;
+
+    snprintf(interval, sizeof(interval), "%u", payload->interval);
+    others = zhashx_lookup(ranking->others, interval);
+
+    if (others && others->timestamp == payload->timestamp) {
+        others_interval = others->interval;
+        others_power = (others->power >= 0.0 && payload->power >= 0.0) ? others->power + payload->power : -1.0;
+        if (payload_merge(others, payload)) {
+            zsys_error("ranking: failed to aggregate the report of target=%s timestamp=%" PRIu64 ", it is stored", payload->target_name, payload->timestamp);
+            return payload;
+        }
+
+        /* the others target has no labels, the ones of the merged target are not kept */
+        zhashx_destroy(&others->labels);
+
+        /* the aggregated targets have been read over the same period */
+        others->interval = others_interval;
+        others->power = others_power;
+        payload_destroy(payload);
+        return NULL;
+    }
+
+    free(payload->target_name);
+    payload->target_name = strdup(RANKING_OTHERS_TARGET);
+    zhashx_destroy(&payload->labels);
+    if (!payload->target_name) {
+        payload_destroy(payload);
+        return others;
+    }
+
+    /* the previous report of the others target is complete, the values of a tick are pushed before the ones of the next */
+    zhashx_delete(ranking->others, interval);
+    zhashx_insert(ranking->others, interval, payload);
+    return others;
+}
+
+struct payload *
+ranking_filter(struct ranking *ranking, struct payload *payload)
+{
+    struct ranking_counter *counter = NULL;
+
+    if (payload->heartbeat || streq(payload->target_name, POWER_MODEL_SYSTEM_TARGET))
+        return payload;
+
+    counter = update_counter(ranking, payload->target_name, get_payload_weight(ranking, payload));
+
+    /* every tracked target is reported at full rate until there are more than K of them */
+    if (!counter || counter->top || ranking->size <= ranking->top_k)
+        return payload;
+
+    if (ranking->tail == RANKING_TAIL_AGGREGATE)
+        return aggregate_tail_payload(ranking, payload);
+
+    return sample_tail_payload(ranking, payload);
+}
+
+int
+ranking_get_timeout(struct ranking *ranking)
+{
+    int64_t now = zclock_mono();
+
+    return ((uint64_t) now >= ranking->next_rank) ? 0 : (int) (ranking->next_rank - (uint64_t) now);
+}
+
+static int
+compare_counters(const void *a, const void *b)
+{
+    const struct ranking_counter *counter_a = *(struct ranking_counter *const *) a;
+    const struct ranking_counter *counter_b = *(struct ranking_counter *const *) b;
+
+    return (counter_a->count < counter_b->count) - (counter_a->count > counter_b->count);
+}
+
+/*
+ * rank_counters mark the K heaviest targets of the summary.
+ */
+static void
+rank_counters(struct ranking *ranking)
+{
+    struct ranking_counter **counters = NULL;
+    size_t i;
+
+    counters = malloc(ranking->size * sizeof(struct ranking_counter *));
+    if (!counters) {
+        zsys_error("ranking: failed to rank the targets, the previous top targets are kept");
+        return;
+    }
+
+    memcpy(counters, ranking->heap, ranking->size * sizeof(struct ranking_counter *));
+    qsort(counters, ranking->size, sizeof(struct ranking_counter *), compare_counters);
+    for (i = 0; i < ranking->size; i++)
+        counters[i]->top = (i < ranking->top_k);
+
+    free(counters);
+}
+
+void
+ranking_update(struct ranking *ranking, zlistx_t *payloads)
+{
+    uint64_t now = (uint64_t) zclock_mono();
+    struct ranking_tail_target *target = NULL;
+    struct payload *others = NULL;
+    size_t i;
+
+    if (now < ranking->next_rank)
+        return;
+
+    ranking->next_rank = now + ranking->rank_period;
+
+    if (ranking->size > 0)
+        rank_counters(ranking);
+
+    /* halving every count keeps the order of the heap */
+    for (i = 0; i < ranking->size; i++) {
+        ranking->heap[i]->count /= 2.0;
+        ranking->heap[i]->error /= 2.0;
+    }
+
+    /* the long tail is stored at least once per rank period */
+    for (target = zhashx_first(ranking->tail_targets); target; target = zhashx_next(ranking->tail_targets)) {
+        if (target->pending) {
+            zlistx_add_end(payloads, target->pending);
+            target->pending = NULL;
+        }
+    }
+    zhashx_purge(ranking->tail_targets);
+
+    for (others = zhashx_first(ranking->others); others; others = zhashx_next(ranking->others))
+        zlistx_add_end(payloads, others);
+    zhashx_purge(ranking->others);
+}
+
+void
+ranking_destroy(struct ranking *ranking)
+{
+    struct payload *others = NULL;
+    size_t i;
+
+    if (!ranking)
+        return;
+
+    for (i = 0; i < ranking->size; i++) {
+        free(ranking->heap[i]->target_name);
+        free(ranking->heap[i]);
+    }
+    free(ranking->heap);
+
+    if (ranking->others) {
+        for (others = zhashx_first(ranking->others); others; others = zhashx_next(ranking->others))
+            payload_destroy(others);
+    }
+
+    zhashx_destroy(&ranking->others);
+    zhashx_destroy(&ranking->counters);
+    zhashx_destroy(&ranking->tail_targets);
+    free(ranking->rank_key);
+    free(ranking);
+}
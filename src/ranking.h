@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <czmq.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/*
+ * RANKING_POWER_KEY is the rank key selecting the estimated power of the targets instead of an event.
+ */
+#define RANKING_POWER_KEY "power"
+
+/*
+ * RANKING_OTHERS_TARGET is the name of the target aggregating the reports of the long tail.
+ */
+#define RANKING_OTHERS_TARGET "others"
+
+/*
+ * RANKING_CAPACITY_FACTOR is the number of counters of the heavy-hitters summary per reported top target.
+ */
+#define RANKING_CAPACITY_FACTOR 4
+
+/*
+ * ranking_tail stores the policy applied to the reports of the targets outside of the top K.
+ */
+enum ranking_tail
+{
+    RANKING_TAIL_UNKNOWN,
+    RANKING_TAIL_SAMPLE,
+    RANKING_TAIL_AGGREGATE
+};
+
+/*
+ * ranking_tails_name stores the name (as string) of the supported tail policies.
+ */
+extern const char *ranking_tails_name[];
+
+/*
+ * ranking_counter stores the estimated weight of a target in the heavy-hitters summary. (Space-Saving)
+ */
+struct ranking_counter
+{
+    char *target_name;
+    double count; /* upper bound of the decayed weight of the target */
+    double error; /* overestimation of the count, inherited from the evicted target */
+    size_t index; /* position in the heap */
+    bool top; /* the target is in the top K of the last rank period */
+};
+
+/*
+ * ranking_tail_target stores the reports of a target of the long tail not yet stored.
+ */
+struct ranking_tail_target
+{
+    struct payload *pending; /* values of the skipped reports, folded into the next stored report of the target */
+    unsigned int count; /* number of skipped reports */
+};
+
+/*
+ * ranking stores the state of the heavy-hitters ranking stage of the reporting actor.
+ */
+struct ranking
+{
+    unsigned int top_k; /* number of targets reported at full rate */
+    char *rank_key; /* event summed over the groups, or the estimated power, weighting the targets */
+    enum ranking_tail tail;
+    unsigned int tail_interval; /* a report of the long tail is stored every tail_interval reports of the target */
+    unsigned int rank_period; /* in milliseconds */
+    uint64_t next_rank; /* monotonic timestamp (in milliseconds) */
+    size_t capacity; /* number of counters of the summary */
+    size_t size;
+    struct ranking_counter **heap; /* min-heap of the counters, by count */
+    zhashx_t *counters; /* char *target_name -> struct ranking_counter *counter (reference to the heap) */
+    zhashx_t *tail_targets; /* char *target_name -> struct ranking_tail_target *target */
+    zhashx_t *others; /* char *interval -> struct payload *others, aggregated reports of the long tail per period */
+};
+
+/*
+ * ranking_tail_get_type returns the tail policy corresponding to the given name.
+ */
+enum ranking_tail ranking_tail_get_type(const char *tail_name);
+
+/*
+ * ranking_create allocate the resources of the ranking stage.
+ */
+struct ranking *ranking_create(unsigned int top_k, const char *rank_key, enum ranking_tail tail, unsigned int tail_interval, unsigned int rank_period);
+
+/*
+ * ranking_filter returns the payload to store, or NULL if it has been held back, and takes the ownership of the given payload.
+ * The reports of the system, the heartbeats and the reports of the top K targets are returned as is.
+ * The reports of the long tail are sampled, or aggregated into the reports of the others target, according to the tail policy.
+ */
+struct payload *ranking_filter(struct ranking *ranking, struct payload *payload);
+
+/*
+ * ranking_get_timeout returns the time (in milliseconds) until the next rank period.
+ */
+int ranking_get_timeout(struct ranking *ranking);
+
+/*
+ * ranking_update rank the targets and add to the list the held back reports of the long tail, if the rank period elapsed.
+ * The weights of the targets are halved at each rank period, so the ranking follows the recent activity.
+ */
+void ranking_update(struct ranking *ranking, zlistx_t *payloads);
+
+/*
+ * ranking_destroy free the resources of the ranking stage, the held back reports are lost.
+ */
+void ranking_destroy(struct ranking *ranking);
+
+#endif /* RANKING_H */
@@ -33,6 +33,7 @@
 #include <stdint.h>
 
 #include "report.h"
+#include "report_queue.h"
 #include "util.h"
 #include "hwinfo.h"
 #include "events.h"
@@ -41,7 +42,7 @@
 #include "storage.h"
 
 struct report_config *
-report_config_create(struct storage_module *storage_module)
+report_config_create(struct storage_module *storage_module, struct report_queue *queue, struct suppression *suppression, enum metric_output output, struct power_model *power_model, struct ranking *ranking, bool attribution)
 {
     struct report_config *config = malloc(sizeof(struct report_config));
 
@@ -49,6 +50,12 @@ report_config_create(struct storage_module *storage_module)
         return NULL;
 
     config->storage = storage_module;
+    config->queue = queue;
+    config->suppression = suppression;
+    config->output = output;
+    config->power_model = power_model;
+    config->ranking = ranking;
+    config->attribution = attribution;
 
     return config;
 }
@@ -72,8 +79,7 @@ report_context_create(struct report_config *config, zsock_t *pipe)
 
     ctx->terminated = false;
     ctx->pipe = pipe;
-    ctx->reporting = zsock_new_pull("inproc://reporting");
-    ctx->poller = zpoller_new(ctx->pipe, ctx->reporting, NULL);
+    ctx->queue = config->queue;
     ctx->config = config;
     
     return ctx;
@@ -85,25 +91,27 @@ report_context_destroy(struct report_context *ctx)
     if (!ctx)
         return;
 
-    zpoller_destroy(&ctx->poller);
-    zsock_destroy(&ctx->reporting);
     free(ctx);
 }
 
 static void
-handle_pipe(struct report_context *ctx)
+store_payload(struct report_context *ctx, struct payload *payload)
 {
-    char *command = zstr_recv(ctx->pipe);
+    /* the callchains are attributed before they are dropped with the raw values */
+    if (ctx->config->attribution && attribution_evaluate_payload(payload, (ctx->config->power_model) ? ctx->config->power_model->energy_event : NULL)) {
+        zsys_error("report: failed to attribute the samples for timestamp=%lu", payload->timestamp);
+    }
 
-    if (streq(command, "$TERM")) {
-        ctx->terminated = true;
-        zsys_info("reporting: bye!");
+    /* the metrics are evaluated once all the values of the payload have been merged */
+    if (metric_evaluate_payload(payload, ctx->config->output)) {
+        zsys_error("report: failed to evaluate the metrics for timestamp=%lu", payload->timestamp);
     }
-    else {
-        zsys_error("reporting: invalid pipe command: %s", command);
+
+    if (storage_module_store_report(ctx->config->storage, payload)) {
+        zsys_error("report: failed to store the report for timestamp=%lu", payload->timestamp);
     }
 
-    zstr_free(&command);
+    payload_destroy(payload);
 }
 
 static void
@@ -111,23 +119,128 @@ handle_reporting(struct report_context *ctx)
 {
     struct payload *payload = NULL;
 
-    zsock_recv(ctx->reporting, "p", &payload);
-    
-    if (!payload)
+    report_queue_clear_notification(ctx->queue);
+
+    while ((payload = report_queue_pop(ctx->queue))) {
+        if (ctx->config->power_model)
+            power_model_observe(ctx->config->power_model, payload);
+
+        if (ctx->config->suppression)
+            payload = suppression_filter(ctx->config->suppression, payload);
+
+        if (!payload)
+            continue;
+
+        /* the targets can be ranked by their estimated power, which is estimated before the reports are held back */
+        if (ctx->config->power_model)
+            power_model_estimate(ctx->config->power_model, payload);
+
+        if (ctx->config->ranking)
+            payload = ranking_filter(ctx->config->ranking, payload);
+
+        if (payload)
+            store_payload(ctx, payload);
+    }
+}
+
+/*
+ * handle_timers store the heartbeats of the targets whose idle reports are suppressed, and the held back reports of the long tail.
+ */
+static void
+handle_timers(struct report_context *ctx)
+{
+    zlistx_t *payloads = zlistx_new();
+    struct payload *payload = NULL;
+
+    if (!payloads)
         return;
 
-    if (storage_module_store_report(ctx->config->storage, payload)) {
-        zsys_error("report: failed to store the report for timestamp=%lu", payload->timestamp);
+    if (ctx->config->suppression)
+        suppression_heartbeat(ctx->config->suppression, payloads);
+
+    if (ctx->config->ranking)
+        ranking_update(ctx->config->ranking, payloads);
+
+    for (payload = zlistx_first(payloads); payload; payload = zlistx_next(payloads)) {
+        /* the last report of a target that stopped reporting has not been estimated yet */
+        if (ctx->config->power_model && payload->power < 0.0)
+            power_model_estimate(ctx->config->power_model, payload);
+
+        store_payload(ctx, payload);
     }
 
-    payload_destroy(payload);
+    zlistx_destroy(&payloads);
+}
+
+/*
+ * get_poll_timeout returns the time (in milliseconds) until the next timer of the stages, or -1 if there is none.
+ */
+static int
+get_poll_timeout(struct report_context *ctx)
+{
+    int timeout = -1;
+    int ranking_timeout;
+
+    if (ctx->config->suppression)
+        timeout = suppression_get_timeout(ctx->config->suppression);
+
+    if (ctx->config->ranking) {
+        ranking_timeout = ranking_get_timeout(ctx->config->ranking);
+        if (timeout == -1 || ranking_timeout < timeout)
+            timeout = ranking_timeout;
+    }
+
+    return timeout;
+}
+
+/*
+ * handle_storage_swap store the queued payloads with the current storage module, then replace it by the given one.
+ * The previous storage module is sent back, the caller is in charge of its destruction.
+ */
+static void
+handle_storage_swap(struct report_context *ctx, struct storage_module *storage)
+{
+    struct storage_module *previous = ctx->config->storage;
+
+    if (!storage) {
+        zsys_error("reporting: invalid storage swap command");
+        zsock_send(ctx->pipe, "p", NULL);
+        return;
+    }
+
+    handle_reporting(ctx);
+    ctx->config->storage = storage;
+    zsock_send(ctx->pipe, "p", previous);
+}
+
+static void
+handle_pipe(struct report_context *ctx)
+{
+    char *command = NULL;
+    void *storage = NULL;
+
+    if (zsock_recv(ctx->pipe, "sp", &command, &storage) == -1 || !command)
+        return;
+
+    if (streq(command, "$TERM")) {
+        ctx->terminated = true;
+        zsys_info("reporting: bye!");
+    }
+    else if (streq(command, "STORAGE")) {
+        handle_storage_swap(ctx, storage);
+    }
+    else {
+        zsys_error("reporting: invalid pipe command: %s", command);
+    }
+
+    zstr_free(&command);
 }
 
 void
 reporting_actor(zsock_t *pipe, void *args)
 {
     struct report_context *ctx = report_context_create(args, pipe);
-    zsock_t *which = NULL;
+    zmq_pollitem_t items[2] = {0};
    
     if (!ctx) {
         zsys_error("reporting: cannot create context");
@@ -136,21 +249,32 @@ reporting_actor(zsock_t *pipe, void *args)
 
     zsock_signal(pipe, 0);
 
+    /* the payloads queue is not a zmq socket, its notification fd is polled alongside the actor pipe */
+    items[0] = (zmq_pollitem_t){ .socket = zsock_resolve(ctx->pipe), .events = ZMQ_POLLIN };
+    items[1] = (zmq_pollitem_t){ .fd = ctx->queue->notify_fd, .events = ZMQ_POLLIN };
+
     while (!ctx->terminated) {
-        which = zpoller_wait(ctx->poller, -1);
+        if (zmq_poll(items, 2, get_poll_timeout(ctx)) == -1) {
+            if (errno == EINTR && !zsys_interrupted)
+                continue;
 
-        if (zpoller_terminated(ctx->poller)) {
             break;
         }
 
-        if (which == ctx->pipe) {
+        if (items[0].revents & ZMQ_POLLIN) {
             handle_pipe(ctx);
         }
-        else if (which == ctx->reporting) {
+        if (items[1].revents & ZMQ_POLLIN) {
             handle_reporting(ctx);
         }
+        if (ctx->config->suppression || ctx->config->ranking) {
+            handle_timers(ctx);
+        }
     }
 
+    /* the payloads queued by the final reads of the monitors are stored before exiting */
+    handle_reporting(ctx);
+
     report_context_destroy(ctx);
 }
 
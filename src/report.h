@@ -35,12 +35,25 @@
 #include <czmq.h>
 #include <stdint.h>
 
+#include "attribution.h"
+#include "metric.h"
+#include "power_model.h"
+#include "ranking.h"
+#include "report_queue.h"
+#include "suppression.h"
+
 /*
  * report_config stores the reporting module configuration.
  */
 struct report_config
 {
     struct storage_module *storage;
+    struct report_queue *queue;
+    struct suppression *suppression; /* NULL if the idle reports are not suppressed */
+    enum metric_output output; /* the derived metrics are evaluated before storage unless only the raw values are emitted */
+    struct power_model *power_model; /* NULL if the power of the targets is not estimated */
+    struct ranking *ranking; /* NULL if every target is reported at full rate */
+    bool attribution; /* the values of the targets are attributed to their sampled functions before storage */
 };
 
 /*
@@ -51,14 +64,13 @@ struct report_context
     struct report_config *config;
     bool terminated;
     zsock_t *pipe;
-    zsock_t *reporting;
-    zpoller_t *poller;
+    struct report_queue *queue;
 };
 
 /*
  * report_config_create allocate the resource of a report configuration structure.
  */
-struct report_config *report_config_create(struct storage_module *storage_module);
+struct report_config *report_config_create(struct storage_module *storage_module, struct report_queue *queue, struct suppression *suppression, enum metric_output output, struct power_model *power_model, struct ranking *ranking, bool attribution);
 
 /*
  * report_config_destroy free the allocated resource of the report configuration structure.
@@ -67,6 +79,11 @@ void report_config_destroy(struct report_config *config);
 
 /*
  * reporting_actor is the reporting actor entrypoint.
+ * The STORAGE command replaces the storage module once the queued payloads are stored, and replies with the previous one.
+ * The idle reports are suppressed before being stored if the suppression stage is enabled.
+ * The reports of the system fit the power model, which estimates the power of the other targets when they are stored.
+ * The top K targets are reported at full rate if the ranking stage is enabled, and the long tail at a reduced rate.
+ * The values and the energy of the targets can be attributed to the functions of their sampled callchains when they are stored.
  */
 void reporting_actor(zsock_t *pipe, void *args);
 
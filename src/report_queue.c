@@ -0,0 +1,321 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "payload.h"
+#include "report_queue.h"
+
+/*
+ * REPORT_QUEUE_DROP_OLDEST_MAX_RETRY stores the maximum number of attempts to make room for a payload in the queue.
+ */
+#define REPORT_QUEUE_DROP_OLDEST_MAX_RETRY 8
+
+const char *report_queue_policies_name[] = {
+    [REPORT_QUEUE_POLICY_UNKNOWN] = "unknown",
+    [REPORT_QUEUE_DROP_OLDEST] = "drop-oldest",
+    [REPORT_QUEUE_DROP_NEWEST] = "drop-newest",
+    [REPORT_QUEUE_COALESCE] = "coalesce",
+};
+
+enum report_queue_policy
+report_queue_policy_get_type(const char *policy_name)
+{
+    if (strcasecmp(policy_name, report_queue_policies_name[REPORT_QUEUE_DROP_OLDEST]) == 0)
+        return REPORT_QUEUE_DROP_OLDEST;
+
+    if (strcasecmp(policy_name, report_queue_policies_name[REPORT_QUEUE_DROP_NEWEST]) == 0)
+        return REPORT_QUEUE_DROP_NEWEST;
+
+    if (strcasecmp(policy_name, report_queue_policies_name[REPORT_QUEUE_COALESCE]) == 0)
+        return REPORT_QUEUE_COALESCE;
+
+    return REPORT_QUEUE_POLICY_UNKNOWN;
+}
+
+struct report_queue *
+report_queue_create(size_t capacity, enum report_queue_policy policy)
+{
+    struct report_queue *queue = NULL;
+    size_t size = 2;
+    size_t i;
+
+    /* the sequence numbers wrap around correctly only with a power of 2 size */
+    while (size < capacity)
+        size <<= 1;
+
+    queue = aligned_alloc(REPORT_QUEUE_CACHELINE_SIZE, sizeof(struct report_queue));
+    if (!queue)
+        return NULL;
+
+    queue->cells = malloc(sizeof(struct report_queue_cell) * size);
+    if (!queue->cells) {
+        free(queue);
+        return NULL;
+    }
+
+    errno = 0;
+    queue->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (queue->notify_fd == -1) {
+        zsys_error("report: failed to create queue notification fd: %s", strerror(errno));
+        free(queue->cells);
+        free(queue);
+        return NULL;
+    }
+
+    for (i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].payload = NULL;
+    }
+
+    queue->policy = policy;
+    queue->mask = size - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->dropped, 0);
+    atomic_init(&queue->coalesced, 0);
+
+    return queue;
+}
+
+static int
+report_queue_try_enqueue(struct report_queue *queue, struct payload *payload)
+{
+    struct report_queue_cell *cell = NULL;
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    size_t seq;
+    intptr_t diff;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        diff = (intptr_t) seq - (intptr_t) pos;
+
+        if (diff == 0) {
+            /* the cell is free, try to claim it */
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            /* the cell still holds a payload from the previous lap: the queue is full */
+            return -1;
+        }
+        else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->payload = payload;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return 0;
+}
+
+struct payload *
+report_queue_pop(struct report_queue *queue)
+{
+    struct report_queue_cell *cell = NULL;
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    size_t seq;
+    intptr_t diff;
+    struct payload *payload = NULL;
+
+    /* producers can also dequeue when applying the drop-oldest policy, so the consumer side must handle concurrency too */
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            /* the queue is empty */
+            return NULL;
+        }
+        else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    payload = cell->payload;
+    cell->payload = NULL;
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return payload;
+}
+
+static void
+report_queue_notify(struct report_queue *queue)
+{
+    const uint64_t value = 1;
+
+    /* a failure here means the counter is saturated, the consumer will be woken up anyway */
+    if (write(queue->notify_fd, &value, sizeof(value)) != sizeof(value))
+        return;
+}
+
+void
+report_queue_clear_notification(struct report_queue *queue)
+{
+    uint64_t value;
+
+    if (read(queue->notify_fd, &value, sizeof(value)) != sizeof(value))
+        return;
+}
+
+void
+report_queue_get_stats(struct report_queue *queue, struct report_queue_stats *stats)
+{
+    size_t enqueue_pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    size_t dequeue_pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+    stats->capacity = queue->mask + 1;
+    stats->depth = (enqueue_pos > dequeue_pos) ? enqueue_pos - dequeue_pos : 0;
+    stats->dropped = atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&queue->coalesced, memory_order_relaxed);
+}
+
+void
+report_queue_destroy(struct report_queue *queue)
+{
+    struct payload *payload = NULL;
+
+    if (!queue)
+        return;
+
+    while ((payload = report_queue_pop(queue)))
+        payload_destroy(payload);
+
+    close(queue->notify_fd);
+    free(queue->cells);
+    free(queue);
+}
+
+struct report_queue_producer *
+report_queue_producer_create(struct report_queue *queue)
+{
+    struct report_queue_producer *producer = malloc(sizeof(struct report_queue_producer));
+
+    if (!producer)
+        return NULL;
+
+    producer->queue = queue;
+    producer->pending = NULL;
+
+    return producer;
+}
+
+static int
+report_queue_drop_oldest_and_enqueue(struct report_queue *queue, struct payload *payload)
+{
+    struct payload *oldest = NULL;
+    int retry;
+
+    for (retry = 0; retry < REPORT_QUEUE_DROP_OLDEST_MAX_RETRY; retry++) {
+        oldest = report_queue_pop(queue);
+        if (oldest) {
+            payload_destroy(oldest);
+            atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        }
+
+        if (!report_queue_try_enqueue(queue, payload))
+            return 0;
+    }
+
+    return -1;
+}
+
+int
+report_queue_producer_push(struct report_queue_producer *producer, struct payload *payload)
+{
+    struct report_queue *queue = producer->queue;
+
+    /* fold the payload held back at the previous push into the current one */
+    if (producer->pending) {
+        if (payload_merge(payload, producer->pending))
+            zsys_error("report: failed to coalesce payload of target=%s timestamp=%" PRIu64, payload->target_name, producer->pending->timestamp);
+        else
+            atomic_fetch_add_explicit(&queue->coalesced, 1, memory_order_relaxed);
+
+        payload_destroy(producer->pending);
+        producer->pending = NULL;
+    }
+
+    if (!report_queue_try_enqueue(queue, payload)) {
+        report_queue_notify(queue);
+        return 0;
+    }
+
+    switch (queue->policy) {
+        case REPORT_QUEUE_DROP_OLDEST:
+            if (!report_queue_drop_oldest_and_enqueue(queue, payload)) {
+                report_queue_notify(queue);
+                return 0;
+            }
+            break;
+
+        case REPORT_QUEUE_COALESCE:
+            producer->pending = payload;
+            return -1;
+
+        default:
+            break;
+    }
+
+    payload_destroy(payload);
+    atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+    return -1;
+}
+
+void
+report_queue_producer_destroy(struct report_queue_producer *producer)
+{
+    if (!producer)
+        return;
+
+    /* give a last chance to the held back payload before discarding it */
+    if (producer->pending) {
+        if (!report_queue_try_enqueue(producer->queue, producer->pending))
+            report_queue_notify(producer->queue);
+        else {
+            payload_destroy(producer->pending);
+            atomic_fetch_add_explicit(&producer->queue->dropped, 1, memory_order_relaxed);
+        }
+    }
+
+    free(producer);
+}
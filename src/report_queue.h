@@ -0,0 +1,154 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REPORT_QUEUE_H
+#define REPORT_QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/*
+ * REPORT_QUEUE_CACHELINE_SIZE is used to keep the producers and consumer positions on separate cache lines.
+ */
+#define REPORT_QUEUE_CACHELINE_SIZE 64
+
+/*
+ * report_queue_policy stores the possible behaviours of the queue when it is full.
+ */
+enum report_queue_policy
+{
+    REPORT_QUEUE_POLICY_UNKNOWN,
+    REPORT_QUEUE_DROP_OLDEST,
+    REPORT_QUEUE_DROP_NEWEST,
+    REPORT_QUEUE_COALESCE
+};
+
+/*
+ * report_queue_policies_name stores the name (as string) of the supported overload policies.
+ */
+extern const char *report_queue_policies_name[];
+
+/*
+ * report_queue_cell stores a payload pointer and its sequence number.
+ */
+struct report_queue_cell
+{
+    atomic_size_t sequence;
+    struct payload *payload;
+};
+
+/*
+ * report_queue is a bounded lock-free queue of payload pointers between the monitoring actors and the reporting actor.
+ * The consumer is notified of new payloads through an eventfd.
+ */
+struct report_queue
+{
+    enum report_queue_policy policy;
+    size_t mask;
+    struct report_queue_cell *cells;
+    int notify_fd;
+    _Alignas(REPORT_QUEUE_CACHELINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(REPORT_QUEUE_CACHELINE_SIZE) atomic_size_t dequeue_pos;
+    _Alignas(REPORT_QUEUE_CACHELINE_SIZE) atomic_uint_fast64_t dropped;
+    atomic_uint_fast64_t coalesced;
+};
+
+/*
+ * report_queue_producer stores the producer side state of a monitoring actor.
+ * With the coalesce policy, the payload that did not fit in the queue is kept here and merged into the next one.
+ */
+struct report_queue_producer
+{
+    struct report_queue *queue;
+    struct payload *pending;
+};
+
+/*
+ * report_queue_stats stores a snapshot of the queue counters.
+ */
+struct report_queue_stats
+{
+    size_t capacity;
+    size_t depth;
+    uint64_t dropped;
+    uint64_t coalesced;
+};
+
+/*
+ * report_queue_policy_get_type returns the overload policy of the given policy name.
+ */
+enum report_queue_policy report_queue_policy_get_type(const char *policy_name);
+
+/*
+ * report_queue_create allocate the resources of a queue holding (at least) the given number of payloads.
+ */
+struct report_queue *report_queue_create(size_t capacity, enum report_queue_policy policy);
+
+/*
+ * report_queue_pop dequeue the oldest payload of the queue, returns NULL if the queue is empty.
+ */
+struct payload *report_queue_pop(struct report_queue *queue);
+
+/*
+ * report_queue_clear_notification acknowledge the pending notifications of the queue, this must be done before draining it.
+ */
+void report_queue_clear_notification(struct report_queue *queue);
+
+/*
+ * report_queue_get_stats take a snapshot of the queue counters.
+ */
+void report_queue_get_stats(struct report_queue *queue, struct report_queue_stats *stats);
+
+/*
+ * report_queue_destroy free the allocated resources of the queue and the payloads it still contains.
+ */
+void report_queue_destroy(struct report_queue *queue);
+
+/*
+ * report_queue_producer_create allocate the resources of a producer for the given queue.
+ */
+struct report_queue_producer *report_queue_producer_create(struct report_queue *queue);
+
+/*
+ * report_queue_producer_push enqueue the payload, applying the overload policy of the queue when it is full.
+ * The producer takes the ownership of the payload. Returns 0 if the payload is enqueued, -1 otherwise.
+ */
+int report_queue_producer_push(struct report_queue_producer *producer, struct payload *payload);
+
+/*
+ * report_queue_producer_destroy free the allocated resources of the producer.
+ */
+void report_queue_producer_destroy(struct report_queue_producer *producer);
+
+#endif /* REPORT_QUEUE_H */
@@ -0,0 +1,510 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "perf.h"
+#include "scheduler.h"
+#include "util.h"
+
+/*
+ * scheduler_worker_context stores the execution context of a monitoring worker.
+ */
+struct scheduler_worker_context
+{
+    unsigned int id;
+    struct scheduler *scheduler;
+    bool terminated;
+    bool handed_over; /* the counters have been handed over to a new sensor and must not be read anymore */
+    zsock_t *pipe;
+    zsock_t *ticker;
+    zpoller_t *poller;
+    zhashx_t *monitors; /* char *target_key -> struct perf_context *monitor */
+    uint64_t last_tick_sequence;
+    uint64_t missed_ticks;
+};
+
+static struct scheduler_worker_context *
+scheduler_worker_context_create(struct scheduler_worker *worker, zsock_t *pipe)
+{
+    struct scheduler_worker_context *ctx = malloc(sizeof(struct scheduler_worker_context));
+
+    if (!ctx)
+        return NULL;
+
+    ctx->id = worker->id;
+    ctx->scheduler = worker->scheduler;
+    ctx->terminated = false;
+    ctx->handed_over = false;
+    ctx->pipe = pipe;
+    ctx->ticker = zsock_new_sub("inproc://ticker", "CLOCK_TICK");
+    ctx->poller = zpoller_new(ctx->pipe, ctx->ticker, NULL);
+    ctx->monitors = zhashx_new();
+    zhashx_set_destructor(ctx->monitors, (zhashx_destructor_fn *) perf_monitor_destroy);
+    ctx->last_tick_sequence = 0;
+    ctx->missed_ticks = 0;
+
+    return ctx;
+}
+
+static void
+scheduler_worker_context_destroy(struct scheduler_worker_context *ctx)
+{
+    if (!ctx)
+        return;
+
+    zhashx_destroy(&ctx->monitors);
+    zpoller_destroy(&ctx->poller);
+    zsock_destroy(&ctx->ticker);
+    free(ctx);
+}
+
+/*
+ * report_failed_target notify the main thread that the monitoring of the target failed to start.
+ */
+static void
+report_failed_target(struct scheduler_worker_context *ctx, const char *target_key)
+{
+    struct scheduler_failure *failure = malloc(sizeof(struct scheduler_failure));
+
+    if (!failure)
+        return;
+
+    failure->target_key = strdup(target_key);
+    if (!failure->target_key) {
+        free(failure);
+        return;
+    }
+
+    failure->retry_at = (uint64_t) zclock_mono() + SCHEDULER_ATTACH_RETRY_PERIOD;
+    pthread_mutex_lock(&ctx->scheduler->lock);
+    zlistx_add_end(ctx->scheduler->failed, failure);
+    pthread_mutex_unlock(&ctx->scheduler->lock);
+}
+
+static void
+handle_attach(struct scheduler_worker_context *ctx, const char *target_key, struct perf_config *config)
+{
+    struct perf_context *monitor = NULL;
+
+    if (!target_key || !config) {
+        zsys_error("scheduler<%u>: invalid attach command", ctx->id);
+        perf_config_destroy(config);
+        if (target_key)
+            report_failed_target(ctx, target_key);
+        return;
+    }
+
+    monitor = perf_monitor_create(config);
+    if (!monitor) {
+        zsys_error("scheduler<%u>: failed to start monitoring of target=%s", ctx->id, target_key);
+        report_failed_target(ctx, target_key);
+        return;
+    }
+
+    /* replace the previous monitor of the target if it has been attached again */
+    zhashx_update(ctx->monitors, target_key, monitor);
+}
+
+static void
+handle_detach(struct scheduler_worker_context *ctx, const char *target_key)
+{
+    struct perf_context *monitor = NULL;
+
+    if (!target_key) {
+        zsys_error("scheduler<%u>: invalid detach command", ctx->id);
+        return;
+    }
+
+    /* the counters of a removed cgroup can still be read, so the interval since the last tick is not lost */
+    monitor = zhashx_lookup(ctx->monitors, target_key);
+    if (monitor)
+        perf_monitor_flush(monitor, (uint64_t) zclock_time());
+
+    zhashx_delete(ctx->monitors, target_key);
+}
+
+static void
+handle_reconfigure(struct scheduler_worker_context *ctx, const char *target_key, struct perf_config *config)
+{
+    struct perf_context *monitor = NULL;
+
+    if (!target_key || !config) {
+        zsys_error("scheduler<%u>: invalid reconfigure command", ctx->id);
+        perf_config_destroy(config);
+        return;
+    }
+
+    /* the monitor may have failed to start */
+    monitor = zhashx_lookup(ctx->monitors, target_key);
+    if (!monitor) {
+        perf_config_destroy(config);
+        return;
+    }
+
+    /* a monitor holding only a part of its groups is not kept, the values of its unchanged groups are reported and it is attached again later */
+    if (perf_monitor_reconfigure(monitor, config)) {
+        zsys_error("scheduler<%u>: failed to reconfigure monitoring of target=%s", ctx->id, target_key);
+        perf_monitor_flush(monitor, (uint64_t) zclock_time());
+        zhashx_delete(ctx->monitors, target_key);
+        report_failed_target(ctx, target_key);
+    }
+}
+
+static void
+handle_handover(struct scheduler_worker_context *ctx, const int *sock)
+{
+    struct perf_context *monitor = NULL;
+    int status = 0;
+
+    if (!sock) {
+        zsys_error("scheduler<%u>: invalid handover command", ctx->id);
+        zsock_signal(ctx->pipe, 1);
+        return;
+    }
+
+    for (monitor = zhashx_first(ctx->monitors); monitor; monitor = zhashx_next(ctx->monitors)) {
+        if (perf_monitor_export(monitor, zhashx_cursor(ctx->monitors), *sock)) {
+            zsys_error("scheduler<%u>: failed to hand over target=%s", ctx->id, (const char *) zhashx_cursor(ctx->monitors));
+            status = 1;
+            break;
+        }
+    }
+
+    /* the counters now belong to the new sensor, reading them would reset its values */
+    ctx->handed_over = (status == 0);
+    zsock_signal(ctx->pipe, status);
+}
+
+/*
+ * handle_resume read the counters again after a handover aborted by another worker.
+ */
+static void
+handle_resume(struct scheduler_worker_context *ctx)
+{
+    ctx->handed_over = false;
+}
+
+static void
+handle_pipe(struct scheduler_worker_context *ctx)
+{
+    char *command = NULL;
+    char *target_key = NULL;
+    void *config = NULL;
+
+    if (zsock_recv(ctx->pipe, "ssp", &command, &target_key, &config) == -1 || !command)
+        return;
+
+    if (streq(command, "$TERM")) {
+        ctx->terminated = true;
+        zsys_info("scheduler<%u>: shutting down worker monitoring %zu target(s)", ctx->id, zhashx_size(ctx->monitors));
+    }
+    else if (streq(command, "ATTACH"))
+        handle_attach(ctx, target_key, config);
+    else if (streq(command, "DETACH"))
+        handle_detach(ctx, target_key);
+    else if (streq(command, "RECONFIGURE"))
+        handle_reconfigure(ctx, target_key, config);
+    else if (streq(command, "HANDOVER"))
+        handle_handover(ctx, config);
+    else if (streq(command, "RESUME"))
+        handle_resume(ctx);
+    else
+        zsys_error("scheduler<%u>: invalid pipe command: %s", ctx->id, command);
+
+    zstr_free(&target_key);
+    zstr_free(&command);
+}
+
+static void
+handle_ticker(struct scheduler_worker_context *ctx)
+{
+    uint64_t sequence;
+    uint64_t timestamp;
+    uint64_t deadline;
+    uint64_t burst_period;
+    uint64_t missed;
+    struct perf_context *monitor = NULL;
+
+    /* get tick sequence number, timestamp (in nanoseconds) and the period (in milliseconds) of the running capture window */
+    zsock_recv(ctx->ticker, "s8888", NULL, &sequence, &timestamp, &deadline, &burst_period);
+
+    /*
+     * Skip the ticks queued while the worker was busy and only process the most recent one.
+     * The counters are reset at each read, so the skipped intervals are coalesced into the next read.
+     */
+    while (zsock_events(ctx->ticker) & ZMQ_POLLIN) {
+        zsock_recv(ctx->ticker, "s8888", NULL, &sequence, &timestamp, &deadline, &burst_period);
+    }
+
+    if (ctx->last_tick_sequence && sequence > ctx->last_tick_sequence + 1) {
+        missed = sequence - ctx->last_tick_sequence - 1;
+        ctx->missed_ticks += missed;
+        zsys_warning("scheduler<%u>: missed %" PRIu64 " tick(s) (total=%" PRIu64 ")", ctx->id, missed, ctx->missed_ticks);
+    }
+    ctx->last_tick_sequence = sequence;
+
+    if (ctx->handed_over)
+        return;
+
+    /* reports timestamp and the periods of the groups are in milliseconds */
+    timestamp /= 1000000;
+    deadline /= 1000000;
+
+    for (monitor = zhashx_first(ctx->monitors); monitor; monitor = zhashx_next(ctx->monitors)) {
+        perf_monitor_tick(monitor, timestamp, deadline, (unsigned int) burst_period);
+    }
+}
+
+static void
+scheduler_failure_destroy(struct scheduler_failure **failure_ptr)
+{
+    if (!*failure_ptr)
+        return;
+
+    free((*failure_ptr)->target_key);
+    free(*failure_ptr);
+    *failure_ptr = NULL;
+}
+
+static void
+scheduler_worker_actor(zsock_t *pipe, void *args)
+{
+    struct scheduler_worker_context *ctx = scheduler_worker_context_create(args, pipe);
+    zsock_t *which = NULL;
+
+    if (!ctx) {
+        zsys_error("scheduler: cannot create worker context");
+        return;
+    }
+
+    zsock_signal(pipe, 0);
+
+    while (!ctx->terminated) {
+        which = zpoller_wait(ctx->poller, -1);
+
+        if (zpoller_terminated(ctx->poller))
+            break;
+
+        if (which == ctx->pipe)
+            handle_pipe(ctx);
+        else if (which == ctx->ticker)
+            handle_ticker(ctx);
+    }
+
+    scheduler_worker_context_destroy(ctx);
+}
+
+struct scheduler *
+scheduler_create(unsigned int num_workers)
+{
+    struct scheduler *scheduler = NULL;
+    unsigned int i;
+
+    if (num_workers == 0)
+        return NULL;
+
+    scheduler = malloc(sizeof(struct scheduler));
+    if (!scheduler)
+        return NULL;
+
+    scheduler->num_workers = num_workers;
+    scheduler->targets = zhashx_new();
+    zhashx_set_duplicator(scheduler->targets, (zhashx_duplicator_fn *) intptrdup);
+    zhashx_set_destructor(scheduler->targets, (zhashx_destructor_fn *) ptrfree);
+    pthread_mutex_init(&scheduler->lock, NULL);
+    scheduler->failed = zlistx_new();
+    zlistx_set_destructor(scheduler->failed, (zlistx_destructor_fn *) scheduler_failure_destroy);
+
+    scheduler->workers = calloc(num_workers, sizeof(struct scheduler_worker));
+    if (!scheduler->workers) {
+        scheduler_destroy(scheduler);
+        return NULL;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        scheduler->workers[i].id = i;
+        scheduler->workers[i].num_targets = 0;
+        scheduler->workers[i].scheduler = scheduler;
+        scheduler->workers[i].actor = zactor_new(scheduler_worker_actor, &scheduler->workers[i]);
+        if (!scheduler->workers[i].actor) {
+            zsys_error("scheduler: failed to start worker %u", i);
+            scheduler_destroy(scheduler);
+            return NULL;
+        }
+    }
+
+    return scheduler;
+}
+
+int
+scheduler_attach(struct scheduler *scheduler, const char *target_key, struct perf_config *config)
+{
+    int worker_id;
+    struct scheduler_worker *worker = NULL;
+
+    if (zhashx_lookup(scheduler->targets, target_key)) {
+        perf_config_destroy(config);
+        return -1;
+    }
+
+    worker_id = (int) (strhash(target_key) % scheduler->num_workers);
+    worker = &scheduler->workers[worker_id];
+
+    /* the monitor is setup by the worker, the main loop is not blocked by the perf_event_open calls */
+    if (zsock_send(worker->actor, "ssp", "ATTACH", target_key, config)) {
+        zsys_error("scheduler: failed to send attach command for target=%s to worker %d", target_key, worker_id);
+        perf_config_destroy(config);
+        return -1;
+    }
+
+    zhashx_insert(scheduler->targets, target_key, &worker_id);
+    worker->num_targets++;
+    return 0;
+}
+
+size_t
+scheduler_reap_failed(struct scheduler *scheduler)
+{
+    uint64_t now = (uint64_t) zclock_mono();
+    struct scheduler_failure *failure = NULL;
+    int *worker_id = NULL;
+    size_t count = 0;
+
+    pthread_mutex_lock(&scheduler->lock);
+    failure = zlistx_first(scheduler->failed);
+    while (failure && failure->retry_at <= now) {
+        /* a target attached again after its failure is replaced on its worker, forgetting it only attaches it once more */
+        worker_id = zhashx_lookup(scheduler->targets, failure->target_key);
+        if (worker_id) {
+            scheduler->workers[*worker_id].num_targets--;
+            zhashx_delete(scheduler->targets, failure->target_key);
+            count++;
+        }
+
+        /* the failures are reported in order, so the next ones are not due yet once one is not */
+        zlistx_delete(scheduler->failed, zlistx_cursor(scheduler->failed));
+        failure = zlistx_first(scheduler->failed);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+
+    return count;
+}
+
+int
+scheduler_detach(struct scheduler *scheduler, const char *target_key)
+{
+    int *worker_id = zhashx_lookup(scheduler->targets, target_key);
+    struct scheduler_worker *worker = NULL;
+
+    if (!worker_id)
+        return -1;
+
+    worker = &scheduler->workers[*worker_id];
+    if (zsock_send(worker->actor, "ssp", "DETACH", target_key, NULL)) {
+        zsys_error("scheduler: failed to send detach command for target=%s to worker %d", target_key, *worker_id);
+        return -1;
+    }
+
+    worker->num_targets--;
+    zhashx_delete(scheduler->targets, target_key);
+    return 0;
+}
+
+int
+scheduler_reconfigure(struct scheduler *scheduler, const char *target_key, struct perf_config *config)
+{
+    int *worker_id = zhashx_lookup(scheduler->targets, target_key);
+
+    if (!worker_id) {
+        perf_config_destroy(config);
+        return -1;
+    }
+
+    if (zsock_send(scheduler->workers[*worker_id].actor, "ssp", "RECONFIGURE", target_key, config)) {
+        zsys_error("scheduler: failed to send reconfigure command for target=%s to worker %d", target_key, *worker_id);
+        perf_config_destroy(config);
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+scheduler_handover(struct scheduler *scheduler, int sock)
+{
+    unsigned int i;
+    int status = 0;
+
+    /* the workers send their fds one after the other, the records of a target are not interleaved with the others */
+    for (i = 0; i < scheduler->num_workers && status == 0; i++) {
+        if (zsock_send(scheduler->workers[i].actor, "ssp", "HANDOVER", "", &sock) || zsock_wait(scheduler->workers[i].actor)) {
+            zsys_error("scheduler: failed to hand over the targets of worker %u", i);
+            status = -1;
+        }
+    }
+
+    /* the new sensor gives up the handover, so the workers that sent their fds keep reading the counters */
+    if (status) {
+        for (i = 0; i < scheduler->num_workers; i++)
+            zsock_send(scheduler->workers[i].actor, "ssp", "RESUME", "", NULL);
+    }
+
+    return status;
+}
+
+bool
+scheduler_is_attached(struct scheduler *scheduler, const char *target_key)
+{
+    return zhashx_lookup(scheduler->targets, target_key) != NULL;
+}
+
+void
+scheduler_destroy(struct scheduler *scheduler)
+{
+    unsigned int i;
+
+    if (!scheduler)
+        return;
+
+    if (scheduler->workers) {
+        for (i = 0; i < scheduler->num_workers; i++)
+            zactor_destroy(&scheduler->workers[i].actor);
+    }
+
+    free(scheduler->workers);
+    zhashx_destroy(&scheduler->targets);
+    zlistx_destroy(&scheduler->failed);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler);
+}
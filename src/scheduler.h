@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <czmq.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "perf.h"
+
+/*
+ * SCHEDULER_ATTACH_RETRY_PERIOD is the delay (in milliseconds) before attaching again a target whose monitoring failed to start.
+ */
+#define SCHEDULER_ATTACH_RETRY_PERIOD 10000
+
+struct scheduler;
+
+/*
+ * scheduler_failure stores a target whose monitoring failed to start on its worker.
+ */
+struct scheduler_failure
+{
+    char *target_key;
+    uint64_t retry_at; /* monotonic timestamp (in milliseconds) */
+};
+
+/*
+ * scheduler_worker stores the information about a monitoring worker.
+ */
+struct scheduler_worker
+{
+    unsigned int id;
+    zactor_t *actor;
+    size_t num_targets;
+    struct scheduler *scheduler;
+};
+
+/*
+ * scheduler stores the pool of monitoring workers and the assignment of the targets to the workers.
+ * The targets are spread over a fixed number of workers, so the number of threads does not depend on the number of targets.
+ */
+struct scheduler
+{
+    unsigned int num_workers;
+    struct scheduler_worker *workers;
+    zhashx_t *targets; /* char *target_key -> unsigned int *worker_id */
+    pthread_mutex_t lock; /* the failed attachments are reported by the workers */
+    zlistx_t *failed; /* struct scheduler_failure *failure */
+};
+
+/*
+ * scheduler_create allocate the resources and start the given number of monitoring workers.
+ */
+struct scheduler *scheduler_create(unsigned int num_workers);
+
+/*
+ * scheduler_attach asynchronously start the monitoring of a target on one of the workers.
+ * The scheduler takes the ownership of the monitoring config.
+ */
+int scheduler_attach(struct scheduler *scheduler, const char *target_key, struct perf_config *config);
+
+/*
+ * scheduler_reap_failed forget the targets whose monitoring failed to start on their worker, so they are attached again.
+ * A target is only forgotten once the retry period elapsed since its failure.
+ * Returns the number of forgotten targets.
+ */
+size_t scheduler_reap_failed(struct scheduler *scheduler);
+
+/*
+ * scheduler_detach asynchronously stop the monitoring of a target.
+ */
+int scheduler_detach(struct scheduler *scheduler, const char *target_key);
+
+/*
+ * scheduler_reconfigure asynchronously apply a new monitoring config to a target.
+ * The scheduler takes the ownership of the monitoring config.
+ */
+int scheduler_reconfigure(struct scheduler *scheduler, const char *target_key, struct perf_config *config);
+
+/*
+ * scheduler_handover send the fds of the counters of all the targets to a new sensor through the handover socket.
+ * The workers stop reading the counters once their targets have been handed over, and resume if the handover of a worker failed.
+ */
+int scheduler_handover(struct scheduler *scheduler, int sock);
+
+/*
+ * scheduler_is_attached returns true if the target is monitored by one of the workers.
+ */
+bool scheduler_is_attached(struct scheduler *scheduler, const char *target_key);
+
+/*
+ * scheduler_destroy stop the workers and free the allocated resources.
+ */
+void scheduler_destroy(struct scheduler *scheduler);
+
+#endif /* SCHEDULER_H */
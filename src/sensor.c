@@ -30,9 +30,15 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <czmq.h>
@@ -40,12 +46,26 @@
 
 #include "version.h"
 #include "config.h"
+#include "config_snapshot.h"
+#include "discovery.h"
+#include "burst.h"
+#include "fd_budget.h"
+#include "open_pool.h"
+#include "suppression.h"
+#include "power_model.h"
+#include "ranking.h"
+#include "handover.h"
 #include "pmu.h"
 #include "events.h"
 #include "hwinfo.h"
 #include "perf.h"
 #include "report.h"
+#include "report_queue.h"
+#include "scheduler.h"
 #include "target.h"
+#include "target_classifier.h"
+#include "target_resolver.h"
+#include "ticker.h"
 #include "storage.h"
 #include "storage_null.h"
 #include "storage_csv.h"
@@ -55,6 +75,129 @@
 #include "storage_mongodb.h"
 #endif
 
+/*
+ * SYSTEM_TARGET_KEY is the key used to register the system target to the scheduler.
+ */
+#define SYSTEM_TARGET_KEY "system"
+
+/*
+ * FD_BUDGET_RESERVED is the number of file descriptors kept out of the perf events budget, for the sockets and files of the sensor.
+ */
+#define FD_BUDGET_RESERVED 256
+
+/*
+ * raise_nofile_limit raise the limit of open file descriptors as much as allowed, and returns the resulting limit.
+ */
+static rlim_t
+raise_nofile_limit(void)
+{
+    struct rlimit limit;
+    FILE *nr_open_file = NULL;
+    unsigned long nr_open = 0;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit)) {
+        zsys_error("sensor: cannot get the limit of open file descriptors");
+        return 0;
+    }
+
+    /* the hard limit can only be raised up to fs.nr_open with the CAP_SYS_RESOURCE capability */
+    nr_open_file = fopen("/proc/sys/fs/nr_open", "r");
+    if (nr_open_file) {
+        if (fscanf(nr_open_file, "%lu", &nr_open) == 1 && limit.rlim_max != RLIM_INFINITY && nr_open > limit.rlim_max) {
+            struct rlimit raised = {.rlim_cur = nr_open, .rlim_max = nr_open};
+            if (!setrlimit(RLIMIT_NOFILE, &raised))
+                limit = raised;
+        }
+        fclose(nr_open_file);
+    }
+
+    /* the soft limit can always be raised up to the hard limit */
+    if (limit.rlim_cur != limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit)) {
+            zsys_warning("sensor: cannot raise the limit of open file descriptors");
+            getrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    return limit.rlim_cur;
+}
+
+/*
+ * sensor_reload_context stores the running components of the sensor updated when the configuration is reloaded.
+ */
+struct sensor_reload_context
+{
+    const char *config_file_path;
+    struct config **config;
+    zlistx_t *docs; /* bson_t *doc, kept until exit because the configs and snapshots borrow their strings */
+    struct hwinfo *hwinfo;
+    struct storage_module **storage;
+    zactor_t *reporting;
+    struct report_queue *queue;
+    struct scheduler *scheduler;
+    struct discovery *discovery;
+    struct target_resolver *resolver;
+    struct fd_budget *budget;
+    struct open_pool *opener;
+    struct burst *burst;
+    struct ticker *ticker;
+    struct config_snapshot *_Atomic *containers_snapshot;
+    unsigned int *callchain_frequency;
+};
+
+/*
+ * reload_requested is set when a SIGHUP is received, the configuration is reloaded by the main loop.
+ */
+static volatile sig_atomic_t reload_requested = 0;
+
+static void
+handle_sighup(int signum)
+{
+    (void) signum;
+    reload_requested = 1;
+}
+
+/*
+ * burst_requested is set when a SIGUSR1 is received, a capture window is started by the main loop.
+ */
+static volatile sig_atomic_t burst_requested = 0;
+
+static void
+handle_sigusr1(int signum)
+{
+    (void) signum;
+    burst_requested = 1;
+}
+
+/*
+ * load_config_file setup the config from the given config file, the strings of the config are stored in the document.
+ */
+static int
+load_config_file(struct config *config, const char *config_file_path, bson_t *doc)
+{
+    bson_json_reader_t *reader = NULL;
+    bson_error_t error;
+    int ret = -1;
+
+    reader = bson_json_reader_new_from_file(config_file_path, &error);
+    if (!reader) {
+        zsys_error("config: Failed to open config file \"%s\": %s\n", config_file_path, error.message);
+        return -1;
+    }
+
+    if (bson_json_reader_read(reader, doc, &error) < 0) {
+        zsys_error("config: Error in json parsing:\n%s\n", error.message);
+        goto out;
+    }
+
+    ret = config_setup_from_file(config, doc);
+
+out:
+    bson_json_reader_destroy(reader);
+    return ret;
+}
+
 static struct storage_module *
 setup_storage_module(struct config *config)
 {
@@ -75,48 +218,431 @@ setup_storage_module(struct config *config)
     }
 }
 
+static unsigned int
+gcd(unsigned int a, unsigned int b)
+{
+    unsigned int r;
+
+    while (b) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+/*
+ * compute_tick_period returns the period (in milliseconds) of the ticker, so every events group is read at its own period.
+ * This is the greatest common divisor of the frequency of the sensor, of the read period and of the periods of the events groups.
+ */
+static unsigned int
+compute_tick_period(struct config *config)
+{
+    zhashx_t *events_groups[] = { config->events.system, config->events.containers };
+    struct events_group *group = NULL;
+    unsigned int period = config->sensor.frequency;
+    size_t i;
+
+    if (config->sensor.read_period)
+        period = gcd(period, config->sensor.read_period);
+
+    for (i = 0; i < sizeof(events_groups) / sizeof(events_groups[0]); i++) {
+        for (group = zhashx_first(events_groups[i]); group; group = zhashx_next(events_groups[i])) {
+            if (group->period)
+                period = gcd(period, group->period);
+        }
+    }
+
+    return period;
+}
+
+/*
+ * wait_tick_or_discovery block until the next tick deadline, a change in the cgroup hierarchy or a new sensor connecting to the handover socket.
+ * Returns true if the tick deadline elapsed.
+ */
+static bool
+wait_tick_or_discovery(struct ticker *ticker, struct discovery *discovery, int handover_fd, bool *handover_requested)
+{
+    struct pollfd fds[3] = {
+        {.fd = ticker->timer_fd, .events = POLLIN},
+        {.fd = (discovery) ? discovery->inotify_fd : -1, .events = POLLIN},
+        {.fd = handover_fd, .events = POLLIN}
+    };
+
+    if (poll(fds, 3, -1) == -1)
+        return false;
+
+    *handover_requested = fds[2].revents & POLLIN;
+    return fds[0].revents & POLLIN;
+}
+
+/*
+ * handover_monitors send the counters of all the targets to the new sensor connected to the handover socket.
+ * Returns 0 if the new sensor took over the monitoring, and the current one has to exit.
+ */
+static int
+handover_monitors(int handover_fd, struct scheduler *scheduler)
+{
+    int sock;
+    int ret = -1;
+
+    sock = accept(handover_fd, NULL, NULL);
+    if (sock == -1) {
+        zsys_error("sensor: failed to accept the handover connection: %s", strerror(errno));
+        return -1;
+    }
+
+    zsys_info("sensor: handing over the monitoring of %zu target(s) to a new sensor", zhashx_size(scheduler->targets));
+    if (scheduler_handover(scheduler, sock) == 0 && handover_send_end(sock) == 0)
+        ret = 0;
+
+    /* the new sensor closes the fds it received and exits, the current one keeps monitoring the targets */
+    if (ret) {
+        zsys_error("sensor: failed to hand over the monitoring, the current sensor keeps monitoring the targets");
+        handover_send_abort(sock);
+    }
+
+    close(sock);
+    return ret;
+}
+
+/*
+ * is_system_monitored returns true if the system events are configured and the sensor owns the system target.
+ */
+static bool
+is_system_monitored(struct config *config)
+{
+    return zhashx_size(config->events.system) && config->sensor.shard_index == 0;
+}
+
+/*
+ * attach_system_target start the monitoring of the system with the given configuration, returns -1 if it cannot be built.
+ */
+static int
+attach_system_target(struct config *config, struct hwinfo *hwinfo, struct scheduler *scheduler, unsigned int callchain_frequency, struct report_queue *queue, struct fd_budget *budget, struct open_pool *opener, struct burst *burst, struct handover_state *handover)
+{
+    struct config_snapshot *system_snapshot = NULL;
+    struct perf_config *system_monitor_config = NULL;
+
+    system_snapshot = config_snapshot_create(hwinfo, config->events.system, config->sensor.frequency, config->sensor.read_period);
+    if (!system_snapshot) {
+        zsys_error("sensor: failed to build the system monitoring configuration");
+        return -1;
+    }
+
+    system_monitor_config = perf_config_create(system_snapshot, target_create(TARGET_TYPE_ALL, NULL, NULL, NULL), callchain_frequency, queue, NULL, 0, 0, budget, opener, burst);
+    if (system_monitor_config)
+        system_monitor_config->handover = handover_state_take_target(handover, SYSTEM_TARGET_KEY);
+    config_snapshot_release(&system_snapshot);
+    scheduler_attach(scheduler, SYSTEM_TARGET_KEY, system_monitor_config);
+    return 0;
+}
+
 static void
-sync_cgroups_running_monitored(struct hwinfo *hwinfo, zhashx_t *container_events_groups, const char *cgroup_basepath, zhashx_t *container_monitoring_actors, unsigned int callchain_frequency)
+sync_cgroups_running_monitored(struct config_snapshot *snapshot, struct config *config, zhashx_t *running_targets, struct scheduler *scheduler, unsigned int callchain_frequency, struct report_queue *queue, struct target_resolver *resolver, struct fd_budget *budget, struct open_pool *opener, struct burst *burst, struct handover_state *handover)
 {
-    zhashx_t *running_targets = NULL; /* char *cgroup_path -> struct target *target */
-    zactor_t *perf_monitor = NULL;
+    zlistx_t *monitored_targets = NULL; /* char *target_key */
     const char *cgroup_path = NULL;
     struct target *target = NULL;
     struct perf_config *monitor_config = NULL;
 
-    /* to store running cgroups name and absolute path */
-    running_targets = zhashx_new();
-
-    /* get running (and identifiable) container(s) */
-    if (target_discover_running(cgroup_basepath, TARGET_TYPE_EVERYTHING, running_targets)) {
-        zsys_error("sensor: error when retrieving the running targets.");
-        goto out;
-    }
-
     /* stop monitoring dead container(s) */
-    for (perf_monitor = zhashx_first(container_monitoring_actors); perf_monitor; perf_monitor = zhashx_next(container_monitoring_actors)) {
-        cgroup_path = zhashx_cursor(container_monitoring_actors);
-        target = zhashx_lookup(running_targets, cgroup_path);
-        if (!target) {
-            zhashx_freefn(running_targets, cgroup_path, (zhashx_free_fn *) target_destroy);
-            zhashx_delete(container_monitoring_actors, cgroup_path);
-        }
+    monitored_targets = zhashx_keys(scheduler->targets);
+    for (cgroup_path = zlistx_first(monitored_targets); cgroup_path; cgroup_path = zlistx_next(monitored_targets)) {
+        if (!streq(cgroup_path, SYSTEM_TARGET_KEY) && !zhashx_lookup(running_targets, cgroup_path))
+            scheduler_detach(scheduler, cgroup_path);
     }
+    zlistx_destroy(&monitored_targets);
 
-    /* start monitoring new container(s) */
+    /* start monitoring new container(s), the running targets are owned by the discovery */
     for (target = zhashx_first(running_targets); target; target = zhashx_next(running_targets)) {
         cgroup_path = zhashx_cursor(running_targets);
-        if (!zhashx_lookup(container_monitoring_actors, cgroup_path)) {
-            monitor_config = perf_config_create(hwinfo, container_events_groups, target, callchain_frequency);
-            perf_monitor = zactor_new(perf_monitoring_actor, monitor_config);
-            zhashx_insert(container_monitoring_actors, cgroup_path, perf_monitor);
-        } else {
-            zhashx_freefn(running_targets, cgroup_path, (zhashx_free_fn *) target_destroy);
+        if (!scheduler_is_attached(scheduler, cgroup_path)) {
+            /* the monitoring starts under the cgroup path, the name and labels of the container are resolved in background */
+            target_resolver_request(resolver, target);
+            monitor_config = perf_config_create(snapshot, target_dup(target), callchain_frequency, queue, resolver, config->sensor.activity_threshold, config->sensor.idle_period, budget, opener, burst);
+            if (monitor_config)
+                monitor_config->handover = handover_state_take_target(handover, cgroup_path);
+            scheduler_attach(scheduler, cgroup_path, monitor_config);
         }
     }
+}
 
-out:
-    zhashx_destroy(&running_targets);
+static void
+bson_ptr_destroy(bson_t **doc_ptr)
+{
+    bson_destroy(*doc_ptr);
+    *doc_ptr = NULL;
+}
+
+static bool
+is_same_string(const char *a, const char *b)
+{
+    return (a && b) ? streq(a, b) : a == b;
+}
+
+/*
+ * keep_restart_only_settings replace the settings that cannot be changed without restarting the sensor by their running value.
+ */
+static void
+keep_restart_only_settings(struct config *config, struct config *running, bool containers_monitored)
+{
+    zhashx_t *containers_events = NULL;
+
+    if (config->sensor.workers != running->sensor.workers ||
+        !is_same_string(config->sensor.cgroup_basepath, running->sensor.cgroup_basepath) ||
+        config->sensor.aggregation != running->sensor.aggregation ||
+        config->sensor.discovery_rescan_interval != running->sensor.discovery_rescan_interval ||
+        config->report.queue_size != running->report.queue_size ||
+        config->report.queue_policy != running->report.queue_policy ||
+        config->report.suppress_idle != running->report.suppress_idle ||
+        config->report.idle_threshold != running->report.idle_threshold ||
+        config->report.heartbeat_period != running->report.heartbeat_period ||
+        config->storage.output != running->storage.output ||
+        !is_same_string(config->report.power_group, running->report.power_group) ||
+        !is_same_string(config->report.power_energy_event, running->report.power_energy_event) ||
+        config->report.power_window != running->report.power_window ||
+        config->report.power_refit_interval != running->report.power_refit_interval ||
+        config->report.top_k != running->report.top_k ||
+        !is_same_string(config->report.rank_event, running->report.rank_event) ||
+        config->report.rank_tail != running->report.rank_tail ||
+        config->report.tail_interval != running->report.tail_interval ||
+        config->report.rank_period != running->report.rank_period ||
+        config->report.attribution != running->report.attribution ||
+        config->sensor.shard_index != running->sensor.shard_index ||
+        config->sensor.shard_count != running->sensor.shard_count ||
+        config->sensor.burst_period != running->sensor.burst_period ||
+        config->sensor.burst_duration != running->sensor.burst_duration ||
+        config->sensor.burst_callchain_frequency != running->sensor.burst_callchain_frequency ||
+        !is_same_string(config->sensor.burst_trigger_event, running->sensor.burst_trigger_event) ||
+        config->sensor.burst_trigger_threshold != running->sensor.burst_trigger_threshold) {
+        zsys_warning("sensor: the workers, discovery, sharding, capture windows and reporting settings require a restart, their running values are kept");
+    }
+
+    config->sensor.workers = running->sensor.workers;
+    config->sensor.cgroup_basepath = running->sensor.cgroup_basepath;
+    config->sensor.aggregation = running->sensor.aggregation;
+    config->sensor.discovery_rescan_interval = running->sensor.discovery_rescan_interval;
+    config->report.queue_size = running->report.queue_size;
+    config->report.queue_policy = running->report.queue_policy;
+    config->report.suppress_idle = running->report.suppress_idle;
+    config->report.idle_threshold = running->report.idle_threshold;
+    config->report.heartbeat_period = running->report.heartbeat_period;
+    config->storage.output = running->storage.output;
+    config->report.power_group = running->report.power_group;
+    config->report.power_energy_event = running->report.power_energy_event;
+    config->report.power_window = running->report.power_window;
+    config->report.power_refit_interval = running->report.power_refit_interval;
+    config->report.top_k = running->report.top_k;
+    config->report.rank_event = running->report.rank_event;
+    config->report.rank_tail = running->report.rank_tail;
+    config->report.tail_interval = running->report.tail_interval;
+    config->report.rank_period = running->report.rank_period;
+    config->report.attribution = running->report.attribution;
+    config->sensor.handover_socket = running->sensor.handover_socket;
+    config->sensor.shard_index = running->sensor.shard_index;
+    config->sensor.shard_count = running->sensor.shard_count;
+    config->sensor.burst_period = running->sensor.burst_period;
+    config->sensor.burst_duration = running->sensor.burst_duration;
+    config->sensor.burst_callchain_frequency = running->sensor.burst_callchain_frequency;
+    config->sensor.burst_trigger_event = running->sensor.burst_trigger_event;
+    config->sensor.burst_trigger_threshold = running->sensor.burst_trigger_threshold;
+
+    /* the discovery of the containers is only started at startup */
+    if ((zhashx_size(config->events.containers) > 0) != containers_monitored) {
+        zsys_warning("sensor: enabling or disabling the monitoring of the containers requires a restart, the running events are kept");
+        containers_events = config->events.containers;
+        config->events.containers = running->events.containers;
+        running->events.containers = containers_events;
+    }
+}
+
+/*
+ * reload_storage_module replace the storage module if its settings have changed, the queued payloads are stored by the previous one.
+ */
+static void
+reload_storage_module(struct sensor_reload_context *reload, struct config *config, struct config *running)
+{
+    struct storage_module *storage = NULL;
+    void *previous = NULL;
+
+    if (config->storage.type == running->storage.type &&
+        is_same_string(config->storage.U_flag, running->storage.U_flag) &&
+        is_same_string(config->storage.D_flag, running->storage.D_flag) &&
+        is_same_string(config->storage.C_flag, running->storage.C_flag) &&
+        config->storage.P_flag == running->storage.P_flag &&
+        is_same_string(config->sensor.name, running->sensor.name))
+        return;
+
+    storage = setup_storage_module(config);
+    if (!storage || storage_module_initialize(storage)) {
+        zsys_error("sensor: failed to initialize the new '%s' storage module, the running one is kept", storage_types_name[config->storage.type]);
+        goto error;
+    }
+    if (storage_module_ping(storage)) {
+        zsys_error("sensor: failed to ping the new storage module, the running one is kept");
+        storage_module_deinitialize(storage);
+        goto error;
+    }
+
+    if (zsock_send(reload->reporting, "sp", "STORAGE", storage) || zsock_recv(reload->reporting, "p", &previous) == -1 || !previous) {
+        zsys_error("sensor: failed to swap the storage module");
+        storage_module_deinitialize(storage);
+        goto error;
+    }
+
+    storage_module_deinitialize(previous);
+    storage_module_destroy(previous);
+    *reload->storage = storage;
+    zsys_info("sensor: storage module replaced by '%s'", storage_types_name[config->storage.type]);
+    return;
+
+error:
+    storage_module_destroy(storage);
+    config->storage = running->storage;
+    config->sensor.name = running->sensor.name;
+}
+
+/*
+ * reload_monitors send the new monitoring config to the monitored targets whose settings have changed.
+ */
+static void
+reload_monitors(struct sensor_reload_context *reload, struct config *config, struct config *running)
+{
+    bool settings_changed = config->sensor.callchains_per_report != running->sensor.callchains_per_report || config->sensor.frequency != running->sensor.frequency;
+    bool containers_changed = settings_changed || config->sensor.activity_threshold != running->sensor.activity_threshold || config->sensor.idle_period != running->sensor.idle_period;
+    struct config_snapshot *running_system = NULL;
+    struct config_snapshot *system = NULL;
+    struct config_snapshot *containers = NULL;
+    zlistx_t *targets_key = NULL;
+    const char *target_key = NULL;
+    struct target *target = NULL;
+
+    /* the system target is started or stopped if its events have been added or removed */
+    if (zhashx_size(config->events.system) && config->sensor.shard_index == 0) {
+        system = config_snapshot_create(reload->hwinfo, config->events.system, config->sensor.frequency, config->sensor.read_period);
+        running_system = (zhashx_size(running->events.system)) ? config_snapshot_create(reload->hwinfo, running->events.system, running->sensor.frequency, running->sensor.read_period) : NULL;
+        if (system && !scheduler_is_attached(reload->scheduler, SYSTEM_TARGET_KEY))
+            scheduler_attach(reload->scheduler, SYSTEM_TARGET_KEY, perf_config_create(system, target_create(TARGET_TYPE_ALL, NULL, NULL, NULL), *reload->callchain_frequency, reload->queue, NULL, 0, 0, reload->budget, reload->opener, reload->burst));
+        else if (system && (settings_changed || !config_snapshot_equal(system, running_system)))
+            scheduler_reconfigure(reload->scheduler, SYSTEM_TARGET_KEY, perf_config_create(system, target_create(TARGET_TYPE_ALL, NULL, NULL, NULL), *reload->callchain_frequency, reload->queue, NULL, 0, 0, reload->budget, reload->opener, reload->burst));
+        config_snapshot_release(&running_system);
+        config_snapshot_release(&system);
+    }
+    else if (scheduler_is_attached(reload->scheduler, SYSTEM_TARGET_KEY)) {
+        scheduler_detach(reload->scheduler, SYSTEM_TARGET_KEY);
+    }
+
+    if (!reload->discovery)
+        return;
+
+    containers = config_snapshot_create(reload->hwinfo, config->events.containers, config->sensor.frequency, config->sensor.read_period);
+    if (!containers) {
+        zsys_error("sensor: failed to build the containers monitoring configuration, the running one is kept");
+        return;
+    }
+
+    if (!containers_changed && config_snapshot_equal(containers, atomic_load(reload->containers_snapshot))) {
+        config_snapshot_release(&containers);
+        return;
+    }
+
+    /* the new containers are started with the new snapshot, the running ones are reconfigured */
+    config_snapshot_swap(reload->containers_snapshot, containers);
+    targets_key = zhashx_keys(reload->scheduler->targets);
+    for (target_key = zlistx_first(targets_key); target_key; target_key = zlistx_next(targets_key)) {
+        target = zhashx_lookup(reload->discovery->targets, target_key);
+        if (!target)
+            continue;
+
+        scheduler_reconfigure(reload->scheduler, target_key, perf_config_create(containers, target_dup(target), *reload->callchain_frequency, reload->queue, reload->resolver, config->sensor.activity_threshold, config->sensor.idle_period, reload->budget, reload->opener, reload->burst));
+    }
+    zlistx_destroy(&targets_key);
+}
+
+/*
+ * keep_events_groups_period replace the period of the events groups by the one of the running group having the same name.
+ */
+static void
+keep_events_groups_period(zhashx_t *events_groups, zhashx_t *running_groups)
+{
+    struct events_group *group = NULL;
+    struct events_group *running_group = NULL;
+
+    for (group = zhashx_first(events_groups); group; group = zhashx_next(events_groups)) {
+        running_group = zhashx_lookup(running_groups, zhashx_cursor(events_groups));
+        group->period = (running_group) ? running_group->period : 0;
+    }
+}
+
+/*
+ * reload_config apply the changes of the config file to the running sensor, the unchanged counters are kept open.
+ */
+static void
+reload_config(struct sensor_reload_context *reload)
+{
+    struct config *running = *reload->config;
+    struct config *config = NULL;
+    bson_t *doc = NULL;
+    unsigned int tick_period;
+
+    if (!reload->config_file_path) {
+        zsys_warning("sensor: the configuration can only be reloaded when it is read from a config file");
+        return;
+    }
+
+    zsys_info("sensor: reloading the configuration from %s", reload->config_file_path);
+
+    config = config_create();
+    doc = bson_new();
+    if (!config || !doc || load_config_file(config, reload->config_file_path, doc) || config_validate(config)) {
+        zsys_error("sensor: the new configuration is invalid, the running one is kept");
+        config_destroy(config);
+        bson_destroy(doc);
+        return;
+    }
+
+    zlistx_add_end(reload->docs, doc);
+    keep_restart_only_settings(config, running, reload->discovery != NULL);
+    reload_storage_module(reload, config, running);
+
+    tick_period = compute_tick_period(config);
+    if (tick_period != compute_tick_period(running) && ticker_set_period(reload->ticker, tick_period)) {
+        zsys_error("sensor: failed to change the tick period, the running frequency and periods are kept");
+        config->sensor.frequency = running->sensor.frequency;
+        config->sensor.read_period = running->sensor.read_period;
+        keep_events_groups_period(config->events.system, running->events.system);
+        keep_events_groups_period(config->events.containers, running->events.containers);
+    }
+
+    *reload->callchain_frequency = config->sensor.callchains_per_report * config->sensor.frequency;
+    reload_monitors(reload, config, running);
+
+    *reload->config = config;
+    config_destroy(running);
+    zsys_info("sensor: configuration reloaded");
+}
+
+static void
+log_report_queue_stats(struct report_queue *queue, struct report_queue_stats *last_stats, unsigned int verbose)
+{
+    struct report_queue_stats stats = {0};
+
+    report_queue_get_stats(queue, &stats);
+
+    /* overload policy kicked in since the last tick: the storage does not keep up with the monitoring actors */
+    if (stats.dropped != last_stats->dropped || stats.coalesced != last_stats->coalesced) {
+        zsys_warning("report: queue is overloaded depth=%zu/%zu dropped=%" PRIu64 " (+%" PRIu64 ") coalesced=%" PRIu64 " (+%" PRIu64 ")",
+                stats.depth, stats.capacity,
+                stats.dropped, stats.dropped - last_stats->dropped,
+                stats.coalesced, stats.coalesced - last_stats->coalesced);
+    }
+    else if (verbose) {
+        zsys_info("report: queue depth=%zu/%zu dropped=%" PRIu64 " coalesced=%" PRIu64, stats.depth, stats.capacity, stats.dropped, stats.coalesced);
+    }
+
+    *last_stats = stats;
 }
 
 int
@@ -129,18 +655,38 @@ main(int argc, char **argv)
     struct pmu_info *pmu = NULL;
     struct hwinfo *hwinfo = NULL;
     struct storage_module *storage = NULL;
+    bool storage_initialized = false;
     struct report_config reporting_conf = {0};
+    struct report_queue *reporting_queue = NULL;
+    struct report_queue_stats reporting_queue_stats = {0};
     zactor_t *reporting = NULL;
+    struct suppression *suppression = NULL;
+    struct power_model *power_model = NULL;
+    struct ranking *ranking = NULL;
     zhashx_t *cgroups_running = NULL; /* char *cgroup_name -> char *cgroup_absolute_path */
-    zhashx_t *container_monitoring_actors = NULL; /* char *actor_name -> zactor_t *actor */
-    zsock_t *ticker = NULL;
-    struct target *system_target = NULL;
-    struct perf_config *system_monitor_config = NULL;
-    zactor_t *system_perf_monitor = NULL;
+    struct scheduler *scheduler = NULL;
+    struct ticker *ticker = NULL;
+    struct discovery *discovery = NULL;
+    struct target_resolver *resolver = NULL;
+    struct fd_budget *budget = NULL;
+    struct open_pool *opener = NULL;
+    struct burst *burst = NULL;
+    rlim_t nofile_limit;
+    uint64_t ticker_missed = 0;
+    size_t failed;
+    struct config_snapshot *_Atomic containers_snapshot = NULL;
     char *config_file_path = NULL;
-    bson_json_reader_t *reader = NULL;
-    bson_error_t error;
     bson_t doc = BSON_INITIALIZER;
+    zlistx_t *reloaded_docs = NULL; /* bson_t *doc */
+    struct sensor_reload_context reload = {0};
+    struct sigaction sighup_action = {0};
+    struct sigaction sigusr1_action = {0};
+    struct handover_state *handover = NULL;
+    int handover_fd = -1;
+    bool handover_requested = false;
+    bool handover_aborted = false;
+    bool tick_elapsed = false;
+    bool handed_over = false;
 
     if (!zsys_init()) {
         fprintf(stderr, "czmq: failed to initialize zsys context\n");
@@ -172,6 +718,12 @@ main(int argc, char **argv)
         goto cleanup;
     }
 
+    /* compile the patterns used to identify the targets */
+    if (target_classifier_initialize()) {
+        zsys_error("target: cannot initialize the target classifier");
+        goto cleanup;
+    }
+
     /* detect pmu topology */
     sys_pmu_topology = pmu_topology_create();
     if (!sys_pmu_topology) {
@@ -213,16 +765,7 @@ main(int argc, char **argv)
         goto cleanup;
     }
     if (config_file_path != NULL){
-        reader = bson_json_reader_new_from_file (config_file_path, &error);
-        if (!reader) {
-            zsys_error("config: Failed to open config file \"%s\": %s\n", config_file_path, error.message);
-            goto cleanup;
-        }
-        if (bson_json_reader_read (reader, &doc, &error) < 0) {
-            zsys_error("config: Error in json parsing:\n%s\n", error.message);
-            goto cleanup;
-        }
-        if (config_setup_from_file(config, &doc)) {
+        if (load_config_file(config, config_file_path, &doc)) {
             zsys_error("config: failed to parse the provided config file");
             goto cleanup;
         }
@@ -249,66 +792,299 @@ main(int argc, char **argv)
         zsys_error("sensor: failed to initialize storage module");
         goto cleanup;
     }
+    storage_initialized = true;
     if (storage_module_ping(storage)) {
         zsys_error("sensor: failed to ping storage module");
-	storage_module_deinitialize(storage);
         goto cleanup;
     }
 
     zsys_info("sensor: configuration is valid, starting monitoring...");
 
+    /* create the queue between the monitoring actors and the reporting actor */
+    reporting_queue = report_queue_create(config->report.queue_size, config->report.queue_policy);
+    if (!reporting_queue) {
+        zsys_error("sensor: failed to create reporting queue");
+        goto cleanup;
+    }
+    zsys_info("sensor: reporting queue size=%u policy=%s", config->report.queue_size, report_queue_policies_name[config->report.queue_policy]);
+
+    /* the idle reports are suppressed before being stored, and their values folded into the next stored report of their target */
+    if (config->report.suppress_idle) {
+        suppression = suppression_create(config->report.idle_threshold, config->report.heartbeat_period);
+        if (!suppression) {
+            zsys_error("sensor: failed to create the idle reports suppression stage");
+            goto cleanup;
+        }
+        zsys_info("sensor: idle reports suppressed (threshold=%u) with a heartbeat every %u ms", config->report.idle_threshold, config->report.heartbeat_period);
+    }
+
+    /* the power model is fitted on the reports of the system, and estimates the power of the other targets */
+    if (config->report.power_group) {
+        power_model = power_model_create(config->report.power_group, config->report.power_energy_event, config->report.power_window, config->report.power_refit_interval);
+        if (!power_model) {
+            zsys_error("sensor: failed to create the power model");
+            goto cleanup;
+        }
+        zsys_info("sensor: power model fitted on group %s against %s over %u reports", config->report.power_group, config->report.power_energy_event, config->report.power_window);
+    }
+
+    /* the top K targets are reported at full rate, and the long tail is sampled or aggregated */
+    if (config->report.top_k > 0) {
+        ranking = ranking_create(config->report.top_k, config->report.rank_event, config->report.rank_tail, config->report.tail_interval, config->report.rank_period);
+        if (!ranking) {
+            zsys_error("sensor: failed to create the ranking stage");
+            goto cleanup;
+        }
+        zsys_info("sensor: top %u targets by %s reported at full rate, tail %s every %u reports", config->report.top_k, config->report.rank_event, ranking_tails_name[config->report.rank_tail], config->report.tail_interval);
+    }
+
+    if (config->report.attribution)
+        zsys_info("sensor: values of the targets attributed to the functions of their %u callchains per report", config->sensor.callchains_per_report);
+
     /* start reporting actor */
     reporting_conf = (struct report_config){
-        .storage = storage
+        .storage = storage,
+        .queue = reporting_queue,
+        .suppression = suppression,
+        .output = config->storage.output,
+        .power_model = power_model,
+        .ranking = ranking,
+        .attribution = config->report.attribution
     };
     reporting = zactor_new(reporting_actor, &reporting_conf);
 
-    /* create ticker publisher socket */
-    ticker = zsock_new_pub("inproc://ticker");
 
     /* determine callchain frequency */
     unsigned int callchain_frequency = config->sensor.callchains_per_report * config->sensor.frequency;
 
-    /* start system monitoring actor only when needed */
-    if (zhashx_size(config->events.system)) {
-        system_target = target_create(TARGET_TYPE_ALL, NULL, NULL);
-        system_monitor_config = perf_config_create(hwinfo, config->events.system, system_target, callchain_frequency);
-        system_perf_monitor = zactor_new(perf_monitoring_actor, system_monitor_config);
+    /* the counters of the targets share the file descriptors left by the sensor */
+    nofile_limit = raise_nofile_limit();
+    if (nofile_limit == RLIM_INFINITY || nofile_limit > LONG_MAX)
+        nofile_limit = LONG_MAX;
+    budget = fd_budget_create((nofile_limit > FD_BUDGET_RESERVED) ? (long) nofile_limit - FD_BUDGET_RESERVED : 0);
+    if (!budget) {
+        zsys_error("sensor: failed to create the file descriptors budget");
+        goto cleanup;
+    }
+    zsys_info("sensor: %ld file descriptor(s) available for the perf events", budget->capacity);
+
+    /* the counters of the packages are opened in parallel, by the attaching worker and one persistent thread per other package */
+    opener = open_pool_create((zhashx_size(hwinfo->pkgs) > 1) ? zhashx_size(hwinfo->pkgs) - 1 : 0);
+    if (!opener) {
+        zsys_error("sensor: failed to start the counters opening threads");
+        goto cleanup;
+    }
+
+    /* the high resolution capture windows are started on SIGUSR1, or when the trigger event exceeds its threshold */
+    if (config->sensor.burst_period) {
+        burst = burst_create(config->sensor.burst_period, config->sensor.burst_duration, config->sensor.burst_callchain_frequency, config->sensor.burst_trigger_event, config->sensor.burst_trigger_threshold);
+        if (!burst) {
+            zsys_error("sensor: failed to create the capture windows settings");
+            goto cleanup;
+        }
+        zsys_info("sensor: capture windows of %u ms ticking every %u ms enabled", burst->duration, burst->period);
+    }
+
+    /* start the monitoring workers pool */
+    scheduler = scheduler_create(config->sensor.workers);
+    if (!scheduler) {
+        zsys_error("sensor: failed to start the monitoring workers");
+        goto cleanup;
+    }
+    zsys_info("sensor: monitoring targets using %u worker(s)", config->sensor.workers);
+    if (config->sensor.shard_count > 1)
+        zsys_info("sensor: monitoring shard %u of %u%s", config->sensor.shard_index, config->sensor.shard_count, (config->sensor.shard_index == 0) ? " (owner of the system target)" : "");
+
+    /* take over the counters of the sensor being upgraded, so the monitoring has no gap */
+    if (config->sensor.handover_socket) {
+        handover = handover_receive(config->sensor.handover_socket, &handover_aborted);
+        if (handover_aborted) {
+            zsys_error("sensor: the running sensor keeps monitoring the targets, exiting");
+            goto cleanup;
+        }
+    }
+
+    /* start system monitoring only when needed, the system target is owned by the first shard */
+    if (is_system_monitored(config) && attach_system_target(config, hwinfo, scheduler, callchain_frequency, reporting_queue, budget, opener, burst, handover))
+        goto cleanup;
+
+    /* watch the cgroup hierarchy only when containers have to be monitored */
+    if (zhashx_size(config->events.containers)) {
+        /* the configuration of the containers is built once, and shared by all their monitors */
+        atomic_store(&containers_snapshot, config_snapshot_create(hwinfo, config->events.containers, config->sensor.frequency, config->sensor.read_period));
+        if (!atomic_load(&containers_snapshot)) {
+            zsys_error("sensor: failed to build the containers monitoring configuration");
+            goto cleanup;
+        }
+
+        discovery = discovery_create(config->sensor.cgroup_basepath, TARGET_TYPE_EVERYTHING, config->sensor.aggregation, config->sensor.discovery_rescan_interval, config->sensor.shard_index, config->sensor.shard_count);
+        if (!discovery) {
+            zsys_error("sensor: failed to start the discovery of the running targets");
+            goto cleanup;
+        }
+
+        resolver = target_resolver_create();
+        if (!resolver) {
+            zsys_error("sensor: failed to start the resolver of the containers metadata");
+            goto cleanup;
+        }
+    }
+
+    /* create ticker publishing the clock ticks to the monitoring workers */
+    ticker = ticker_create("inproc://ticker", compute_tick_period(config));
+    if (!ticker) {
+        zsys_error("sensor: failed to create ticker");
+        goto cleanup;
+    }
+    if (config->sensor.read_period && config->sensor.read_period < config->sensor.frequency)
+        zsys_info("sensor: the counters are read every %u ms and reported at the period of their group, ticking every %" PRIu64 " ms", config->sensor.read_period, ticker->period_ns / 1000000);
+    else if (ticker->period_ns / 1000000 != config->sensor.frequency)
+        zsys_info("sensor: the events groups have their own period, ticking every %" PRIu64 " ms", ticker->period_ns / 1000000);
+
+    /* the configuration is reloaded from the config file on SIGHUP */
+    reloaded_docs = zlistx_new();
+    zlistx_set_destructor(reloaded_docs, (zlistx_destructor_fn *) bson_ptr_destroy);
+    reload = (struct sensor_reload_context){
+        .config_file_path = config_file_path,
+        .config = &config,
+        .docs = reloaded_docs,
+        .hwinfo = hwinfo,
+        .storage = &storage,
+        .reporting = reporting,
+        .queue = reporting_queue,
+        .scheduler = scheduler,
+        .discovery = discovery,
+        .resolver = resolver,
+        .budget = budget,
+        .opener = opener,
+        .burst = burst,
+        .ticker = ticker,
+        .containers_snapshot = &containers_snapshot,
+        .callchain_frequency = &callchain_frequency
+    };
+    sighup_action.sa_handler = handle_sighup;
+    sigemptyset(&sighup_action.sa_mask);
+    sigaction(SIGHUP, &sighup_action, NULL);
+
+    /* a capture window is started on SIGUSR1 */
+    sigusr1_action.sa_handler = handle_sigusr1;
+    sigemptyset(&sigusr1_action.sa_mask);
+    sigaction(SIGUSR1, &sigusr1_action, NULL);
+
+    /* the next sensor takes over the counters through the handover socket */
+    if (config->sensor.handover_socket) {
+        handover_fd = handover_listen(config->sensor.handover_socket);
+        if (handover_fd == -1) {
+            zsys_error("sensor: failed to create the handover socket");
+            goto cleanup;
+        }
     }
 
     /* monitor running containers */
-    container_monitoring_actors = zhashx_new();
-    zhashx_set_destructor(container_monitoring_actors, (zhashx_destructor_fn *) zactor_destroy);
     while (!zsys_interrupted) {
+        if (reload_requested) {
+            reload_requested = 0;
+            reload_config(&reload);
+        }
+
+        if (burst_requested) {
+            burst_requested = 0;
+            if (burst)
+                burst_request(burst);
+            else
+                zsys_warning("sensor: the capture windows are disabled, the request is ignored");
+        }
+
+        /* the window is extended if a capture is requested while one is running */
+        if (burst && burst_take_request(burst)) {
+            if (ticker_start_burst(ticker, burst->period, burst->duration))
+                zsys_error("sensor: failed to start the capture window");
+            else
+                zsys_info("sensor: capture window started for %u ms", burst->duration);
+        }
+
         /* monitor containers only when needed */
-        if (zhashx_size(config->events.containers)) {
-            sync_cgroups_running_monitored(hwinfo, config->events.containers, config->sensor.cgroup_basepath, container_monitoring_actors, callchain_frequency);
+        if (discovery) {
+            if (discovery_update(discovery))
+                zsys_error("sensor: error when retrieving the running targets.");
+
+            sync_cgroups_running_monitored(atomic_load(&containers_snapshot), config, discovery->targets, scheduler, callchain_frequency, reporting_queue, resolver, budget, opener, burst, handover);
         }
 
-        /* send clock tick to monitoring actors */
-        zsock_send(ticker, "s8", "CLOCK_TICK", zclock_time());
+        /* the containers whose monitoring failed are attached again at the next sync if they are still running, the system right away */
+        failed = scheduler_reap_failed(scheduler);
+        if (failed) {
+            zsys_warning("sensor: the monitoring of %zu target(s) failed, retrying", failed);
+            if (is_system_monitored(config) && !scheduler_is_attached(scheduler, SYSTEM_TARGET_KEY))
+                attach_system_target(config, hwinfo, scheduler, callchain_frequency, reporting_queue, budget, opener, burst, NULL);
+        }
 
-        zclock_sleep((int)config->sensor.frequency);
-    }
+        /* the handed over fds of the targets that are not running anymore are closed */
+        handover_state_destroy(&handover);
 
-    /* clean storage module ressources */
-    storage_module_deinitialize(storage);
+        /* the new cgroups are attached as soon as they are created, instead of waiting for the next deadline */
+        tick_elapsed = wait_tick_or_discovery(ticker, discovery, handover_fd, &handover_requested);
+
+        /* the new sensor reports the values counted since the last tick, so the current one exits without flushing */
+        if (handover_requested && handover_monitors(handover_fd, scheduler) == 0) {
+            handed_over = true;
+            break;
+        }
+
+        if (!tick_elapsed)
+            continue;
+
+        /* the time spent above does not stretch the period */
+        if (ticker_wait(ticker) == -1)
+            continue;
+
+        if (ticker->missed != ticker_missed) {
+            zsys_warning("sensor: main loop overran %" PRIu64 " tick deadline(s) (total=%" PRIu64 ")", ticker->missed - ticker_missed, ticker->missed);
+            ticker_missed = ticker->missed;
+        }
+
+        log_report_queue_stats(reporting_queue, &reporting_queue_stats, config->sensor.verbose);
+
+        /* send clock tick to monitoring workers */
+        ticker_publish(ticker);
+    }
 
     ret = 0;
 
 cleanup:
-    if(reader != NULL)
-      bson_json_reader_destroy(reader);
-    bson_destroy(&doc);
+    if (handover_fd != -1) {
+        close(handover_fd);
+        /* the socket path is owned by the new sensor once the monitoring has been handed over */
+        if (!handed_over)
+            unlink(config->sensor.handover_socket);
+    }
+    handover_state_destroy(&handover);
     zhashx_destroy(&cgroups_running);
-    zhashx_destroy(&container_monitoring_actors);
-    zactor_destroy(&system_perf_monitor);
+    scheduler_destroy(scheduler);
+    config_snapshot_swap(&containers_snapshot, NULL);
+    discovery_destroy(discovery);
+    target_resolver_destroy(resolver);
+    fd_budget_destroy(budget);
+    open_pool_destroy(opener);
+    burst_destroy(burst);
     zactor_destroy(&reporting);
+
+    /* the final reads of the monitors and the reports drained by the reporting actor are stored before the storage is closed */
+    if (storage_initialized)
+        storage_module_deinitialize(storage);
+
+    suppression_destroy(suppression);
+    power_model_destroy(power_model);
+    ranking_destroy(ranking);
+    report_queue_destroy(reporting_queue);
     storage_module_destroy(storage);
-    zsock_destroy(&ticker);
+    ticker_destroy(ticker);
     config_destroy(config);
+    zlistx_destroy(&reloaded_docs);
+    bson_destroy(&doc);
     pmu_topology_destroy(sys_pmu_topology);
     pmu_deinitialize();
+    target_classifier_deinitialize();
     hwinfo_destroy(hwinfo);
     zsys_shutdown();
     return ret;
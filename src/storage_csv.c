@@ -37,6 +37,7 @@
 #include "storage.h"
 #include "storage_csv.h"
 #include "config.h"
+#include "metric.h"
 
 static void
 group_fd_destroy(FILE **fd_ptr)
@@ -232,12 +233,181 @@ write_events_value(struct csv_context *ctx, const char *group, FILE *fd, uint64_
     return 0;
 }
 
+/*
+ * write_group_summaries write the summaries of the rates of the group into its summary file, which is opened on first use.
+ */
+static int
+write_group_summaries(struct csv_context *ctx, const char *file_key, uint64_t timestamp, const char *target, zhashx_t *summaries)
+{
+    char summary_key[NAME_MAX] = {0};
+    FILE *fd = NULL;
+    const struct payload_event_summary *summary = NULL;
+
+    if (snprintf(summary_key, NAME_MAX, "%s-summary", file_key) >= NAME_MAX)
+        return -1;
+
+    fd = zhashx_lookup(ctx->groups_fd, summary_key);
+    if (!fd) {
+        if (open_group_outfile(ctx, summary_key))
+            return -1;
+
+        fd = zhashx_lookup(ctx->groups_fd, summary_key);
+        if (fprintf(fd, "timestamp,sensor,target,event,reads,min,max,p50,p95,p99\n") < 0)
+            return -1;
+    }
+
+    for (summary = zhashx_first(summaries); summary; summary = zhashx_next(summaries)) {
+        if (fprintf(fd, "%" PRIu64 ",%s,%s,%s,%u,%f,%f,%f,%f,%f\n", timestamp, ctx->config.sensor_name, target, (const char *) zhashx_cursor(summaries),
+                    summary->reads, summary->min, summary->max, summary->p50, summary->p95, summary->p99) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * write_cpu_metrics write the derived metrics of a cpu into the metrics file of the group, which is opened on first use.
+ * The columns are the metrics of the plan, a metric that cannot be computed for the cpu is written as an empty field.
+ */
+static int
+write_cpu_metrics(struct csv_context *ctx, const char *file_key, const struct metric_plan *plan, uint64_t timestamp, const char *target, const char *socket, const char *cpu, zhashx_t *metrics)
+{
+    char metrics_key[NAME_MAX] = {0};
+    char buffer[CSV_LINE_BUFFER_SIZE] = {0};
+    int pos = 0;
+    FILE *fd = NULL;
+    const double *metric_value = NULL;
+    size_t i;
+
+    if (snprintf(metrics_key, NAME_MAX, "%s-metrics", file_key) >= NAME_MAX)
+        return -1;
+
+    fd = zhashx_lookup(ctx->groups_fd, metrics_key);
+    if (!fd) {
+        if (open_group_outfile(ctx, metrics_key))
+            return -1;
+
+        fd = zhashx_lookup(ctx->groups_fd, metrics_key);
+        pos = snprintf(buffer, CSV_LINE_BUFFER_SIZE, "timestamp,sensor,target,socket,cpu");
+        for (i = 0; i < plan->num_metrics; i++) {
+            pos += snprintf(buffer + pos, CSV_LINE_BUFFER_SIZE - pos, ",%s", plan->metrics[i].name);
+            if (pos >= CSV_LINE_BUFFER_SIZE)
+                return -1;
+        }
+
+        if (fprintf(fd, "%s\n", buffer) < 0)
+            return -1;
+    }
+
+    pos = snprintf(buffer, CSV_LINE_BUFFER_SIZE, "%" PRIu64 ",%s,%s,%s,%s", timestamp, ctx->config.sensor_name, target, socket, cpu);
+    for (i = 0; i < plan->num_metrics; i++) {
+        metric_value = zhashx_lookup(metrics, plan->metrics[i].name);
+        if (metric_value)
+            pos += snprintf(buffer + pos, CSV_LINE_BUFFER_SIZE - pos, ",%f", *metric_value);
+        else
+            pos += snprintf(buffer + pos, CSV_LINE_BUFFER_SIZE - pos, ",");
+
+        if (pos >= CSV_LINE_BUFFER_SIZE)
+            return -1;
+    }
+
+    if (fprintf(fd, "%s\n", buffer) < 0)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * write_heartbeat write the heartbeat of a target whose idle reports are suppressed into the heartbeat file, which is opened on first use.
+ */
+static int
+write_heartbeat(struct csv_context *ctx, struct payload *payload)
+{
+    FILE *fd = zhashx_lookup(ctx->groups_fd, "heartbeat");
+
+    if (!fd) {
+        if (open_group_outfile(ctx, "heartbeat"))
+            return -1;
+
+        fd = zhashx_lookup(ctx->groups_fd, "heartbeat");
+        if (fprintf(fd, "timestamp,sensor,target,suppressed\n") < 0)
+            return -1;
+    }
+
+    if (fprintf(fd, "%" PRIu64 ",%s,%s,%u\n", payload->timestamp, ctx->config.sensor_name, payload->target_name, payload->suppressed) < 0)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * write_power write the estimated power of a target into the power file, which is opened on first use.
+ */
+static int
+write_power(struct csv_context *ctx, struct payload *payload)
+{
+    FILE *fd = zhashx_lookup(ctx->groups_fd, "power");
+
+    if (!fd) {
+        if (open_group_outfile(ctx, "power"))
+            return -1;
+
+        fd = zhashx_lookup(ctx->groups_fd, "power");
+        if (fprintf(fd, "timestamp,sensor,target,power\n") < 0)
+            return -1;
+    }
+
+    if (fprintf(fd, "%" PRIu64 ",%s,%s,%f\n", payload->timestamp, ctx->config.sensor_name, payload->target_name, payload->power) < 0)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * write_functions write the values attributed to the sampled functions of a target into the functions file, which is opened on first use.
+ * Each value is written on its own line, the number of samples and the energy (in joules) are written as the samples and energy events.
+ */
+static int
+write_functions(struct csv_context *ctx, struct payload *payload)
+{
+    FILE *fd = zhashx_lookup(ctx->groups_fd, "functions");
+    struct payload_function_data *function_data = NULL;
+    const char *function_name = NULL;
+    double *event_value = NULL;
+
+    if (!fd) {
+        if (open_group_outfile(ctx, "functions"))
+            return -1;
+
+        fd = zhashx_lookup(ctx->groups_fd, "functions");
+        if (fprintf(fd, "timestamp,sensor,target,function,event,value\n") < 0)
+            return -1;
+    }
+
+    for (function_data = zhashx_first(payload->functions); function_data; function_data = zhashx_next(payload->functions)) {
+        function_name = zhashx_cursor(payload->functions);
+        if (fprintf(fd, "%" PRIu64 ",%s,%s,%s,samples,%u\n", payload->timestamp, ctx->config.sensor_name, payload->target_name, function_name, function_data->samples) < 0)
+            return -1;
+
+        if (function_data->energy >= 0.0 && fprintf(fd, "%" PRIu64 ",%s,%s,%s,energy,%f\n", payload->timestamp, ctx->config.sensor_name, payload->target_name, function_name, function_data->energy) < 0)
+            return -1;
+
+        for (event_value = zhashx_first(function_data->events); event_value; event_value = zhashx_next(function_data->events)) {
+            if (fprintf(fd, "%" PRIu64 ",%s,%s,%s,%s,%f\n", payload->timestamp, ctx->config.sensor_name, payload->target_name, function_name, (const char *) zhashx_cursor(function_data->events), *event_value) < 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
 static int
 csv_store_report(struct storage_module *module, struct payload *payload)
 {
     struct csv_context *ctx = module->context;
     struct payload_group_data *group_data = NULL;
     const char *group_name = NULL;
+    char file_key[NAME_MAX] = {0};
     FILE *group_fd = NULL;
     bool write_header = false;
     struct payload_pkg_data *pkg_data = NULL;
@@ -249,37 +419,87 @@ csv_store_report(struct storage_module *module, struct payload *payload)
      * write report into csv file as following: 
      * timestamp,sensor,target,socket,cpu,INSTRUCTIONS_RETIRED,LLC_MISSES
      * 1538327257673,grvingt-64,system,0,56,5996,108
+     * The values read during a high resolution capture window are written apart, in the <group>-burst.csv file.
+     * The summaries of the rates (per second) of the groups read at a faster rate are written in the <group>-summary.csv file:
+     * timestamp,sensor,target,event,reads,min,max,p50,p95,p99
+     * The derived metrics of the groups are written in the <group>-metrics.csv file, with one column per metric:
+     * timestamp,sensor,target,socket,cpu,ipc
+     * The heartbeats of the targets whose idle reports are suppressed are written in the heartbeat.csv file:
+     * timestamp,sensor,target,suppressed
+     * The estimated power (in watts) of the targets is written in the power.csv file:
+     * timestamp,sensor,target,power
+     * The values attributed to the sampled functions of the targets are written in the functions.csv file:
+     * timestamp,sensor,target,function,event,value
      */
+    if (payload->heartbeat) {
+        if (write_heartbeat(ctx, payload)) {
+            zsys_error("csv: failed to write the heartbeat of target=%s timestamp=%" PRIu64, payload->target_name, payload->timestamp);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (payload->power >= 0.0 && write_power(ctx, payload)) {
+        zsys_error("csv: failed to write the power of target=%s timestamp=%" PRIu64, payload->target_name, payload->timestamp);
+        return -1;
+    }
+
+    if (payload->functions && write_functions(ctx, payload)) {
+        zsys_error("csv: failed to write the functions of target=%s timestamp=%" PRIu64, payload->target_name, payload->timestamp);
+        return -1;
+    }
+
     for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
         group_name = zhashx_cursor(payload->groups);
-        group_fd = zhashx_lookup(ctx->groups_fd, group_name);
-        if (!group_fd) {
-            if (open_group_outfile(ctx, group_name))
-                return -1;
-
-            group_fd = zhashx_lookup(ctx->groups_fd, group_name);
-            write_header = true;
+        if (snprintf(file_key, NAME_MAX, (payload->burst) ? "%s-burst" : "%s", group_name) >= NAME_MAX) {
+            zsys_error("csv: the name of the output file of group %s is too long", group_name);
+            return -1;
         }
 
+        group_fd = zhashx_lookup(ctx->groups_fd, file_key);
+
         for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
             pkg_id = zhashx_cursor(group_data->pkgs);
 
             for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
                 cpu_id = zhashx_cursor(pkg_data->cpus);
 
+                if (cpu_data->metrics && group_data->plan && write_cpu_metrics(ctx, file_key, group_data->plan, payload->timestamp, payload->target_name, pkg_id, cpu_id, cpu_data->metrics)) {
+                    zsys_error("csv: failed to write the metrics to file for group=%s timestamp=%" PRIu64, group_name, payload->timestamp);
+                    return -1;
+                }
+
+                /* the raw values of the groups having metrics are dropped when only the metrics are emitted */
+                if (!zhashx_size(cpu_data->events))
+                    continue;
+
+                if (!group_fd) {
+                    if (open_group_outfile(ctx, file_key))
+                        return -1;
+
+                    group_fd = zhashx_lookup(ctx->groups_fd, file_key);
+                    write_header = true;
+                }
+
                 if (write_header) {
-                    if (write_group_header(ctx, group_name, group_fd, cpu_data->events)) {
+                    if (write_group_header(ctx, file_key, group_fd, cpu_data->events)) {
                         zsys_error("csv: failed to write header to file for group=%s", group_name);
                         return -1;
                     }
                     write_header = false;
                 }
-                if (write_events_value(ctx, group_name, group_fd, payload->timestamp, payload->target_name, pkg_id, cpu_id, cpu_data->events)) {
+                if (write_events_value(ctx, file_key, group_fd, payload->timestamp, payload->target_name, pkg_id, cpu_id, cpu_data->events)) {
                     zsys_error("csv: failed to write report to file for group=%s timestamp=%" PRIu64, group_name, payload->timestamp);
                     return -1;
                 }
             }
         }
+
+        if (group_data->summaries && zhashx_size(group_data->summaries) && write_group_summaries(ctx, file_key, payload->timestamp, payload->target_name, group_data->summaries)) {
+            zsys_error("csv: failed to write the summaries to file for group=%s timestamp=%" PRIu64, group_name, payload->timestamp);
+            return -1;
+        }
     }
 
     return 0;
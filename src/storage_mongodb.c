@@ -115,11 +115,82 @@ mongodb_ping(struct storage_module *module)
     return ret;
 }
 
+/*
+ * append_functions append the values attributed to the functions of the sampled callchains of the target.
+ */
+static void
+append_functions(bson_t *document, struct payload *payload)
+{
+    bson_t doc_functions;
+    struct payload_function_data *function_data = NULL;
+    bson_t doc_function;
+    double *event_value = NULL;
+
+    if (!payload->functions)
+        return;
+
+    BSON_APPEND_DOCUMENT_BEGIN(document, "functions", &doc_functions);
+    for (function_data = zhashx_first(payload->functions); function_data; function_data = zhashx_next(payload->functions)) {
+        BSON_APPEND_DOCUMENT_BEGIN(&doc_functions, zhashx_cursor(payload->functions), &doc_function);
+        BSON_APPEND_INT32(&doc_function, "samples", (int32_t) function_data->samples);
+        if (function_data->energy >= 0.0)
+            BSON_APPEND_DOUBLE(&doc_function, "energy", function_data->energy);
+
+        for (event_value = zhashx_first(function_data->events); event_value; event_value = zhashx_next(function_data->events)) {
+            BSON_APPEND_DOUBLE(&doc_function, zhashx_cursor(function_data->events), *event_value);
+        }
+        bson_append_document_end(&doc_functions, &doc_function);
+    }
+    bson_append_document_end(document, &doc_functions);
+}
+
+/*
+ * append_summaries append the summaries of the rates of the groups read at a faster rate than they are reported.
+ */
+static void
+append_summaries(bson_t *document, struct payload *payload)
+{
+    bson_t doc_summaries;
+    struct payload_group_data *group_data = NULL;
+    bson_t doc_group;
+    struct payload_event_summary *summary = NULL;
+    bson_t doc_event;
+    bool has_summaries = false;
+
+    for (group_data = zhashx_first(payload->groups); group_data && !has_summaries; group_data = zhashx_next(payload->groups))
+        has_summaries = (group_data->summaries && zhashx_size(group_data->summaries));
+
+    if (!has_summaries)
+        return;
+
+    BSON_APPEND_DOCUMENT_BEGIN(document, "summaries", &doc_summaries);
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        if (!group_data->summaries || !zhashx_size(group_data->summaries))
+            continue;
+
+        BSON_APPEND_DOCUMENT_BEGIN(&doc_summaries, zhashx_cursor(payload->groups), &doc_group);
+        for (summary = zhashx_first(group_data->summaries); summary; summary = zhashx_next(group_data->summaries)) {
+            BSON_APPEND_DOCUMENT_BEGIN(&doc_group, zhashx_cursor(group_data->summaries), &doc_event);
+            BSON_APPEND_INT32(&doc_event, "reads", (int32_t) summary->reads);
+            BSON_APPEND_DOUBLE(&doc_event, "min", summary->min);
+            BSON_APPEND_DOUBLE(&doc_event, "max", summary->max);
+            BSON_APPEND_DOUBLE(&doc_event, "p50", summary->p50);
+            BSON_APPEND_DOUBLE(&doc_event, "p95", summary->p95);
+            BSON_APPEND_DOUBLE(&doc_event, "p99", summary->p99);
+            bson_append_document_end(&doc_group, &doc_event);
+        }
+        bson_append_document_end(&doc_summaries, &doc_group);
+    }
+    bson_append_document_end(document, &doc_summaries);
+}
+
 static int
 mongodb_store_report(struct storage_module *module, struct payload *payload)
 {
     struct mongodb_context *ctx = module->context;
     bson_t document = BSON_INITIALIZER;
+    bson_t doc_labels;
+    const char *label_value = NULL;
     bson_t doc_groups;
     struct payload_group_data *group_data = NULL;
     const char *group_name = NULL;
@@ -132,6 +203,7 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
     bson_t doc_cpu;
     const char *event_name = NULL;
     uint64_t *event_value = NULL;
+    double *metric_value = NULL;
     bson_error_t error;
     int ret = 0;
 
@@ -141,6 +213,15 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
      *    "timestamp": 1529868713854,
      *    "sensor": "test.cluster.lan",
      *    "target": "example",
+     *    "interval": 1000, (only if the values cover exactly one period of the groups)
+     *    "burst": true, (only if the values have been read during a high resolution capture window)
+     *    "heartbeat": true, (only if the report has no values, and summarizes the suppressed idle reports of the target)
+     *    "suppressed": 12, (only if idle reports of the target have been suppressed, their values are folded into this report)
+     *    "power": 12.3, (only if the power model is enabled, estimated dynamic power of the target in watts)
+     *    "labels": {
+     *      "label_name": "label_value",
+     *      more labels... (only if the target have labels)
+     *    },
      *    "groups": {
      *      "group_name": {
      *          "pkg_id": {
@@ -149,12 +230,37 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
      *                  "time_running": 12345,
      *                  "event_name": 123456789.0,
      *                  more events...
+     *                  "metric_name": 1.23,
+     *                  more metrics... (only if the group has derived metrics, its events are then omitted if only the metrics are emitted)
      *              },
      *              more cpus...
      *          },
      *          more pkgs...
      *      },
      *      more groups...
+     *   },
+     *   "summaries": { (only if groups are read at a faster rate than they are reported)
+     *      "group_name": {
+     *          "event_name": {
+     *              "reads": 100,
+     *              "min": 1234.5,
+     *              "max": 123456.7,
+     *              "p50": 12345.6,
+     *              "p95": 98765.4,
+     *              "p99": 123456.7
+     *          },
+     *          more events...
+     *      },
+     *      more groups...
+     *   },
+     *   "functions": { (only if the samples are attributed, and callchains have been sampled for the target)
+     *      "function_name": {
+     *          "samples": 12,
+     *          "energy": 1.23, (only if the energy of the target is known, in joules)
+     *          "event_name": 1234.5,
+     *          more events...
+     *      },
+     *      more functions...
      *   }
      * }
      */
@@ -162,6 +268,29 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
     BSON_APPEND_UTF8(&document, "sensor", ctx->config.sensor_name);
     BSON_APPEND_UTF8(&document, "target", payload->target_name);
 
+    if (payload->interval)
+        BSON_APPEND_INT32(&document, "interval", (int32_t) payload->interval);
+
+    if (payload->burst)
+        BSON_APPEND_BOOL(&document, "burst", true);
+
+    if (payload->heartbeat)
+        BSON_APPEND_BOOL(&document, "heartbeat", true);
+
+    if (payload->suppressed)
+        BSON_APPEND_INT32(&document, "suppressed", (int32_t) payload->suppressed);
+
+    if (payload->power >= 0.0)
+        BSON_APPEND_DOUBLE(&document, "power", payload->power);
+
+    if (payload->labels) {
+        BSON_APPEND_DOCUMENT_BEGIN(&document, "labels", &doc_labels);
+        for (label_value = zhashx_first(payload->labels); label_value; label_value = zhashx_next(payload->labels)) {
+            BSON_APPEND_UTF8(&doc_labels, zhashx_cursor(payload->labels), label_value);
+        }
+        bson_append_document_end(&document, &doc_labels);
+    }
+
     BSON_APPEND_DOCUMENT_BEGIN(&document, "groups", &doc_groups);
     for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
         group_name = zhashx_cursor(payload->groups);
@@ -185,6 +314,13 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
 		    
 		}
 
+                /* the derived metrics are reported next to the events */
+                if (cpu_data->metrics) {
+                    for (metric_value = zhashx_first(cpu_data->metrics); metric_value; metric_value = zhashx_next(cpu_data->metrics)) {
+                        BSON_APPEND_DOUBLE(&doc_cpu, zhashx_cursor(cpu_data->metrics), *metric_value);
+                    }
+                }
+
                 bson_append_document_end(&doc_pkg, &doc_cpu);
             }
 
@@ -195,6 +331,12 @@ mongodb_store_report(struct storage_module *module, struct payload *payload)
     }
     bson_append_document_end(&document, &doc_groups);
 
+    /* the rates are in events per second */
+    append_summaries(&document, payload);
+
+    /* the values are split across the sampled callchains in proportion to their sample counts */
+    append_functions(&document, payload);
+
     /* insert document into collection */
     if (!mongoc_collection_insert_one(ctx->collection, &document, NULL, NULL, &error)) {
         zsys_error("mongodb: failed insert timestamp=%lu target=%s: %s", payload->timestamp, payload->target_name, error.message);
@@ -0,0 +1,304 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "suppression.h"
+#include "util.h"
+
+static void
+suppression_target_destroy(struct suppression_target **target_ptr)
+{
+    if (!*target_ptr)
+        return;
+
+    payload_destroy((*target_ptr)->pending);
+    free(*target_ptr);
+    *target_ptr = NULL;
+}
+
+struct suppression *
+suppression_create(uint64_t threshold, unsigned int heartbeat_period)
+{
+    struct suppression *suppression = malloc(sizeof(struct suppression));
+
+    if (!suppression)
+        return NULL;
+
+    suppression->threshold = threshold;
+    suppression->heartbeat_period = heartbeat_period;
+    suppression->next_heartbeat = (uint64_t) zclock_mono() + heartbeat_period;
+    suppression->targets = zhashx_new();
+    if (!suppression->targets) {
+        free(suppression);
+        return NULL;
+    }
+
+    zhashx_set_destructor(suppression->targets, (zhashx_destructor_fn *) suppression_target_destroy);
+    return suppression;
+}
+
+/*
+ * has_samples returns true if callchains have been sampled on the cpu.
+ */
+static bool
+has_samples(struct payload_cpu_data *cpu_data)
+{
+    const char *callchain = zhashx_lookup(cpu_data->events, "callchain");
+
+    return callchain && *callchain;
+}
+
+/*
+ * is_idle_payload returns true if the sum of the values of each event over the cpus is not greater than the threshold.
+ */
+static bool
+is_idle_payload(struct suppression *suppression, struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    struct payload_cpu_data *cpu_data = NULL;
+    const uint64_t *value = NULL;
+    zhashx_t *sums = NULL; /* char *event_name -> uint64_t *sum */
+    uint64_t *sum = NULL;
+    bool idle = false;
+
+    sums = zhashx_new();
+    if (!sums)
+        return false;
+
+    zhashx_set_duplicator(sums, (zhashx_duplicator_fn *) uint64ptrdup);
+    zhashx_set_destructor(sums, (zhashx_destructor_fn *) ptrfree);
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        for (pkg_data = zhashx_first(group_data->pkgs); pkg_data; pkg_data = zhashx_next(group_data->pkgs)) {
+            for (cpu_data = zhashx_first(pkg_data->cpus); cpu_data; cpu_data = zhashx_next(pkg_data->cpus)) {
+                if (has_samples(cpu_data))
+                    goto out;
+
+                for (value = zhashx_first(cpu_data->events); value; value = zhashx_next(cpu_data->events)) {
+                    if (!payload_is_counter_value(zhashx_cursor(cpu_data->events)))
+                        continue;
+
+                    sum = zhashx_lookup(sums, zhashx_cursor(cpu_data->events));
+                    if (sum)
+                        *sum += *value;
+                    else
+                        zhashx_insert(sums, zhashx_cursor(cpu_data->events), (void *) value);
+                }
+            }
+        }
+
+        /* the events of the different groups can have the same name */
+        for (sum = zhashx_first(sums); sum; sum = zhashx_next(sums)) {
+            if (*sum > suppression->threshold)
+                goto out;
+        }
+        zhashx_purge(sums);
+    }
+
+    idle = true;
+
+out:
+    zhashx_destroy(&sums);
+    return idle;
+}
+
+/*
+ * is_zero_cpu returns true if the cpu has only zero values and no sample.
+ */
+static bool
+is_zero_cpu(struct payload_cpu_data *cpu_data)
+{
+    const uint64_t *value = NULL;
+
+    if (has_samples(cpu_data))
+        return false;
+
+    for (value = zhashx_first(cpu_data->events); value; value = zhashx_next(cpu_data->events)) {
+        if (payload_is_counter_value(zhashx_cursor(cpu_data->events)) && *value != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * drop_zero_cpus remove the cpus having only zero values from the payload, and the packages left without cpu.
+ */
+static void
+drop_zero_cpus(struct payload *payload)
+{
+    struct payload_group_data *group_data = NULL;
+    struct payload_pkg_data *pkg_data = NULL;
+    zlistx_t *pkgs_id = NULL;
+    const char *pkg_id = NULL;
+    zlistx_t *cpus_id = NULL;
+    const char *cpu_id = NULL;
+
+    for (group_data = zhashx_first(payload->groups); group_data; group_data = zhashx_next(payload->groups)) {
+        pkgs_id = zhashx_keys(group_data->pkgs);
+        for (pkg_id = zlistx_first(pkgs_id); pkg_id; pkg_id = zlistx_next(pkgs_id)) {
+            pkg_data = zhashx_lookup(group_data->pkgs, pkg_id);
+            cpus_id = zhashx_keys(pkg_data->cpus);
+            for (cpu_id = zlistx_first(cpus_id); cpu_id; cpu_id = zlistx_next(cpus_id)) {
+                if (is_zero_cpu(zhashx_lookup(pkg_data->cpus, cpu_id)))
+                    zhashx_delete(pkg_data->cpus, cpu_id);
+            }
+            zlistx_destroy(&cpus_id);
+
+            if (!zhashx_size(pkg_data->cpus))
+                zhashx_delete(group_data->pkgs, pkg_id);
+        }
+        zlistx_destroy(&pkgs_id);
+    }
+}
+
+struct payload *
+suppression_filter(struct suppression *suppression, struct payload *payload)
+{
+    struct suppression_target *target = zhashx_lookup(suppression->targets, payload->target_name);
+
+    if (!target) {
+        target = calloc(1, sizeof(struct suppression_target));
+        if (!target)
+            return payload;
+
+        zhashx_insert(suppression->targets, payload->target_name, target);
+    }
+
+    target->last_seen = (uint64_t) zclock_mono();
+
+    /* the payloads of a capture window are always stored */
+    if (!payload->burst && is_idle_payload(suppression, payload)) {
+        if (target->pending && payload_merge(payload, target->pending)) {
+            zsys_error("suppression: failed to fold the idle report of target=%s timestamp=%" PRIu64 ", it is stored", payload->target_name, payload->timestamp);
+            return payload;
+        }
+
+        payload_destroy(target->pending);
+        target->pending = payload;
+        target->count++;
+        return NULL;
+    }
+
+    /* the suppressed values are folded into the first stored report, so the integrals of the values are kept */
+    if (target->pending) {
+        if (payload_merge(payload, target->pending))
+            zsys_error("suppression: failed to fold the suppressed reports of target=%s into timestamp=%" PRIu64, payload->target_name, payload->timestamp);
+        else
+            payload->suppressed += target->count;
+
+        payload_destroy(target->pending);
+        target->pending = NULL;
+        target->count = 0;
+    }
+
+    drop_zero_cpus(payload);
+    return payload;
+}
+
+int
+suppression_get_timeout(struct suppression *suppression)
+{
+    int64_t now = zclock_mono();
+
+    return ((uint64_t) now >= suppression->next_heartbeat) ? 0 : (int) (suppression->next_heartbeat - (uint64_t) now);
+}
+
+static struct payload *
+create_heartbeat_payload(struct suppression_target *target)
+{
+    struct payload *heartbeat = payload_create((uint64_t) zclock_time(), target->pending->target_name);
+
+    if (!heartbeat)
+        return NULL;
+
+    if (target->pending->labels)
+        heartbeat->labels = zhashx_dup(target->pending->labels);
+
+    heartbeat->heartbeat = true;
+    heartbeat->suppressed = target->count;
+    return heartbeat;
+}
+
+void
+suppression_heartbeat(struct suppression *suppression, zlistx_t *payloads)
+{
+    uint64_t now = (uint64_t) zclock_mono();
+    uint64_t last_heartbeat = suppression->next_heartbeat - suppression->heartbeat_period;
+    zlistx_t *targets_name = NULL;
+    const char *target_name = NULL;
+    struct suppression_target *target = NULL;
+    struct payload *heartbeat = NULL;
+
+    if (now < suppression->next_heartbeat)
+        return;
+
+    suppression->next_heartbeat = now + suppression->heartbeat_period;
+
+    targets_name = zhashx_keys(suppression->targets);
+    for (target_name = zlistx_first(targets_name); target_name; target_name = zlistx_next(targets_name)) {
+        target = zhashx_lookup(suppression->targets, target_name);
+
+        /* a target that stopped reporting is not monitored anymore, its suppressed values are stored as its last report */
+        if (target->last_seen < last_heartbeat) {
+            if (target->pending) {
+                target->pending->suppressed = target->count - 1;
+                zlistx_add_end(payloads, target->pending);
+                target->pending = NULL;
+            }
+
+            zhashx_delete(suppression->targets, target_name);
+            continue;
+        }
+
+        if (!target->pending)
+            continue;
+
+        heartbeat = create_heartbeat_payload(target);
+        if (heartbeat)
+            zlistx_add_end(payloads, heartbeat);
+    }
+    zlistx_destroy(&targets_name);
+}
+
+void
+suppression_destroy(struct suppression *suppression)
+{
+    if (!suppression)
+        return;
+
+    zhashx_destroy(&suppression->targets);
+    free(suppression);
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SUPPRESSION_H
+#define SUPPRESSION_H
+
+#include <czmq.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/*
+ * suppression_target stores the values of the suppressed reports of a target.
+ */
+struct suppression_target
+{
+    struct payload *pending; /* values of the suppressed reports, folded into the next stored report of the target */
+    unsigned int count; /* number of suppressed reports */
+    uint64_t last_seen; /* monotonic timestamp (in milliseconds) of the last report of the target */
+};
+
+/*
+ * suppression stores the state of the idle reports suppression stage of the reporting actor.
+ */
+struct suppression
+{
+    uint64_t threshold; /* a report is idle if the value of each of its events is lower or equal */
+    unsigned int heartbeat_period; /* in milliseconds */
+    uint64_t next_heartbeat; /* monotonic timestamp (in milliseconds) */
+    zhashx_t *targets; /* char *target_name -> struct suppression_target *target */
+};
+
+/*
+ * suppression_create allocate the resources of the suppression stage.
+ */
+struct suppression *suppression_create(uint64_t threshold, unsigned int heartbeat_period);
+
+/*
+ * suppression_filter returns the payload to store, or NULL if it has been suppressed, and takes the ownership of the given payload.
+ * The values of the suppressed reports of the target are folded into the returned payload, and its zero valued cpus are dropped.
+ */
+struct payload *suppression_filter(struct suppression *suppression, struct payload *payload);
+
+/*
+ * suppression_get_timeout returns the time (in milliseconds) until the next heartbeat.
+ */
+int suppression_get_timeout(struct suppression *suppression);
+
+/*
+ * suppression_heartbeat add to the list the heartbeat payloads of the suppressed targets, if the heartbeat period elapsed.
+ * The suppressed values of the targets that did not report since the previous heartbeat are added to the list, and forgotten.
+ */
+void suppression_heartbeat(struct suppression *suppression, zlistx_t *payloads);
+
+/*
+ * suppression_destroy free the resources of the suppression stage, the suppressed values are lost.
+ */
+void suppression_destroy(struct suppression *suppression);
+
+#endif /* SUPPRESSION_H */
@@ -30,16 +30,19 @@
  */
 
 #include <czmq.h>
-#include <fts.h>
-#include <regex.h>
+#include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
+#include <unistd.h>
 
+#include "cpuset.h"
 #include "target.h"
+#include "target_containerd.h"
+#include "target_crio.h"
 #include "target_docker.h"
 #include "target_kubernetes.h"
+#include "target_metadata.h"
 
 const char *target_types_name[] = {
     [TARGET_TYPE_UNKNOWN] = "unknown",
@@ -50,60 +53,12 @@ const char *target_types_name[] = {
     [TARGET_TYPE_KUBERNETES] = "k8s",
     [TARGET_TYPE_LIBVIRT] = "libvirt",
     [TARGET_TYPE_LXC] = "lxc",
+    [TARGET_TYPE_CONTAINERD] = "containerd",
+    [TARGET_TYPE_CRIO] = "crio",
 };
 
-enum target_type
-target_detect_type(const char *cgroup_path)
-{
-    /* All running processes/threads (not a cgroup) */
-    if (!cgroup_path)
-        return TARGET_TYPE_ALL;
-
-    /* System (running processes/threads in system cgroup) */
-    if (strstr(cgroup_path, "perf_event/system"))
-        return TARGET_TYPE_SYSTEM;
-
-    /* Kernel (running processes/threads in kernel cgroup) */
-    if (strstr(cgroup_path, "perf_event/kernel"))
-        return TARGET_TYPE_KERNEL;
-
-    /* Docker (running containers) */
-    if (strstr(cgroup_path, "perf_event/docker"))
-        return TARGET_TYPE_DOCKER;
-
-    /* Kubernetes (running containers) */
-    if (strstr(cgroup_path, "perf_event/kubepods"))
-        return TARGET_TYPE_KUBERNETES;
-
-    /* LibVirt (running virtual machine) */
-    if (strstr(cgroup_path, "perf_event/machine.slice"))
-        return TARGET_TYPE_LIBVIRT;
-
-    /* LXC (running containers) */
-    if (strstr(cgroup_path, "perf_event/lxc"))
-	return TARGET_TYPE_LXC;
-
-    return TARGET_TYPE_UNKNOWN;
-}
-
-int
-target_validate_type(enum target_type type, const char *cgroup_path)
-{
-    switch (type) {
-        case TARGET_TYPE_DOCKER:
-            return target_docker_validate(cgroup_path);
-
-        case TARGET_TYPE_KUBERNETES:
-            return target_kubernetes_validate(cgroup_path);
-
-        default:
-            /* other types does not need a validation */
-            return true;
-    }
-}
-
 struct target *
-target_create(enum target_type type, const char *cgroup_basedir, const char *cgroup_path)
+target_create(enum target_type type, const char *cgroup_basedir, const char *cgroup_path, const char *container_id)
 {
     struct target *target = malloc(sizeof(struct target));
 
@@ -112,25 +67,27 @@ target_create(enum target_type type, const char *cgroup_basedir, const char *cgr
 
     target->cgroup_basedir = cgroup_basedir;
     target->cgroup_path = (cgroup_path) ? strdup(cgroup_path) : NULL;
+    target->container_id = (container_id && *container_id) ? strdup(container_id) : NULL;
     target->type = type;
 
     return target;
 }
 
+struct target *
+target_dup(struct target *target)
+{
+    if (!target)
+        return NULL;
+
+    return target_create(target->type, target->cgroup_basedir, target->cgroup_path, target->container_id);
+}
+
 char *
 target_resolve_real_name(struct target *target)
 {
     char *target_real_name = NULL;
 
     switch (target->type) {
-        case TARGET_TYPE_DOCKER:
-            target_real_name = target_docker_resolve_name(target);
-            break;
-
-        case TARGET_TYPE_KUBERNETES:
-            target_real_name = target_kubernetes_resolve_name(target);
-            break;
-
         case TARGET_TYPE_ALL:
         case TARGET_TYPE_KERNEL:
         case TARGET_TYPE_SYSTEM:
@@ -150,45 +107,116 @@ target_resolve_real_name(struct target *target)
     return target_real_name;
 }
 
-void
-target_destroy(struct target *target)
+struct target_metadata *
+target_resolve_metadata(struct target *target)
 {
-    if (!target)
-        return;
+    if (!target->container_id)
+        return NULL;
 
-    free(target->cgroup_path);
-    free(target);
+    switch (target->type) {
+        case TARGET_TYPE_DOCKER:
+            return target_docker_resolve_metadata(target->container_id);
+
+        case TARGET_TYPE_KUBERNETES:
+            return target_kubernetes_resolve_metadata(target->container_id);
+
+        case TARGET_TYPE_CONTAINERD:
+            return target_containerd_resolve_metadata(target->container_id);
+
+        case TARGET_TYPE_CRIO:
+            return target_crio_resolve_metadata(target->container_id);
+
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * build_controller_file_path build the path to a controller interface file of the target.
+ * On the unified hierarchy (v2) the file is in the cgroup directory, on v1 it is in the same cgroup of the controller hierarchy.
+ */
+static int
+build_controller_file_path(struct target *target, const char *v2_filename, const char *v1_controller, const char *v1_filename, char *path, size_t path_size)
+{
+    char basedir[PATH_MAX] = {0};
+
+    snprintf(path, path_size, "%s/%s", target->cgroup_path, v2_filename);
+    if (access(path, R_OK) == 0)
+        return 0;
+
+    if (!target->cgroup_basedir || strncmp(target->cgroup_path, target->cgroup_basedir, strlen(target->cgroup_basedir)) != 0)
+        return -1;
+
+    snprintf(basedir, PATH_MAX, "%s", target->cgroup_basedir);
+    snprintf(path, path_size, "%s/%s%s/%s", dirname(basedir), v1_controller, target->cgroup_path + strlen(target->cgroup_basedir), v1_filename);
+    return 0;
+}
+
+int
+target_read_effective_cpus(struct target *target, struct cpuset *cpus)
+{
+    char path[PATH_MAX] = {0};
+    FILE *f = NULL;
+    char *cpu_list = NULL;
+    size_t cpu_list_len = 0;
+    int ret = -1;
+
+    if (!target->cgroup_path || build_controller_file_path(target, "cpuset.cpus.effective", "cpuset", "cpuset.effective_cpus", path, PATH_MAX))
+        return -1;
+
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    if (getline(&cpu_list, &cpu_list_len, f) != -1 && !cpuset_parse(cpu_list, cpus) && cpuset_count(cpus) > 0)
+        ret = 0;
+
+    free(cpu_list);
+    fclose(f);
+    return ret;
 }
 
 int
-target_discover_running(const char *base_path, enum target_type type_mask, zhashx_t *targets)
+target_read_cpu_usage(struct target *target, uint64_t *usage)
 {
-    const char *path[] = { base_path, NULL };
-    FTS *file_system = NULL;
-    FTSENT *node = NULL;
-    enum target_type type;
-    struct target *target = NULL;
-
-    file_system = fts_open((char * const *)path, FTS_LOGICAL | FTS_NOCHDIR, NULL);
-    if (!file_system)
+    char path[PATH_MAX] = {0};
+    FILE *f = NULL;
+    char line[128] = {0};
+    unsigned long long value;
+    int ret = -1;
+
+    if (!target->cgroup_path || build_controller_file_path(target, "cpu.stat", "cpuacct", "cpuacct.usage", path, PATH_MAX))
         return -1;
 
-    for (node = fts_read(file_system); node; node = fts_read(file_system)) {
-        /*
-         * Filtering the directories having 2 hard links leading to them to only get leaves directories.
-         * The cgroup subsystems does not support hard links, so this will always work.
-         */
-        if (node->fts_info == FTS_D && node->fts_statp->st_nlink == 2) {
-            type = target_detect_type(node->fts_path);
-            if ((type & type_mask) && target_validate_type(type, node->fts_path)) {
-                target = target_create(type, base_path, node->fts_path);
-                if (target)
-                    zhashx_insert(targets, node->fts_path, target);
-            }
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    /* cpu.stat (v2) reports the usage in microseconds, cpuacct.usage (v1) in nanoseconds */
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "usage_usec %llu", &value) == 1) {
+            *usage = (uint64_t) value * 1000;
+            ret = 0;
+            break;
+        }
+        if (sscanf(line, "%llu", &value) == 1) {
+            *usage = (uint64_t) value;
+            ret = 0;
+            break;
         }
     }
 
-    fts_close(file_system);
-    return 0;
+    fclose(f);
+    return ret;
 }
 
+void
+target_destroy(struct target *target)
+{
+    if (!target)
+        return;
+
+    free(target->cgroup_path);
+    free(target->container_id);
+    free(target);
+}
@@ -34,6 +34,9 @@
 
 #include <czmq.h>
 
+#include "cpuset.h"
+#include "target_metadata.h"
+
 /*
  * target_type stores the supported target types.
  */
@@ -47,7 +50,9 @@ enum target_type
     TARGET_TYPE_KUBERNETES = 32,
     TARGET_TYPE_LIBVIRT = 64,
     TARGET_TYPE_LXC = 128,
-    TARGET_TYPE_EVERYTHING = 255
+    TARGET_TYPE_CONTAINERD = 256,
+    TARGET_TYPE_CRIO = 512,
+    TARGET_TYPE_EVERYTHING = 1023
 };
 
 /*
@@ -63,37 +68,46 @@ struct target
     enum target_type type;
     const char *cgroup_basedir;
     char *cgroup_path;
+    char *container_id;
 };
 
 /*
- * target_detect_type returns the target type of the given cgroup path.
+ * target_create allocate the resources and configure the target.
  */
-enum target_type target_detect_type(const char *cgroup_path);
+struct target *target_create(enum target_type type, const char *cgroup_basedir, const char *cgroup_path, const char *container_id);
 
 /*
- * target_validate_type validate the target type of the given cgroup path.
+ * target_dup duplicate the given target.
  */
-int target_validate_type(enum target_type type, const char *cgroup_path);
+struct target *target_dup(struct target *target);
 
 /*
- * target_create allocate the resources and configure the target.
+ * target_resolve_real_name returns the static name of the given target, or its cgroup path relative to the cgroup base dir.
+ * The real name of the containers is resolved asynchronously, see target_resolve_metadata.
  */
-struct target *target_create(enum target_type type, const char *cgroup_basedir, const char *cgroup_path);
+char *target_resolve_real_name(struct target *target);
 
 /*
- * target_resolve_real_name resolve and return the real name of the given target.
+ * target_resolve_metadata read the name and the labels of the given container target from the configuration of its runtime.
+ * This function does blocking I/Os and should not be called from the monitoring path.
  */
-char *target_resolve_real_name(struct target *target);
+struct target_metadata *target_resolve_metadata(struct target *target);
 
 /*
- * target_destroy free the allocated resources for the target.
+ * target_read_effective_cpus read the cpus the processes of the given target are allowed to run on. (effective cpuset)
+ * Returns -1 if the target is not restricted or its cpuset cannot be read.
  */
-void target_destroy(struct target *target);
+int target_read_effective_cpus(struct target *target, struct cpuset *cpus);
+
+/*
+ * target_read_cpu_usage read the total cpu time (in nanoseconds) consumed by the processes of the given target.
+ */
+int target_read_cpu_usage(struct target *target, uint64_t *usage);
 
 /*
- * target_discover_running returns a list of running targets.
+ * target_destroy free the allocated resources for the target.
  */
-int target_discover_running(const char *base_path, enum target_type type_mask, zhashx_t *targets);
+void target_destroy(struct target *target);
 
 #endif /* TARGET_H */
 
@@ -0,0 +1,233 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "target.h"
+#include "target_classifier.h"
+
+/*
+ * target_pattern stores the pattern of a supported target type.
+ * The *_group fields are the index of the groups capturing the container id, the pod and the slice of the pod in the pattern, 0 if there is none.
+ * The slice group only captures the QoS class slice of the Burstable and BestEffort pods, the Guaranteed pods are directly under the kubepods cgroup.
+ */
+struct target_pattern
+{
+    enum target_type type;
+    const char *regex;
+    size_t id_group;
+    size_t pod_group;
+    size_t slice_group;
+};
+
+/*
+ * KUBEPODS_SYSTEMD_SLICES is the hierarchy of slices created by the systemd cgroup driver of Kubernetes.
+ */
+#define KUBEPODS_SYSTEMD_SLICES \
+    "/(kubepods\\.slice(/kubepods-[a-z]+\\.slice)?)/(kubepods-([a-z]+-)?pod[a-f0-9_]+\\.slice)/"
+
+/*
+ * target_patterns stores the patterns of the supported target types.
+ * They are matched at once against the absolute cgroup path and are all anchored at the end of the path.
+ * The combined regex reports the match starting the leftmost in the path, not the first pattern of the table, so a container
+ * nested in another one is classified as the outer one (e.g. /lxc/<name>/docker/<id> is a LXC target).
+ */
+static const struct target_pattern target_patterns[] = {
+    /* System and kernel (running processes/threads in system/kernel cgroup, below the perf_event controller or the unified hierarchy) */
+    { TARGET_TYPE_SYSTEM, "/system(/.*)?$", 0, 0, 0 },
+    { TARGET_TYPE_KERNEL, "/kernel(/.*)?$", 0, 0, 0 },
+
+    /* Kubernetes (cgroupfs driver, the container runtime cannot be identified) */
+    { TARGET_TYPE_KUBERNETES, "/(kubepods(/besteffort|/burstable)?)/(pod[a-zA-Z0-9][a-zA-Z0-9.-]+)/([a-f0-9]{64})(/[a-zA-Z0-9][a-zA-Z0-9.-]+)?$", 4, 3, 2 },
+
+    /* Kubernetes (systemd driver, the scope is prefixed by the container runtime) */
+    { TARGET_TYPE_KUBERNETES, KUBEPODS_SYSTEMD_SLICES "docker-([a-f0-9]{64})\\.scope$", 5, 3, 2 },
+    { TARGET_TYPE_CONTAINERD, KUBEPODS_SYSTEMD_SLICES "cri-containerd-([a-f0-9]{64})\\.scope$", 5, 3, 2 },
+    { TARGET_TYPE_CRIO, KUBEPODS_SYSTEMD_SLICES "crio-([a-f0-9]{64})\\.scope$", 5, 3, 2 },
+
+    /* Docker (running containers) */
+    { TARGET_TYPE_DOCKER, "/docker/([a-f0-9]{64})$", 1, 0, 0 },
+    { TARGET_TYPE_DOCKER, "/system\\.slice/docker-([a-f0-9]{64})\\.scope$", 1, 0, 0 },
+
+    /* containerd (running containers outside of Kubernetes) */
+    { TARGET_TYPE_CONTAINERD, "/(default|k8s\\.io)/([a-f0-9]{64})$", 2, 0, 0 },
+
+    /* CRI-O (running containers outside of Kubernetes) */
+    { TARGET_TYPE_CRIO, "/crio/([a-f0-9]{64})$", 1, 0, 0 },
+    { TARGET_TYPE_CRIO, "/crio-([a-f0-9]{64})\\.scope$", 1, 0, 0 },
+
+    /* LibVirt (running virtual machine) */
+    { TARGET_TYPE_LIBVIRT, "/machine\\.slice/.+$", 0, 0, 0 },
+
+    /* LXC (running containers) */
+    { TARGET_TYPE_LXC, "/lxc(/|\\.payload\\.)[^/]+(/.*)?$", 0, 0, 0 },
+};
+
+#define NUM_TARGET_PATTERNS (sizeof(target_patterns) / sizeof(target_patterns[0]))
+
+/*
+ * MAX_CLASSIFIER_GROUPS is the maximum number of groups (including the whole match) of the combined regex.
+ */
+#define MAX_CLASSIFIER_GROUPS 64
+
+/*
+ * classifier stores the combined regex of the target patterns and the location of their groups.
+ */
+static struct {
+    bool initialized;
+    regex_t re;
+    size_t num_groups;
+    size_t pattern_group[NUM_TARGET_PATTERNS]; /* index of the outer group of each pattern in the combined regex */
+} classifier = {0};
+
+static size_t
+count_regex_groups(const char *regex)
+{
+    size_t count = 0;
+
+    for (; *regex; regex++) {
+        if (*regex == '\\' && *(regex + 1))
+            regex++;
+        else if (*regex == '(')
+            count++;
+    }
+
+    return count;
+}
+
+int
+target_classifier_initialize(void)
+{
+    char *combined_regex = NULL;
+    size_t combined_length = 0;
+    size_t i;
+    int ret;
+
+    if (classifier.initialized)
+        return 0;
+
+    for (i = 0; i < NUM_TARGET_PATTERNS; i++)
+        combined_length += strlen(target_patterns[i].regex) + 3; /* "(", ")" and "|" */
+
+    combined_regex = calloc(combined_length + 1, sizeof(char));
+    if (!combined_regex)
+        return -1;
+
+    /* every pattern is wrapped in a group to know which one matched the cgroup path */
+    classifier.num_groups = 1;
+    for (i = 0; i < NUM_TARGET_PATTERNS; i++) {
+        if (i > 0)
+            strcat(combined_regex, "|");
+
+        strcat(combined_regex, "(");
+        strcat(combined_regex, target_patterns[i].regex);
+        strcat(combined_regex, ")");
+
+        classifier.pattern_group[i] = classifier.num_groups;
+        classifier.num_groups += 1 + count_regex_groups(target_patterns[i].regex);
+    }
+
+    if (classifier.num_groups > MAX_CLASSIFIER_GROUPS) {
+        zsys_error("target: too many groups in the target patterns");
+        free(combined_regex);
+        return -1;
+    }
+
+    ret = regcomp(&classifier.re, combined_regex, REG_EXTENDED | REG_NEWLINE);
+    free(combined_regex);
+    if (ret) {
+        zsys_error("target: failed to compile the target patterns");
+        return -1;
+    }
+
+    classifier.initialized = true;
+    return 0;
+}
+
+enum target_type
+target_classify(const char *cgroup_path, struct target_classification *result)
+{
+    regmatch_t matches[MAX_CLASSIFIER_GROUPS];
+    const struct target_pattern *pattern = NULL;
+    const regmatch_t *pattern_matches = NULL;
+    size_t i;
+
+    result->type = TARGET_TYPE_UNKNOWN;
+    result->container_id[0] = '\0';
+    result->pod_path_length = 0;
+    result->slice_path_length = 0;
+
+    /* All running processes/threads (not a cgroup) */
+    if (!cgroup_path) {
+        result->type = TARGET_TYPE_ALL;
+        return result->type;
+    }
+
+    if (!classifier.initialized || regexec(&classifier.re, cgroup_path, classifier.num_groups, matches, 0))
+        return result->type;
+
+    for (i = 0; i < NUM_TARGET_PATTERNS; i++) {
+        if (matches[classifier.pattern_group[i]].rm_so == -1)
+            continue;
+
+        pattern = &target_patterns[i];
+        pattern_matches = &matches[classifier.pattern_group[i]];
+        result->type = pattern->type;
+
+        if (pattern->id_group)
+            snprintf(result->container_id, sizeof(result->container_id), "%.*s", (int) (pattern_matches[pattern->id_group].rm_eo - pattern_matches[pattern->id_group].rm_so), cgroup_path + pattern_matches[pattern->id_group].rm_so);
+
+        /* the pod and its slice are parents of the container cgroup, so their path is a prefix of it */
+        if (pattern->pod_group)
+            result->pod_path_length = (size_t) pattern_matches[pattern->pod_group].rm_eo;
+
+        /* the kubepods cgroup of the Guaranteed pods is the parent of the other QoS class slices, it is not their slice */
+        if (pattern->slice_group && pattern_matches[pattern->slice_group].rm_so != -1)
+            result->slice_path_length = (size_t) pattern_matches[pattern->slice_group].rm_eo;
+
+        break;
+    }
+
+    return result->type;
+}
+
+void
+target_classifier_deinitialize(void)
+{
+    if (!classifier.initialized)
+        return;
+
+    regfree(&classifier.re);
+    classifier.initialized = false;
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TARGET_CLASSIFIER_H
+#define TARGET_CLASSIFIER_H
+
+#include <sys/types.h>
+
+#include "target.h"
+
+/*
+ * TARGET_CONTAINER_ID_LENGTH is the length of the containers id extracted from the cgroup path.
+ */
+#define TARGET_CONTAINER_ID_LENGTH 64
+
+/*
+ * target_classification stores the result of the classification of a cgroup.
+ */
+struct target_classification
+{
+    enum target_type type;
+    ino_t inode;
+    char container_id[TARGET_CONTAINER_ID_LENGTH + 1]; /* empty if the target is not a container */
+    size_t pod_path_length; /* length of the pod cgroup path prefix, 0 if the container is not part of a pod */
+    size_t slice_path_length; /* length of the slice (QoS class) cgroup path prefix of the pod, 0 if not part of a pod or if the pod is Guaranteed */
+};
+
+/*
+ * target_classifier_initialize compile the patterns of the supported target types.
+ */
+int target_classifier_initialize(void);
+
+/*
+ * target_classify match the cgroup path against the patterns of all the supported target types at once.
+ * Returns TARGET_TYPE_UNKNOWN if the cgroup path does not lead to a supported target.
+ */
+enum target_type target_classify(const char *cgroup_path, struct target_classification *result);
+
+/*
+ * target_classifier_deinitialize free the resources of the compiled patterns.
+ */
+void target_classifier_deinitialize(void);
+
+#endif /* TARGET_CLASSIFIER_H */
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "target_containerd.h"
+#include "target_metadata.h"
+
+/*
+ * CONTAINER_SPEC_PATH_FORMAT is the format of the path to the OCI runtime specification of a containerd container.
+ */
+#define CONTAINER_SPEC_PATH_FORMAT "/run/containerd/io.containerd.runtime.v2.task/%s/%s/config.json"
+
+/*
+ * containerd_namespaces stores the containerd namespaces where the containers are looked for.
+ */
+static const char *containerd_namespaces[] = { "k8s.io", "default", "moby", NULL };
+
+static const char *
+get_annotation(zhashx_t *annotations, const char *name)
+{
+    const char *value = zhashx_lookup(annotations, name);
+
+    return (value && *value) ? value : NULL;
+}
+
+static char *
+build_container_name(zhashx_t *annotations)
+{
+    const char *container_name = get_annotation(annotations, "io.kubernetes.cri.container-name");
+    const char *pod_name = get_annotation(annotations, "io.kubernetes.cri.sandbox-name");
+    const char *pod_namespace = get_annotation(annotations, "io.kubernetes.cri.sandbox-namespace");
+    const char *nerdctl_name = get_annotation(annotations, "nerdctl/name");
+    char buffer[PATH_MAX] = {0};
+
+    /* containers managed by Kubernetes are named the same way as the Docker runtime does */
+    if (container_name && pod_name && pod_namespace) {
+        snprintf(buffer, PATH_MAX, "k8s_%s_%s_%s", container_name, pod_name, pod_namespace);
+        return strdup(buffer);
+    }
+
+    if (nerdctl_name)
+        return strdup(nerdctl_name);
+
+    return NULL;
+}
+
+struct target_metadata *
+target_containerd_resolve_metadata(const char *container_id)
+{
+    char spec_path[PATH_MAX] = {0};
+    bson_t doc = BSON_INITIALIZER;
+    bson_iter_t iter;
+    struct target_metadata *metadata = NULL;
+    int found = false;
+    size_t i;
+
+    for (i = 0; containerd_namespaces[i] && !found; i++) {
+        snprintf(spec_path, PATH_MAX, CONTAINER_SPEC_PATH_FORMAT, containerd_namespaces[i], container_id);
+        bson_reinit(&doc);
+        found = !target_metadata_read_json(spec_path, &doc);
+    }
+
+    if (!found)
+        goto out;
+
+    metadata = target_metadata_create(NULL);
+    if (!metadata)
+        goto out;
+
+    /* the annotations of the specification are used as labels */
+    if (bson_iter_init_find(&iter, &doc, "annotations"))
+        target_metadata_add_labels(metadata, &iter);
+
+    metadata->name = build_container_name(metadata->labels);
+
+out:
+    bson_destroy(&doc);
+    return metadata;
+}
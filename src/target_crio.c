@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "target_crio.h"
+#include "target_metadata.h"
+
+/*
+ * CONTAINER_CONFIG_PATH_FORMAT is the format of the path to the configuration file of a CRI-O container.
+ */
+#define CONTAINER_CONFIG_PATH_FORMAT "%s/overlay-containers/%s/userdata/config.json"
+
+/*
+ * crio_storage_roots stores the directories where the configuration of the containers is looked for. (storage root and run root)
+ */
+static const char *crio_storage_roots[] = { "/var/lib/containers/storage", "/run/containers/storage", NULL };
+
+struct target_metadata *
+target_crio_resolve_metadata(const char *container_id)
+{
+    char config_path[PATH_MAX] = {0};
+    bson_t doc = BSON_INITIALIZER;
+    bson_iter_t iter;
+    struct target_metadata *metadata = NULL;
+    const char *name = NULL;
+    int found = false;
+    size_t i;
+
+    for (i = 0; crio_storage_roots[i] && !found; i++) {
+        snprintf(config_path, PATH_MAX, CONTAINER_CONFIG_PATH_FORMAT, crio_storage_roots[i], container_id);
+        bson_reinit(&doc);
+        found = !target_metadata_read_json(config_path, &doc);
+    }
+
+    if (!found)
+        goto out;
+
+    metadata = target_metadata_create(NULL);
+    if (!metadata)
+        goto out;
+
+    /* the annotations of the configuration are used as labels */
+    if (bson_iter_init_find(&iter, &doc, "annotations"))
+        target_metadata_add_labels(metadata, &iter);
+
+    /* CRI-O names the containers the same way as the Docker runtime does */
+    name = zhashx_lookup(metadata->labels, "io.kubernetes.cri-o.Name");
+    if (name && *name)
+        metadata->name = strdup(name);
+
+out:
+    bson_destroy(&doc);
+    return metadata;
+}
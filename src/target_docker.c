@@ -29,102 +29,49 @@
  *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <bson.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <regex.h>
 
 #include "target.h"
 #include "target_docker.h"
+#include "target_metadata.h"
 
 /*
- * CONTAINER_ID_REGEX is the regex used to extract the Docker container id from the cgroup path.
- * CONTAINER_ID_REGEX_EXPECTED_MATCHES is the number of expected matches from the regex. (num groups + 1)
+ * CONTAINER_CONFIG_PATH_FORMAT is the format of the path to the json configuration file of a Docker container.
  */
-#define CONTAINER_ID_REGEX "perf_event/docker/([a-f0-9]{64})$"
-#define CONTAINER_ID_REGEX_EXPECTED_MATCHES 2
+#define CONTAINER_CONFIG_PATH_FORMAT "/var/lib/docker/containers/%s/config.v2.json"
 
-/*
- * CONTAINER_NAME_REGEX is the regex used to extract the Docker container name from its json configuration file.
- * CONTAINER_NAME_REGEX_EXPECTED_MATCHES is the number of expected matches from the regex. (num groups + 1)
- */
-#define CONTAINER_NAME_REGEX "\"Name\":\"/([a-zA-Z0-9][a-zA-Z0-9_.-]+)\""
-#define CONTAINER_NAME_REGEX_EXPECTED_MATCHES 2
-
-
-int
-target_docker_validate(const char *cgroup_path)
-{
-    regex_t re;
-    int is_docker_target = false;
-
-    if (!cgroup_path)
-        return false;
-
-    if (!regcomp(&re, CONTAINER_ID_REGEX, REG_EXTENDED | REG_NEWLINE | REG_NOSUB)) {
-        if (!regexec(&re, cgroup_path, 0, NULL, 0))
-            is_docker_target = true;
-
-        regfree(&re);
-    }
-
-    return is_docker_target;
-}
-
-static char *
-build_container_config_path(const char *cgroup_path)
+struct target_metadata *
+target_docker_resolve_metadata(const char *container_id)
 {
-    regex_t re;
-    regmatch_t matches[CONTAINER_ID_REGEX_EXPECTED_MATCHES];
-    regoff_t length;
-    const char *id = NULL;
-    char buffer[PATH_MAX] = {0};
-    char *config_path = NULL;
-
-    if (!regcomp(&re, CONTAINER_ID_REGEX, REG_EXTENDED | REG_NEWLINE)) {
-        if (!regexec(&re, cgroup_path, CONTAINER_ID_REGEX_EXPECTED_MATCHES, matches, 0)) {
-            id = cgroup_path + matches[1].rm_so;
-            length = matches[1].rm_eo - matches[1].rm_so;
-            snprintf(buffer, PATH_MAX, "/var/lib/docker/containers/%.*s/config.v2.json", length, id);
-            config_path = strdup(buffer);
-        }
-        regfree(&re);
+    char config_path[PATH_MAX] = {0};
+    bson_t doc = BSON_INITIALIZER;
+    bson_iter_t iter;
+    bson_iter_t labels;
+    const char *name = NULL;
+    struct target_metadata *metadata = NULL;
+
+    snprintf(config_path, PATH_MAX, CONTAINER_CONFIG_PATH_FORMAT, container_id);
+    if (target_metadata_read_json(config_path, &doc))
+        goto out;
+
+    /* the container name is prefixed by a slash */
+    if (bson_iter_init_find(&iter, &doc, "Name") && BSON_ITER_HOLDS_UTF8(&iter)) {
+        name = bson_iter_utf8(&iter, NULL);
+        if (*name == '/')
+            name++;
     }
 
-    return config_path;
-}
-
-char *
-target_docker_resolve_name(struct target *target)
-{
-    char *config_path = NULL;
-    FILE *json_file = NULL;
-    char *json = NULL;
-    size_t json_len;
-    regex_t re;
-    regmatch_t matches[CONTAINER_NAME_REGEX_EXPECTED_MATCHES];
-    char *target_name = NULL;
-
-    config_path = build_container_config_path(target->cgroup_path);
-    if (!config_path)
-        return NULL;
+    metadata = target_metadata_create(name);
+    if (!metadata)
+        goto out;
 
-    json_file = fopen(config_path, "r");
-    if (json_file) {
-        if (getline(&json, &json_len, json_file) != -1) {
-            if (!regcomp(&re, CONTAINER_NAME_REGEX, REG_EXTENDED | REG_NEWLINE)) {
-                if (!regexec(&re, json, CONTAINER_NAME_REGEX_EXPECTED_MATCHES, matches, 0))
-                    target_name = strndup(json + matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
+    if (bson_iter_init(&iter, &doc) && bson_iter_find_descendant(&iter, "Config.Labels", &labels))
+        target_metadata_add_labels(metadata, &labels);
 
-                regfree(&re);
-            }
-            free(json);
-        }
-        fclose(json_file);
-    }
-
-    free(config_path);
-    return target_name;
+out:
+    bson_destroy(&doc);
+    return metadata;
 }
-
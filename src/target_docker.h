@@ -32,17 +32,12 @@
 #ifndef TARGET_DOCKER_H
 #define TARGET_DOCKER_H
 
-#include "target.h"
+#include "target_metadata.h"
 
 /*
- * target_docker_validate check if the cgroup path lead to a valid Docker target.
+ * target_docker_resolve_metadata read the name and the labels of the given Docker container from its configuration file.
  */
-int target_docker_validate(const char *cgroup_path);
-
-/*
- * target_docker_resolve_name resolve and return the real name of the given target.
- */
-char *target_docker_resolve_name(struct target *target);
+struct target_metadata *target_docker_resolve_metadata(const char *container_id);
 
 #endif /* TARGET_DOCKER_H */
 
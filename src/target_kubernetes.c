@@ -29,104 +29,23 @@
  *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <stdlib.h>
-#include <regex.h>
-
-#include "target.h"
+#include "target_containerd.h"
+#include "target_crio.h"
+#include "target_docker.h"
 #include "target_kubernetes.h"
+#include "target_metadata.h"
 
-/*
- * CONTAINER_ID_REGEX is the regex used to extract the Docker container id from a cgroup path.
- * CONTAINER_ID_REGEX_EXPECTED_MATCHES is the number of matches expected from the regex. (num groups + 1)
- */
-#define CONTAINER_ID_REGEX \
-    "perf_event/kubepods/" \
-    "(besteffort/|burstable/|)" \
-    "(pod[a-zA-Z0-9][a-zA-Z0-9.-]+)/" /* Pod ID */ \
-    "([a-f0-9]{64})" /* Container ID */ \
-    "(/[a-zA-Z0-9][a-zA-Z0-9.-]+|)" /* Resource group */
-#define CONTAINER_ID_REGEX_EXPECTED_MATCHES 5
-
-/*
- * CONTAINER_NAME_REGEX is the regex used to extract the name of the Docker container from its json configuration file.
- * CONTAINER_NAME_REGEX_EXPECTED_MATCHES is the number of matches expected from the regex. (num groups + 1)
- */
-#define CONTAINER_NAME_REGEX "\"Name\":\"/([a-zA-Z0-9][a-zA-Z0-9_.-]+)\""
-#define CONTAINER_NAME_REGEX_EXPECTED_MATCHES 2
-
-
-int
-target_kubernetes_validate(const char *cgroup_path)
+struct target_metadata *
+target_kubernetes_resolve_metadata(const char *container_id)
 {
-    regex_t re;
-    bool is_kubernetes_target = false;
-
-    if (!cgroup_path)
-        return false;
+    struct target_metadata *metadata = NULL;
 
-    if (!regcomp(&re, CONTAINER_ID_REGEX, REG_EXTENDED | REG_NEWLINE | REG_NOSUB)) {
-        if (!regexec(&re, cgroup_path, 0, NULL, 0))
-            is_kubernetes_target = true;
+    /* the container runtime cannot be identified from the cgroup path with the cgroupfs driver, so all of them are tried */
+    metadata = target_docker_resolve_metadata(container_id);
+    if (!metadata)
+        metadata = target_containerd_resolve_metadata(container_id);
+    if (!metadata)
+        metadata = target_crio_resolve_metadata(container_id);
 
-        regfree(&re);
-    }
-
-    return is_kubernetes_target;
+    return metadata;
 }
-
-static char *
-build_container_config_path(const char *cgroup_path)
-{
-    regex_t re;
-    regmatch_t matches[CONTAINER_ID_REGEX_EXPECTED_MATCHES];
-    regoff_t length;
-    const char *id = NULL;
-    char buffer[PATH_MAX] = {0};
-    char *config_path = NULL;
-
-    if (!regcomp(&re, CONTAINER_ID_REGEX, REG_EXTENDED | REG_NEWLINE)) {
-        if (!regexec(&re, cgroup_path, CONTAINER_ID_REGEX_EXPECTED_MATCHES, matches, 0)) {
-            id = cgroup_path + matches[3].rm_so;
-            length = matches[3].rm_eo - matches[3].rm_so;
-            snprintf(buffer, PATH_MAX, "/var/lib/docker/containers/%.*s/config.v2.json", length, id);
-            config_path = strdup(buffer);
-        }
-        regfree(&re);
-    }
-
-    return config_path;
-}
-
-char *
-target_kubernetes_resolve_name(struct target *target)
-{
-    char *config_path = NULL;
-    FILE *json_file = NULL;
-    char *json = NULL;
-    size_t json_len;
-    regex_t re;
-    regmatch_t matches[CONTAINER_NAME_REGEX_EXPECTED_MATCHES];
-    char *target_name = NULL;
-
-    config_path = build_container_config_path(target->cgroup_path);
-    if (!config_path)
-        return NULL;
-
-    json_file = fopen(config_path, "r");
-    if (json_file) {
-        if (getline(&json, &json_len, json_file) != -1) {
-            if (!regcomp(&re, CONTAINER_NAME_REGEX, REG_EXTENDED | REG_NEWLINE)) {
-                if (!regexec(&re, json, CONTAINER_NAME_REGEX_EXPECTED_MATCHES, matches, 0))
-                    target_name = strndup(json + matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
-
-                regfree(&re);
-            }
-            free(json);
-        }
-        fclose(json_file);
-    }
-
-    free(config_path);
-    return target_name;
-}
-
@@ -32,17 +32,12 @@
 #ifndef TARGET_KUBERNETES_H
 #define TARGET_KUBERNETES_H
 
-#include "target.h"
+#include "target_metadata.h"
 
 /*
- * target_kubernetes_validate check if the cgroup path lead to a valid Kubernetes target.
+ * target_kubernetes_resolve_metadata read the name and the labels of the given Kubernetes container from the configuration of its runtime.
  */
-int target_kubernetes_validate(const char *cgroup_path);
-
-/*
- * target_kubernetes_resolve_name resolve and return the real name of the given target.
- */
-char *target_kubernetes_resolve_name(struct target *target);
+struct target_metadata *target_kubernetes_resolve_metadata(const char *container_id);
 
 #endif /* TARGET_KUBERNETES_H */
 
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <bson.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "target_metadata.h"
+#include "util.h"
+
+struct target_metadata *
+target_metadata_create(const char *name)
+{
+    struct target_metadata *metadata = malloc(sizeof(struct target_metadata));
+
+    if (!metadata)
+        return NULL;
+
+    metadata->name = (name) ? strdup(name) : NULL;
+    metadata->labels = zhashx_new();
+    zhashx_set_duplicator(metadata->labels, (zhashx_duplicator_fn *) strdup);
+    zhashx_set_destructor(metadata->labels, (zhashx_destructor_fn *) ptrfree);
+
+    return metadata;
+}
+
+struct target_metadata *
+target_metadata_dup(const struct target_metadata *metadata)
+{
+    struct target_metadata *copy = NULL;
+
+    if (!metadata)
+        return NULL;
+
+    copy = malloc(sizeof(struct target_metadata));
+    if (!copy)
+        return NULL;
+
+    copy->name = (metadata->name) ? strdup(metadata->name) : NULL;
+    copy->labels = zhashx_dup(metadata->labels);
+
+    return copy;
+}
+
+void
+target_metadata_destroy(struct target_metadata **metadata_ptr)
+{
+    if (!*metadata_ptr)
+        return;
+
+    free((*metadata_ptr)->name);
+    zhashx_destroy(&(*metadata_ptr)->labels);
+    free(*metadata_ptr);
+    *metadata_ptr = NULL;
+}
+
+void
+target_metadata_add_labels(struct target_metadata *metadata, bson_iter_t *iter)
+{
+    bson_iter_t child;
+
+    if (!BSON_ITER_HOLDS_DOCUMENT(iter) || !bson_iter_recurse(iter, &child))
+        return;
+
+    while (bson_iter_next(&child)) {
+        if (BSON_ITER_HOLDS_UTF8(&child))
+            zhashx_update(metadata->labels, bson_iter_key(&child), (void *) bson_iter_utf8(&child, NULL));
+    }
+}
+
+int
+target_metadata_read_json(const char *path, bson_t *doc)
+{
+    bson_json_reader_t *reader = NULL;
+    bson_error_t error;
+    int ret = -1;
+
+    reader = bson_json_reader_new_from_file(path, &error);
+    if (!reader)
+        return -1;
+
+    if (bson_json_reader_read(reader, doc, &error) > 0)
+        ret = 0;
+
+    bson_json_reader_destroy(reader);
+    return ret;
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TARGET_METADATA_H
+#define TARGET_METADATA_H
+
+#include <czmq.h>
+#include <bson.h>
+
+/*
+ * target_metadata stores the name and the labels of a container target.
+ */
+struct target_metadata
+{
+    char *name; /* NULL if the name cannot be resolved */
+    zhashx_t *labels; /* char *label_name -> char *label_value */
+};
+
+/*
+ * target_metadata_create allocate the resources of the metadata of a target.
+ */
+struct target_metadata *target_metadata_create(const char *name);
+
+/*
+ * target_metadata_dup duplicate the given metadata.
+ */
+struct target_metadata *target_metadata_dup(const struct target_metadata *metadata);
+
+/*
+ * target_metadata_destroy free the allocated resources of the metadata.
+ */
+void target_metadata_destroy(struct target_metadata **metadata_ptr);
+
+/*
+ * target_metadata_add_labels add the string values of the given document iterator to the labels of the metadata.
+ */
+void target_metadata_add_labels(struct target_metadata *metadata, bson_iter_t *iter);
+
+/*
+ * target_metadata_read_json parse the given json file into the document.
+ */
+int target_metadata_read_json(const char *path, bson_t *doc);
+
+#endif /* TARGET_METADATA_H */
@@ -0,0 +1,407 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "target.h"
+#include "target_metadata.h"
+#include "target_resolver.h"
+
+static void
+target_resolver_entry_destroy(struct target_resolver_entry **entry_ptr)
+{
+    if (!*entry_ptr)
+        return;
+
+    free((*entry_ptr)->container_id);
+    target_metadata_destroy(&(*entry_ptr)->metadata);
+    free(*entry_ptr);
+    *entry_ptr = NULL;
+}
+
+/*
+ * touch_entry mark the cached entry as the most recently used one, the resolver lock must be held.
+ */
+static void
+touch_entry(struct target_resolver *resolver, struct target_resolver_entry *entry)
+{
+    entry->last_used = (uint64_t) zclock_mono();
+    zlistx_move_end(resolver->lru, entry->handle);
+}
+
+/*
+ * evict_entry remove the entry from the cache, the resolver lock must be held.
+ */
+static void
+evict_entry(struct target_resolver *resolver, struct target_resolver_entry *entry)
+{
+    zlistx_delete(resolver->lru, entry->handle);
+    zhashx_delete(resolver->cache, entry->container_id);
+}
+
+static bool
+is_cached(struct target_resolver *resolver, const char *container_id)
+{
+    struct target_resolver_entry *entry = NULL;
+
+    pthread_mutex_lock(&resolver->lock);
+    entry = zhashx_lookup(resolver->cache, container_id);
+    if (entry)
+        touch_entry(resolver, entry);
+    pthread_mutex_unlock(&resolver->lock);
+
+    return entry != NULL;
+}
+
+/*
+ * cache_metadata store the metadata of the container in the cache, which takes their ownership.
+ * The least recently used containers are evicted when the cache is full.
+ */
+static void
+cache_metadata(struct target_resolver *resolver, const char *container_id, struct target_metadata *metadata, enum target_resolver_state state)
+{
+    struct target_resolver_entry *entry = NULL;
+
+    pthread_mutex_lock(&resolver->lock);
+    entry = zhashx_lookup(resolver->cache, container_id);
+    if (!entry) {
+        entry = calloc(1, sizeof(struct target_resolver_entry));
+        if (!entry)
+            goto out;
+
+        entry->container_id = strdup(container_id);
+        entry->handle = zlistx_add_end(resolver->lru, entry);
+        if (!entry->container_id || !entry->handle) {
+            if (entry->handle)
+                zlistx_delete(resolver->lru, entry->handle);
+            target_resolver_entry_destroy(&entry);
+            goto out;
+        }
+
+        zhashx_insert(resolver->cache, container_id, entry);
+        while (zhashx_size(resolver->cache) > TARGET_RESOLVER_CACHE_SIZE)
+            evict_entry(resolver, zlistx_head(resolver->lru));
+    }
+
+    target_metadata_destroy(&entry->metadata);
+    entry->metadata = metadata;
+    metadata = NULL;
+    entry->state = state;
+    touch_entry(resolver, entry);
+
+out:
+    pthread_mutex_unlock(&resolver->lock);
+    target_metadata_destroy(&metadata);
+}
+
+/*
+ * set_state update the state of the resolution of the cached container.
+ */
+static void
+set_state(struct target_resolver *resolver, const char *container_id, enum target_resolver_state state)
+{
+    struct target_resolver_entry *entry = NULL;
+
+    pthread_mutex_lock(&resolver->lock);
+    entry = zhashx_lookup(resolver->cache, container_id);
+    if (entry)
+        entry->state = state;
+    pthread_mutex_unlock(&resolver->lock);
+}
+
+/*
+ * expire_entries evict the containers whose metadata have not been used for the TTL of the cache.
+ * Returns the time (in milliseconds) until the next entry expires, or -1 if the cache is empty.
+ */
+static int
+expire_entries(struct target_resolver *resolver)
+{
+    uint64_t now = (uint64_t) zclock_mono();
+    struct target_resolver_entry *entry = NULL;
+    int timeout = -1;
+
+    pthread_mutex_lock(&resolver->lock);
+    for (entry = zlistx_head(resolver->lru); entry && entry->last_used + TARGET_RESOLVER_CACHE_TTL <= now; entry = zlistx_head(resolver->lru))
+        evict_entry(resolver, entry);
+
+    if (entry)
+        timeout = (int) (entry->last_used + TARGET_RESOLVER_CACHE_TTL - now);
+    pthread_mutex_unlock(&resolver->lock);
+
+    return timeout;
+}
+
+static void
+target_resolver_retry_destroy(struct target_resolver_retry **retry_ptr)
+{
+    if (!*retry_ptr)
+        return;
+
+    target_destroy((*retry_ptr)->target);
+    free(*retry_ptr);
+    *retry_ptr = NULL;
+}
+
+/*
+ * resolve_target resolve the metadata of the container and cache them.
+ * The failures are cached too, in the given state, so the target is reported under its cgroup path, and returns false.
+ */
+static bool
+resolve_target(struct target_resolver *resolver, struct target *target, enum target_resolver_state failed_state)
+{
+    struct target_metadata *metadata = target_resolve_metadata(target);
+    bool resolved = metadata && metadata->name;
+
+    if (resolved)
+        zsys_info("resolver: container %.12s resolved as %s (%zu labels)", target->container_id, metadata->name, zhashx_size(metadata->labels));
+
+    if (!metadata)
+        metadata = target_metadata_create(NULL);
+
+    if (metadata)
+        cache_metadata(resolver, target->container_id, metadata, (resolved) ? TARGET_RESOLVER_RESOLVED : failed_state);
+
+    return resolved;
+}
+
+static void
+handle_resolve(struct target_resolver *resolver, struct target *target)
+{
+    struct target_resolver_retry *retry = NULL;
+
+    /* the same container can be requested again while its resolution was pending */
+    if (is_cached(resolver, target->container_id))
+        return;
+
+    if (resolve_target(resolver, target, TARGET_RESOLVER_PENDING))
+        return;
+
+    /* the config of the container can be written by the runtime after its cgroup has been created */
+    retry = calloc(1, sizeof(struct target_resolver_retry));
+    if (!retry)
+        goto error;
+
+    retry->target = target_dup(target);
+    if (!retry->target) {
+        free(retry);
+        goto error;
+    }
+
+    retry->attempts = 1;
+    retry->next_attempt = (uint64_t) zclock_mono() + TARGET_RESOLVER_RETRY_PERIOD;
+    zhashx_update(resolver->retries, target->container_id, retry);
+    zsys_warning("resolver: cannot resolve the name of container %.12s yet, its cgroup path is used", target->container_id);
+    return;
+
+error:
+    set_state(resolver, target->container_id, TARGET_RESOLVER_UNRESOLVABLE);
+}
+
+/*
+ * handle_retries resolve again the containers whose retry delay elapsed, and returns the time (in milliseconds) until the next one.
+ */
+static int
+handle_retries(struct target_resolver *resolver)
+{
+    uint64_t now = (uint64_t) zclock_mono();
+    uint64_t next_attempt = UINT64_MAX;
+    zlistx_t *containers_id = NULL;
+    const char *container_id = NULL;
+    struct target_resolver_retry *retry = NULL;
+
+    if (!zhashx_size(resolver->retries))
+        return -1;
+
+    containers_id = zhashx_keys(resolver->retries);
+    if (!containers_id)
+        return TARGET_RESOLVER_RETRY_PERIOD;
+
+    for (container_id = zlistx_first(containers_id); container_id; container_id = zlistx_next(containers_id)) {
+        retry = zhashx_lookup(resolver->retries, container_id);
+        if (retry->next_attempt > now) {
+            next_attempt = (retry->next_attempt < next_attempt) ? retry->next_attempt : next_attempt;
+            continue;
+        }
+
+        /* the last failure is kept until the metadata of the container expire */
+        if (resolve_target(resolver, retry->target, (retry->attempts + 1 >= TARGET_RESOLVER_MAX_ATTEMPTS) ? TARGET_RESOLVER_UNRESOLVABLE : TARGET_RESOLVER_PENDING)) {
+            zhashx_delete(resolver->retries, container_id);
+            continue;
+        }
+
+        if (++retry->attempts >= TARGET_RESOLVER_MAX_ATTEMPTS) {
+            zsys_warning("resolver: cannot resolve the name of container %.12s, its cgroup path will be used", container_id);
+            zhashx_delete(resolver->retries, container_id);
+            continue;
+        }
+
+        retry->next_attempt = now + TARGET_RESOLVER_RETRY_PERIOD;
+        next_attempt = (retry->next_attempt < next_attempt) ? retry->next_attempt : next_attempt;
+    }
+    zlistx_destroy(&containers_id);
+
+    return (next_attempt == UINT64_MAX) ? -1 : (int) (next_attempt - now);
+}
+
+static void
+target_resolver_actor(zsock_t *pipe, void *args)
+{
+    struct target_resolver *resolver = args;
+    zpoller_t *poller = zpoller_new(pipe, NULL);
+    bool terminated = false;
+    char *command = NULL;
+    void *target = NULL;
+    int timeout = -1;
+    int expire_timeout;
+
+    if (!poller) {
+        zsys_error("resolver: cannot create poller");
+        return;
+    }
+
+    zsock_signal(pipe, 0);
+
+    while (!terminated) {
+        if (zpoller_wait(poller, timeout) == pipe) {
+            if (zsock_recv(pipe, "sp", &command, &target) == -1 || !command)
+                break;
+
+            if (streq(command, "$TERM"))
+                terminated = true;
+            else if (streq(command, "RESOLVE") && target)
+                handle_resolve(resolver, target);
+            else
+                zsys_error("resolver: invalid pipe command: %s", command);
+
+            target_destroy(target);
+            target = NULL;
+            zstr_free(&command);
+        }
+        else if (zpoller_terminated(poller)) {
+            break;
+        }
+
+        timeout = handle_retries(resolver);
+        expire_timeout = expire_entries(resolver);
+        if (timeout == -1 || (expire_timeout != -1 && expire_timeout < timeout))
+            timeout = expire_timeout;
+    }
+
+    zpoller_destroy(&poller);
+}
+
+struct target_resolver *
+target_resolver_create(void)
+{
+    struct target_resolver *resolver = malloc(sizeof(struct target_resolver));
+
+    if (!resolver)
+        return NULL;
+
+    pthread_mutex_init(&resolver->lock, NULL);
+    resolver->cache = zhashx_new();
+    zhashx_set_destructor(resolver->cache, (zhashx_destructor_fn *) target_resolver_entry_destroy);
+    resolver->lru = zlistx_new();
+    resolver->retries = zhashx_new();
+    zhashx_set_destructor(resolver->retries, (zhashx_destructor_fn *) target_resolver_retry_destroy);
+
+    resolver->actor = zactor_new(target_resolver_actor, resolver);
+    if (!resolver->actor) {
+        target_resolver_destroy(resolver);
+        return NULL;
+    }
+
+    return resolver;
+}
+
+int
+target_resolver_request(struct target_resolver *resolver, struct target *target)
+{
+    struct target *copy = NULL;
+
+    if (!target->container_id)
+        return 0;
+
+    /* a restarted or rediscovered container is still cached */
+    if (is_cached(resolver, target->container_id))
+        return 0;
+
+    copy = target_dup(target);
+    if (!copy)
+        return -1;
+
+    if (zsock_send(resolver->actor, "sp", "RESOLVE", copy)) {
+        zsys_error("resolver: failed to send resolve command for container %.12s", target->container_id);
+        target_destroy(copy);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct target_metadata *
+target_resolver_lookup(struct target_resolver *resolver, const char *container_id, enum target_resolver_state *state)
+{
+    struct target_resolver_entry *entry = NULL;
+    struct target_metadata *metadata = NULL;
+
+    pthread_mutex_lock(&resolver->lock);
+    entry = zhashx_lookup(resolver->cache, container_id);
+    *state = (entry) ? entry->state : TARGET_RESOLVER_PENDING;
+
+    /* the metadata are only copied once the resolution of the container is over */
+    if (entry) {
+        touch_entry(resolver, entry);
+        if (entry->state != TARGET_RESOLVER_PENDING)
+            metadata = target_metadata_dup(entry->metadata);
+    }
+    pthread_mutex_unlock(&resolver->lock);
+
+    return metadata;
+}
+
+void
+target_resolver_destroy(struct target_resolver *resolver)
+{
+    if (!resolver)
+        return;
+
+    zactor_destroy(&resolver->actor);
+    zhashx_destroy(&resolver->cache);
+    zlistx_destroy(&resolver->lru);
+    zhashx_destroy(&resolver->retries);
+    pthread_mutex_destroy(&resolver->lock);
+    free(resolver);
+}
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TARGET_RESOLVER_H
+#define TARGET_RESOLVER_H
+
+#include <czmq.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "target.h"
+#include "target_metadata.h"
+
+/*
+ * TARGET_RESOLVER_RETRY_PERIOD is the delay (in milliseconds) before resolving again a container whose resolution failed.
+ */
+#define TARGET_RESOLVER_RETRY_PERIOD 5000
+
+/*
+ * TARGET_RESOLVER_MAX_ATTEMPTS is the number of resolutions of a container before it is considered unresolvable.
+ */
+#define TARGET_RESOLVER_MAX_ATTEMPTS 6
+
+/*
+ * TARGET_RESOLVER_CACHE_TTL is the delay (in milliseconds) after which the cached metadata of a container that has not been used expire.
+ */
+#define TARGET_RESOLVER_CACHE_TTL 3600000
+
+/*
+ * TARGET_RESOLVER_CACHE_SIZE is the maximum number of containers in the cache, the least recently used ones are evicted first.
+ */
+#define TARGET_RESOLVER_CACHE_SIZE 4096
+
+/*
+ * target_resolver_state is the state of the resolution of a container.
+ */
+enum target_resolver_state
+{
+    TARGET_RESOLVER_PENDING,
+    TARGET_RESOLVER_RESOLVED,
+    TARGET_RESOLVER_UNRESOLVABLE
+};
+
+/*
+ * target_resolver_entry stores the cached metadata of a container.
+ */
+struct target_resolver_entry
+{
+    char *container_id;
+    struct target_metadata *metadata;
+    enum target_resolver_state state;
+    uint64_t last_used; /* monotonic timestamp (in milliseconds) */
+    void *handle; /* position in the least recently used list of the cache */
+};
+
+/*
+ * target_resolver_retry stores the state of the resolution of a container that failed, the runtime can write its config late.
+ */
+struct target_resolver_retry
+{
+    struct target *target;
+    unsigned int attempts;
+    uint64_t next_attempt; /* monotonic timestamp (in milliseconds) */
+};
+
+/*
+ * target_resolver stores the state of the asynchronous resolver of the containers metadata.
+ * The resolution is done by an actor, and the results are cached by container id to be shared with the monitoring workers.
+ * The cached metadata outlive the monitoring of their container, so a restarted or rediscovered container is not resolved again.
+ */
+struct target_resolver
+{
+    zactor_t *actor;
+    pthread_mutex_t lock;
+    zhashx_t *cache; /* char *container_id -> struct target_resolver_entry *entry */
+    zlistx_t *lru; /* struct target_resolver_entry *entry, the least recently used first */
+    zhashx_t *retries; /* char *container_id -> struct target_resolver_retry *retry, only used by the actor */
+};
+
+/*
+ * target_resolver_create allocate the resources and start the resolver actor.
+ */
+struct target_resolver *target_resolver_create(void);
+
+/*
+ * target_resolver_request queue the resolution of the metadata of the given target, if not already cached.
+ */
+int target_resolver_request(struct target_resolver *resolver, struct target *target);
+
+/*
+ * target_resolver_lookup returns a copy of the cached metadata of the given container once its resolution is over, NULL while it is pending.
+ * The state of the resolution is stored in the given pointer, the metadata of an unresolvable container have no name.
+ */
+struct target_metadata *target_resolver_lookup(struct target_resolver *resolver, const char *container_id, enum target_resolver_state *state);
+
+/*
+ * target_resolver_destroy stop the resolver actor and free the allocated resources.
+ */
+void target_resolver_destroy(struct target_resolver *resolver);
+
+#endif /* TARGET_RESOLVER_H */
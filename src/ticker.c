@@ -0,0 +1,212 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <czmq.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ticker.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+static uint64_t
+timespec_to_ns(const struct timespec *ts)
+{
+    return (uint64_t) ts->tv_sec * NSEC_PER_SEC + (uint64_t) ts->tv_nsec;
+}
+
+static struct timespec
+ns_to_timespec(uint64_t ns)
+{
+    return (struct timespec){ .tv_sec = (time_t) (ns / NSEC_PER_SEC), .tv_nsec = (long) (ns % NSEC_PER_SEC) };
+}
+
+/*
+ * arm_timer set the period of the timer, the first deadline is one period from now.
+ * The next deadlines are computed by the kernel from the absolute deadline, so the period does not drift.
+ */
+static int
+arm_timer(struct ticker *ticker, uint64_t period_ns)
+{
+    struct timespec now = {0};
+    struct itimerspec timer = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ticker->period_ns = period_ns;
+    ticker->deadline_ns = timespec_to_ns(&now);
+    timer.it_value = ns_to_timespec(ticker->deadline_ns + ticker->period_ns);
+    timer.it_interval = ns_to_timespec(ticker->period_ns);
+
+    errno = 0;
+    return timerfd_settime(ticker->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+struct ticker *
+ticker_create(const char *endpoint, unsigned int period_ms)
+{
+    struct ticker *ticker = NULL;
+
+    if (period_ms == 0)
+        return NULL;
+
+    ticker = malloc(sizeof(struct ticker));
+    if (!ticker)
+        return NULL;
+
+    ticker->period_ns = 0;
+    ticker->base_period_ns = (uint64_t) period_ms * NSEC_PER_MSEC;
+    ticker->burst_period_ns = 0;
+    ticker->burst_end_ns = 0;
+    ticker->burst_tick = false;
+    ticker->sequence = 0;
+    ticker->missed = 0;
+    ticker->publisher = NULL;
+
+    errno = 0;
+    ticker->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (ticker->timer_fd == -1) {
+        zsys_error("ticker: failed to create timer: %s", strerror(errno));
+        goto error;
+    }
+
+    if (arm_timer(ticker, ticker->base_period_ns)) {
+        zsys_error("ticker: failed to arm timer: %s", strerror(errno));
+        goto error;
+    }
+
+    ticker->publisher = zsock_new_pub(endpoint);
+    if (!ticker->publisher) {
+        zsys_error("ticker: failed to create publisher socket on %s", endpoint);
+        goto error;
+    }
+
+    return ticker;
+
+error:
+    ticker_destroy(ticker);
+    return NULL;
+}
+
+int
+ticker_wait(struct ticker *ticker)
+{
+    uint64_t expirations = 0;
+
+    if (read(ticker->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return -1;
+
+    /* the previous iteration of the main loop overran one or more deadlines */
+    if (expirations > 1)
+        ticker->missed += expirations - 1;
+
+    ticker->sequence += expirations;
+    ticker->deadline_ns += expirations * ticker->period_ns;
+
+    /* the last deadline of a capture window is still published as a burst tick, the regular period starts after it */
+    ticker->burst_tick = (ticker->burst_end_ns > 0);
+    if (ticker->burst_tick && ticker->deadline_ns >= ticker->burst_end_ns) {
+        ticker->burst_end_ns = 0;
+        if (arm_timer(ticker, ticker->base_period_ns))
+            zsys_error("ticker: failed to rearm timer at the end of the capture window: %s", strerror(errno));
+    }
+
+    return (int) expirations;
+}
+
+int
+ticker_set_period(struct ticker *ticker, unsigned int period_ms)
+{
+    if (period_ms == 0)
+        return -1;
+
+    /* the sequence number keeps counting the elapsed periods */
+    ticker->base_period_ns = (uint64_t) period_ms * NSEC_PER_MSEC;
+    if (ticker->burst_end_ns)
+        return 0;
+
+    if (arm_timer(ticker, ticker->base_period_ns)) {
+        zsys_error("ticker: failed to rearm timer: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+ticker_start_burst(struct ticker *ticker, unsigned int period_ms, unsigned int duration_ms)
+{
+    struct timespec now = {0};
+
+    if (period_ms == 0 || duration_ms == 0)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (ticker->burst_end_ns) {
+        ticker->burst_end_ns = timespec_to_ns(&now) + (uint64_t) duration_ms * NSEC_PER_MSEC;
+        return 0;
+    }
+
+    ticker->burst_period_ns = (uint64_t) period_ms * NSEC_PER_MSEC;
+    if (arm_timer(ticker, ticker->burst_period_ns)) {
+        zsys_error("ticker: failed to rearm timer for the capture window: %s", strerror(errno));
+        arm_timer(ticker, ticker->base_period_ns);
+        return -1;
+    }
+
+    ticker->burst_end_ns = ticker->deadline_ns + (uint64_t) duration_ms * NSEC_PER_MSEC;
+    return 0;
+}
+
+int
+ticker_publish(struct ticker *ticker)
+{
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return zsock_send(ticker->publisher, "s8888", "CLOCK_TICK", ticker->sequence, timespec_to_ns(&now), ticker->deadline_ns, (ticker->burst_tick) ? ticker->burst_period_ns / NSEC_PER_MSEC : 0);
+}
+
+void
+ticker_destroy(struct ticker *ticker)
+{
+    if (!ticker)
+        return;
+
+    if (ticker->timer_fd != -1)
+        close(ticker->timer_fd);
+
+    zsock_destroy(&ticker->publisher);
+    free(ticker);
+}
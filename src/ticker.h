@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2018, INRIA
+ *  Copyright (c) 2018, University of Lille
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TICKER_H
+#define TICKER_H
+
+#include <czmq.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * ticker stores the state of the clock ticks publisher.
+ * The ticks are driven by a timerfd armed with absolute CLOCK_MONOTONIC deadlines, so the period does not drift.
+ */
+struct ticker
+{
+    int timer_fd;
+    zsock_t *publisher;
+    uint64_t period_ns; /* current period of the timer */
+    uint64_t base_period_ns; /* period of the timer outside of the capture windows */
+    uint64_t burst_period_ns; /* period of the timer during the running capture window */
+    uint64_t burst_end_ns; /* CLOCK_MONOTONIC time of the end of the running capture window, 0 if none */
+    bool burst_tick; /* true if the last elapsed deadline belongs to a capture window */
+    uint64_t sequence; /* number of elapsed periods since the start of the ticker */
+    uint64_t deadline_ns; /* CLOCK_MONOTONIC time of the last elapsed deadline */
+    uint64_t missed; /* number of deadlines elapsed without a tick being published */
+};
+
+/*
+ * ticker_create allocate the resources and start a ticker publishing on the given endpoint every period (in milliseconds).
+ */
+struct ticker *ticker_create(const char *endpoint, unsigned int period_ms);
+
+/*
+ * ticker_wait block until the next deadline, returns the number of deadlines that elapsed or -1 if interrupted.
+ */
+int ticker_wait(struct ticker *ticker);
+
+/*
+ * ticker_set_period change the period (in milliseconds) of the ticker, starting from now.
+ * During a capture window, the new period is only applied at the end of the window.
+ */
+int ticker_set_period(struct ticker *ticker, unsigned int period_ms);
+
+/*
+ * ticker_start_burst switch the ticker to the given period (in milliseconds) for the given duration (in milliseconds).
+ * The running capture window is extended if one is already started, the regular period is restored when it ends.
+ */
+int ticker_start_burst(struct ticker *ticker, unsigned int period_ms, unsigned int duration_ms);
+
+/*
+ * ticker_publish send the current tick to the subscribers with its sequence number, timestamp and deadline (in nanoseconds).
+ * The monotonic deadline is used by the subscribers to find the events groups whose period elapsed.
+ * The period (in milliseconds) of the capture window is also sent, 0 if the tick does not belong to a capture window.
+ */
+int ticker_publish(struct ticker *ticker);
+
+/*
+ * ticker_destroy stop the ticker and free the allocated resources.
+ */
+void ticker_destroy(struct ticker *ticker);
+
+#endif /* TICKER_H */
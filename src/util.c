@@ -156,6 +156,19 @@ uint64ptrcmp(const uint64_t *a, const uint64_t *b)
     return uint64cmp((a) ? *a : 0, (b) ? *b : 0);
 }
 
+uint64_t
+strhash(const char *str)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (; *str; str++) {
+        hash ^= (unsigned char) *str;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
 void
 ptrfree(void **ptr)
 {
@@ -102,6 +102,11 @@ int uint64cmp(uint64_t a, uint64_t b);
  */
 int uint64ptrcmp(const uint64_t *a, const uint64_t *b);
 
+/*
+ * strhash compute the FNV-1a hash of the string, which is stable across processes.
+ */
+uint64_t strhash(const char *str);
+
 /*
  * ptrfree free the memory pointed by ptr and set ptr to NULL.
  */